@@ -0,0 +1,57 @@
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include "ServiceId.h"
+#include "ClientQueryService.h"
+#include "StorytellerClient.h"
+#include "bench_common.h"
+
+namespace chl = chronolog;
+
+static void BM_ChronologTimerGetTimestamp(benchmark::State &state)
+{
+    chl::ChronologTimer timer;
+    for(auto _: state)
+    { benchmark::DoNotOptimize(timer.getTimestamp()); }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ChronologTimerGetTimestamp);
+
+static chl::StorytellerClient &bench_storyteller()
+{
+    static chl::ChronologTimer timer;
+    static chl::StorytellerClient*storyteller = []()
+    {
+        chl::ClientQueryService*query_service = chl::ClientQueryService::CreateClientQueryService(
+                chl::bench_engine(), chl::ServiceId("ofi+sockets", gethostid(), 0, 92));
+        return new chl::StorytellerClient(timer, *query_service, 1);
+    }();
+    return *storyteller;
+}
+
+// StorytellerClient::get_event_index, shared by all the threads writing to the client
+static void BM_GetEventIndexContended(benchmark::State &state)
+{
+    chl::StorytellerClient &storyteller = bench_storyteller();
+    for(auto _: state)
+    { benchmark::DoNotOptimize(storyteller.get_event_index()); }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetEventIndexContended)->ThreadRange(1, 16)->UseRealTime();
+
+// keeper choice over range(0) keepers ; the policies only pick a pointer so the clients are never dereferenced
+template <class KeeperChoicePolicy>
+static void BM_KeeperChoice(benchmark::State &state)
+{
+    std::vector <chl::KeeperRecordingClient*> keepers;
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { keepers.push_back(reinterpret_cast<chl::KeeperRecordingClient*>(0x1000 + i * 64)); }
+
+    KeeperChoicePolicy policy;
+    chl::ChronologTimer timer;
+    for(auto _: state)
+    { benchmark::DoNotOptimize(policy.chooseKeeper(keepers, timer.getTimestamp())); }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_KeeperChoice, chl::RoundRobinKeeperChoice)->Arg(1)->Arg(3)->Arg(8);
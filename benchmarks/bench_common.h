@@ -0,0 +1,34 @@
+#ifndef CHRONOLOG_BENCH_COMMON_H
+#define CHRONOLOG_BENCH_COMMON_H
+
+#include <cstdlib>
+#include <string>
+#include <thallium.hpp>
+
+#include "chronolog_types.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+// Server engine shared by the benchmarks that need RPC or provider objects ;
+// the transport can be changed with CHRONOLOG_BENCH_PROTOCOL (default ofi+sockets)
+inline tl::engine &bench_engine()
+{
+    static tl::engine *engine = []()
+    {
+        char const*protocol = std::getenv("CHRONOLOG_BENCH_PROTOCOL");
+        return new tl::engine((protocol != nullptr ? protocol : "ofi+sockets"), THALLIUM_SERVER_MODE, true, 1);
+    }();
+    return *engine;
+}
+
+inline LogEvent make_bench_event(StoryId story_id, uint64_t event_time, uint32_t index, std::size_t payload_size)
+{
+    return LogEvent(story_id, event_time, 7, index, std::string(payload_size, 'x'));
+}
+
+}
+
+#endif
@@ -0,0 +1,19 @@
+#include <benchmark/benchmark.h>
+
+#include "chrono_monitor.h"
+
+// Runs all the chronolog client microbenchmarks.
+// Machine-readable results: chronolog_benchmarks --benchmark_format=json [--benchmark_out=<file>]
+
+int main(int argc, char**argv)
+{
+    // the client code logs through chrono_monitor, keep it quiet so that it does not skew the timings
+    chronolog::chrono_monitor::initialize("console", "", spdlog::level::err, "chronolog_benchmarks");
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    { return 1; }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <cstdio>
+#include <sstream>
+#include <benchmark/benchmark.h>
+#include <thallium.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/tuple.hpp>
+
+#include "chronolog_errcode.h"
+#include "StoryChunk.h"
+#include "ClientQueryService.h"
+#include "EventBatch.h"
+#include "chronolog_format.h"
+#include "chronolog_typed_story.h"
+#include "bench_common.h"
+
+namespace tl = thallium;
+namespace chl = chronolog;
+
+// LogEvent thallium serialization, measured as a record_event style RPC to a provider in the same
+// process that only deserializes the event : the cost is the encode/decode of the LogEvent
+// plus the fixed loopback overhead, which BM_LogEventRpcBaseline measures on its own
+class BenchEventSink: public tl::provider <BenchEventSink>
+{
+public:
+    BenchEventSink(tl::engine &tl_engine, uint16_t provider_id)
+        : tl::provider <BenchEventSink>(tl_engine, provider_id)
+    {
+        define("bench_record_event", &BenchEventSink::record_event);
+        define("bench_noop", &BenchEventSink::noop);
+    }
+
+    void record_event(tl::request const &request, chl::LogEvent const &log_event)
+    { request.respond((int)log_event.getRecord().size()); }
+
+    void noop(tl::request const &request)
+    { request.respond((int)chl::CL_SUCCESS); }
+};
+
+static BenchEventSink &bench_event_sink()
+{
+    static BenchEventSink*event_sink = new BenchEventSink(chl::bench_engine(), 91);
+    return *event_sink;
+}
+
+static void BM_LogEventRpcSerialization(benchmark::State &state)
+{
+    bench_event_sink();
+    tl::remote_procedure record_event = chl::bench_engine().define("bench_record_event");
+    tl::provider_handle sink_ph(chl::bench_engine().self(), 91);
+    chl::LogEvent event = chl::make_bench_event(1, 1000, 1, state.range(0));
+
+    for(auto _: state)
+    {
+        int return_code = record_event.on(sink_ph)(event);
+        benchmark::DoNotOptimize(return_code);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LogEventRpcSerialization)->Arg(0)->Arg(64)->Arg(1024)->Arg(16384)->UseRealTime();
+
+static void BM_LogEventRpcBaseline(benchmark::State &state)
+{
+    bench_event_sink();
+    tl::remote_procedure noop = chl::bench_engine().define("bench_noop");
+    tl::provider_handle sink_ph(chl::bench_engine().self(), 91);
+
+    for(auto _: state)
+    {
+        int return_code = noop.on(sink_ph)();
+        benchmark::DoNotOptimize(return_code);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogEventRpcBaseline)->UseRealTime();
+
+// ClientQueryService::deserializedWithCereal of a StoryChunk of range(0) events with range(1) byte payloads
+static void BM_StoryChunkCerealDeserialize(benchmark::State &state)
+{
+    chl::StoryChunk story_chunk("chronicle", "story", 1, 0, UINT64_MAX);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { story_chunk.insertEvent(chl::make_bench_event(1, 1000 + i * 10, i, state.range(1))); }
+
+    std::ostringstream oss(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive oarchive(oss);
+        oarchive(story_chunk);
+    }
+    std::string serialized_chunk = oss.str();
+
+    for(auto _: state)
+    {
+        chl::StoryChunk received_chunk;
+        int return_code = chl::ClientQueryService::deserializedWithCereal(&serialized_chunk[0]
+                                                                          , serialized_chunk.size(), received_chunk);
+        benchmark::DoNotOptimize(return_code);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * serialized_chunk.size());
+}
+BENCHMARK(BM_StoryChunkCerealDeserialize)->Args({1024, 64})->Args({1024, 1024})->Args({16384, 64});
+
+// EventBatchEncoder of range(0) events with range(1) byte payloads, lz compressed if range(2) ;
+// the bytes counter is the encoded size
+static void BM_EventBatchEncode(benchmark::State &state)
+{
+    std::vector <chl::LogEvent> events;
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { events.push_back(chl::make_bench_event(1, 1000 + i * 10, i, state.range(1))); }
+
+    std::string encoded_batch;
+    for(auto _: state)
+    {
+        chl::EventBatchEncoder event_batch(1, 7, state.range(2) != 0);
+        for(auto const &event: events)
+        { event_batch.add_event(event); }
+        event_batch.encode(encoded_batch);
+        benchmark::DoNotOptimize(encoded_batch.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * encoded_batch.size());
+}
+BENCHMARK(BM_EventBatchEncode)->Args({64, 64, 0})->Args({1024, 64, 0})->Args({1024, 1024, 0})->Args({1024, 64, 1})
+        ->Args({1024, 1024, 1});
+
+static void BM_EventBatchDecode(benchmark::State &state)
+{
+    chl::EventBatchEncoder event_batch(1, 7, state.range(2) != 0);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { event_batch.add_event(chl::make_bench_event(1, 1000 + i * 10, i, state.range(1))); }
+    std::string encoded_batch;
+    event_batch.encode(encoded_batch);
+
+    std::vector <chl::LogEvent> events;
+    for(auto _: state)
+    {
+        events.clear();
+        benchmark::DoNotOptimize(chl::decode_event_batch(encoded_batch.data(), encoded_batch.size(), events));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * encoded_batch.size());
+}
+BENCHMARK(BM_EventBatchDecode)->Args({64, 64, 0})->Args({1024, 64, 0})->Args({1024, 1024, 0})->Args({1024, 64, 1})
+        ->Args({1024, 1024, 1});
+
+// compact counterpart of BM_StoryChunkCerealDeserialize
+static void BM_StoryChunkCompactDecode(benchmark::State &state)
+{
+    chl::StoryChunk story_chunk("chronicle", "story", 1, 0, UINT64_MAX);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { story_chunk.insertEvent(chl::make_bench_event(1, 1000 + i * 10, i, state.range(1))); }
+    std::string encoded_chunk;
+    chl::encode_story_chunk(story_chunk, encoded_chunk);
+
+    for(auto _: state)
+    {
+        chl::StoryChunk received_chunk;
+        benchmark::DoNotOptimize(chl::decode_story_chunk(encoded_chunk.data(), encoded_chunk.size(), received_chunk));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * encoded_chunk.size());
+}
+BENCHMARK(BM_StoryChunkCompactDecode)->Args({1024, 64})->Args({1024, 1024})->Args({16384, 64});
+
+// writer thread cost of a record : deferred format id plus binary args versus formatting the text
+static void BM_DeferredRecordEncode(benchmark::State &state)
+{
+    std::string record;
+    int64_t i = 0;
+    for(auto _: state)
+    {
+        ++i;
+        chl::encode_deferred_record(record, FMT_ID("request %d served in %f ms by %s"), i, 0.125 * i, "worker-3");
+        benchmark::DoNotOptimize(record.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeferredRecordEncode);
+
+static void BM_FormattedRecord(benchmark::State &state)
+{
+    char buffer[128];
+    std::string record;
+    int64_t i = 0;
+    for(auto _: state)
+    {
+        ++i;
+        int length = std::snprintf(buffer, sizeof(buffer), "request %ld served in %f ms by %s", static_cast<long>(i)
+                                   , 0.125 * i, "worker-3");
+        record.assign(buffer, length);
+        benchmark::DoNotOptimize(record.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FormattedRecord);
+
+static void BM_DeferredRecordRender(benchmark::State &state)
+{
+    std::string record;
+    std::string text;
+    chl::encode_deferred_record(record, FMT_ID("request %d served in %f ms by %s"), 42, 5.25, "worker-3");
+    for(auto _: state)
+    {
+        chl::render_record(record, text);
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeferredRecordRender);
+
+class BenchSample
+{
+public:
+    static constexpr char const *schema_name = "bench.sample.v1";
+    uint64_t sensor;
+    double value;
+    uint32_t flags;
+};
+
+// typed record encoding versus the text record the caller would otherwise build
+static void BM_TypedRecordEncode(benchmark::State &state)
+{
+    std::string record;
+    BenchSample sample{7, 0.5, 3};
+    for(auto _: state)
+    {
+        ++sample.sensor;
+        chl::TypedStoryHandle <BenchSample>::encode(sample, record);
+        benchmark::DoNotOptimize(record.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TypedRecordEncode);
+
+static void BM_TypedRecordDecode(benchmark::State &state)
+{
+    std::string record;
+    chl::TypedStoryHandle <BenchSample>::encode(BenchSample{7, 0.5, 3}, record);
+    BenchSample sample;
+    for(auto _: state)
+    {
+        benchmark::DoNotOptimize(chl::TypedStoryHandle <BenchSample>::decode(record, sample));
+        benchmark::DoNotOptimize(sample.value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TypedRecordDecode);
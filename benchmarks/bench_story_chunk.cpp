@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include "StoryChunk.h"
+#include "bench_common.h"
+
+namespace chl = chronolog;
+
+// StoryChunk::insertEvent of range(0) events with range(1) byte payloads into an empty chunk
+static void BM_StoryChunkInsertEvent(benchmark::State &state)
+{
+    std::vector <chl::LogEvent> events;
+    for(int64_t i = 0; i < state.range(0); ++i)
+    { events.push_back(chl::make_bench_event(1, 1000 + i * 10, i, state.range(1))); }
+
+    for(auto _: state)
+    {
+        chl::StoryChunk story_chunk("chronicle", "story", 1, 0, UINT64_MAX);
+        for(auto const &event: events)
+        { story_chunk.insertEvent(event); }
+        benchmark::DoNotOptimize(story_chunk.getEventCount());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StoryChunkInsertEvent)->Args({1024, 64})->Args({1024, 1024})->Args({16384, 64});
+
+// StoryChunk::mergeEvents of a chunk of range(0) events into a chunk of range(0) interleaved events
+static void BM_StoryChunkMergeEvents(benchmark::State &state)
+{
+    chl::StoryChunk master_template("chronicle", "story", 1, 0, UINT64_MAX);
+    chl::StoryChunk other_template("chronicle", "story", 1, 0, UINT64_MAX);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    {
+        master_template.insertEvent(chl::make_bench_event(1, 1000 + i * 10, i, 64));
+        other_template.insertEvent(chl::make_bench_event(1, 1005 + i * 10, i, 64));
+    }
+
+    for(auto _: state)
+    {
+        state.PauseTiming();
+        chl::StoryChunk master_chunk(master_template);
+        chl::StoryChunk other_chunk(other_template);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(master_chunk.mergeEvents(other_chunk));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_StoryChunkMergeEvents)->Arg(1024)->Arg(16384);
+
+// LogEventHVL copy construction with a range(0) byte payload
+static void BM_LogEventHVLCopy(benchmark::State &state)
+{
+    std::vector <uint8_t> payload(state.range(0), 'x');
+    hvl_t record;
+    record.len = payload.size();
+    record.p = payload.data();
+    chl::LogEventHVL event(1, 1000, 7, 1, record);
+
+    for(auto _: state)
+    {
+        chl::LogEventHVL event_copy(event);
+        benchmark::DoNotOptimize(event_copy.logRecord.p);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LogEventHVLCopy)->Arg(64)->Arg(1024)->Arg(16384);
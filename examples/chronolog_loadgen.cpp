@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "chronolog_client.h"
+#include "chronolog_errcode.h"
+#include "chrono_metrics.h"
+#include "MockChronologDeployment.h"
+
+namespace chl = chronolog;
+
+// chronolog_loadgen : multi-threaded end-to-end load generator.
+// N writer threads log events of configurable payload sizes across M stories, either as fast as
+// possible, paced at a target rate, or with open-loop Poisson arrivals ; optional reader threads
+// play the stories back concurrently. Reports throughput and latency percentiles at the end.
+
+typedef std::chrono::steady_clock loadgen_clock;
+
+struct LoadgenConf
+{
+    std::string protocol = "ofi+sockets";
+    std::string visor_ip = "127.0.0.1";
+    uint16_t visor_port = 5555;
+    uint16_t visor_provider_id = 55;
+    bool use_mock = false;
+    uint16_t mock_keepers = 1;
+    uint32_t mock_latency_us = 0;
+    uint32_t mock_tail_latency_us = 0;
+    double mock_tail_rate = 0;
+
+    std::string chronicle = "LoadgenChronicle";
+    uint32_t writers = 1;
+    uint32_t stories = 1;
+    std::string payload = "fixed:64";
+    std::string compression;     // story "compression" attribute, e.g. lz
+    uint32_t replication = 1;    // story "replication" attribute
+    uint32_t write_quorum = 0;   // story "write_quorum" attribute, 0 for the majority of the replicas
+    uint32_t batch = 1;          // events logged per log_events call
+    bool keeper_batch_rpc = false;   // story "keeper_batch_rpc" attribute
+    bool keeper_batching = false;    // coalesce the events of all the stories per keeper
+    uint32_t batch_delay_us = 1000;
+    bool adaptive_batching = false;
+    uint32_t rpc_timeout_ms = 0;
+    bool hedging = false;
+    double story_max_events_per_sec = 0;    // story "max_events_per_sec" attribute
+    double story_max_bytes_per_sec = 0;     // story "max_bytes_per_sec" attribute
+    double client_max_events_per_sec = 0;
+    double client_max_bytes_per_sec = 0;
+    std::string rate_limit_mode = "block";
+    std::string priority;        // story "priority" attribute : high, normal or low
+    uint64_t max_memory_mb = 0;  // client memory budget, 0 for no cap
+    bool node_aggregation = false;
+    double rate = 0;             // total events per second over all the writers, 0 for unthrottled
+    bool open_loop = false;
+    uint32_t duration_secs = 10;
+    uint32_t readers = 0;
+    uint32_t playback_interval_ms = 1000;
+    uint32_t playback_window_ms = 1000;
+    bool json = false;
+    bool show_metrics = false;
+};
+
+// payload sizes drawn from "fixed:N", "uniform:MIN:MAX" or "exponential:MEAN"
+class PayloadSizeGenerator
+{
+public:
+    explicit PayloadSizeGenerator(std::string const &spec)
+        : kind(FIXED), first(64), second(64)
+    {
+        std::vector <std::string> fields;
+        std::stringstream ss(spec);
+        for(std::string field; std::getline(ss, field, ':');)
+        { fields.push_back(field); }
+
+        if(fields.size() == 2 && fields[0] == "fixed")
+        { kind = FIXED; first = second = std::stoull(fields[1]); }
+        else if(fields.size() == 3 && fields[0] == "uniform")
+        { kind = UNIFORM; first = std::stoull(fields[1]); second = std::stoull(fields[2]); }
+        else if(fields.size() == 2 && fields[0] == "exponential")
+        { kind = EXPONENTIAL; first = second = std::stoull(fields[1]); }
+        else
+        { throw std::invalid_argument("invalid payload distribution: " + spec); }
+    }
+
+    std::size_t max_size() const
+    { return (kind == EXPONENTIAL ? first * 16 : second); }
+
+    std::size_t next(std::mt19937_64 &rng) const
+    {
+        switch(kind)
+        {
+            case UNIFORM:
+                return std::uniform_int_distribution <std::size_t>(first, second)(rng);
+            case EXPONENTIAL:
+                return std::min <std::size_t>(max_size(), static_cast<std::size_t>(
+                        std::exponential_distribution <double>(1.0 / first)(rng)));
+            default:
+                return first;
+        }
+    }
+
+private:
+    enum Kind { FIXED, UNIFORM, EXPONENTIAL };
+    Kind kind;
+    std::size_t first;
+    std::size_t second;
+};
+
+struct LoadgenStats
+{
+    chl::LatencyHistogram writeLatency;
+    chl::LatencyHistogram playbackLatency;
+    std::atomic <uint64_t> eventsLogged{0};
+    std::atomic <uint64_t> bytesLogged{0};
+    std::atomic <uint64_t> writeFailures{0};
+    std::atomic <uint64_t> playbacks{0};
+    std::atomic <uint64_t> playbackEvents{0};
+    std::atomic <uint64_t> playbackFailures{0};
+    uint64_t flushNs = 0;           // Client::Flush at the end of the run
+    int flushReturn = 0;
+};
+
+static uint64_t elapsed_ns(loadgen_clock::time_point from, loadgen_clock::time_point to)
+{ return std::chrono::duration_cast <std::chrono::nanoseconds>(to - from).count(); }
+
+static void writer_thread(LoadgenConf const &conf, uint32_t writer_id, std::vector <chl::StoryHandle*> const &stories
+                          , PayloadSizeGenerator const &payload_sizes, std::string const &payload_source
+                          , loadgen_clock::time_point end_time, LoadgenStats &stats)
+{
+    std::mt19937_64 rng(writer_id * 7919 + 1);
+    double writer_rate = conf.rate / conf.writers;
+    std::exponential_distribution <double> interarrival(writer_rate > 0 ? writer_rate : 1.0);
+
+    std::vector <std::string_view> batch_records(conf.batch);
+    loadgen_clock::time_point next_arrival = loadgen_clock::now();
+    for(uint64_t event_count = 0;; ++event_count)
+    {
+        if(writer_rate > 0)
+        {
+            // open loop: Poisson arrivals, a slow send does not delay the following arrivals ;
+            // closed loop: fixed spacing between the starts of consecutive sends
+            double gap_secs = (conf.open_loop ? interarrival(rng) : 1.0 / writer_rate) * conf.batch;
+            if(event_count > 0)
+            { next_arrival += std::chrono::nanoseconds(static_cast<uint64_t>(gap_secs * 1e9)); }
+            if(next_arrival >= end_time)
+            { break; }
+            std::this_thread::sleep_until(next_arrival);
+        }
+        loadgen_clock::time_point send_start = loadgen_clock::now();
+        if(send_start >= end_time)
+        { break; }
+
+        std::size_t payload_size = 0;
+        chl::StoryHandle*story = stories[(writer_id + event_count) % stories.size()];
+        int return_code = 0;
+        if(conf.batch == 1)
+        {
+            payload_size = payload_sizes.next(rng);
+            return_code = story->log_event(payload_source.substr(0, payload_size));
+        }
+        else
+        {
+            for(auto &record: batch_records)
+            {
+                record = std::string_view(payload_source).substr(0, payload_sizes.next(rng));
+                payload_size += record.size();
+            }
+            return_code = story->log_events(batch_records.data(), batch_records.size());
+        }
+        loadgen_clock::time_point send_end = loadgen_clock::now();
+
+        if(return_code == static_cast<int>(conf.batch))
+        {
+            // open loop latency is measured from the intended arrival time so that queueing
+            // behind slow sends is accounted for
+            stats.writeLatency.record(elapsed_ns((conf.open_loop && writer_rate > 0) ? next_arrival : send_start
+                                                 , send_end));
+            stats.eventsLogged.fetch_add(conf.batch, std::memory_order_relaxed);
+            stats.bytesLogged.fetch_add(payload_size, std::memory_order_relaxed);
+        }
+        else
+        { stats.writeFailures.fetch_add(conf.batch, std::memory_order_relaxed); }
+    }
+}
+
+static void reader_thread(LoadgenConf const &conf, uint32_t reader_id, std::vector <chl::StoryHandle*> const &stories
+                          , loadgen_clock::time_point end_time, LoadgenStats &stats)
+{
+    std::vector <chl::Event> playback_events;
+    for(uint64_t playback_count = 0; loadgen_clock::now() < end_time; ++playback_count)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(conf.playback_interval_ms));
+
+        // same clock as the client that timestamps the events
+        uint64_t window_end = chl::event_timestamp();
+        uint64_t window_start = window_end - uint64_t{conf.playback_window_ms} * 1000000;
+
+        chl::StoryHandle*story = stories[(reader_id + playback_count) % stories.size()];
+        loadgen_clock::time_point playback_start = loadgen_clock::now();
+        int return_code = story->playback_story(window_start, window_end, playback_events);
+        loadgen_clock::time_point playback_end = loadgen_clock::now();
+
+        if(return_code == chl::CL_SUCCESS)
+        {
+            stats.playbackLatency.record(elapsed_ns(playback_start, playback_end));
+            stats.playbacks.fetch_add(1, std::memory_order_relaxed);
+            stats.playbackEvents.fetch_add(playback_events.size(), std::memory_order_relaxed);
+        }
+        else
+        { stats.playbackFailures.fetch_add(1, std::memory_order_relaxed); }
+    }
+}
+
+static void print_report(LoadgenConf const &conf, double run_secs, LoadgenStats const &stats)
+{
+    chl::HistogramSnapshot write_latency = stats.writeLatency.snapshot();
+    chl::HistogramSnapshot playback_latency = stats.playbackLatency.snapshot();
+    double events_per_sec = stats.eventsLogged.load() / run_secs;
+    double mb_per_sec = stats.bytesLogged.load() / run_secs / 1e6;
+
+    if(conf.json)
+    {
+        std::cout << "{\"writers\":" << conf.writers << ",\"stories\":" << conf.stories << ",\"payload\":\""
+                  << conf.payload << "\",\"replication\":" << conf.replication << ",\"batch\":" << conf.batch
+                  << ",\"keeper_batching\":" << (conf.keeper_batching ? "true" : "false") << ",\"adaptive_batching\":"
+                  << (conf.adaptive_batching ? "true" : "false") << ",\"hedging\":" << (conf.hedging ? "true" : "false")
+                  << ",\"rate\":" << conf.rate << ",\"open_loop\":"
+                  << (conf.open_loop ? "true" : "false") << ",\"duration_secs\":" << run_secs
+                  << ",\"events\":" << stats.eventsLogged.load() << ",\"bytes\":" << stats.bytesLogged.load()
+                  << ",\"write_failures\":" << stats.writeFailures.load() << ",\"events_per_sec\":" << events_per_sec
+                  << ",\"mb_per_sec\":" << mb_per_sec << ",\"write_latency_ns\":{\"p50\":" << write_latency.p50
+                  << ",\"p90\":" << write_latency.p90 << ",\"p99\":" << write_latency.p99 << ",\"p999\":"
+                  << write_latency.p999 << ",\"max\":" << write_latency.max << "},\"readers\":" << conf.readers
+                  << ",\"playbacks\":" << stats.playbacks.load() << ",\"playback_events\":"
+                  << stats.playbackEvents.load() << ",\"playback_failures\":" << stats.playbackFailures.load()
+                  << ",\"playback_latency_ns\":{\"p50\":" << playback_latency.p50 << ",\"p90\":"
+                  << playback_latency.p90 << ",\"p99\":" << playback_latency.p99 << ",\"max\":"
+                  << playback_latency.max << "},\"flush_ns\":" << stats.flushNs << ",\"flush_return\":"
+                  << stats.flushReturn << "}" << std::endl;
+        return;
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "writers " << conf.writers << " stories " << conf.stories << " payload " << conf.payload
+              << " replication " << conf.replication << " batch " << conf.batch
+              << (conf.adaptive_batching ? " (adaptive keeper batching)" : (conf.keeper_batching ? " (keeper batching)" : ""))
+              << (conf.hedging ? " (hedging)" : "")
+              << " rate " << (conf.rate > 0 ? std::to_string(conf.rate) : "unthrottled")
+              << (conf.open_loop ? " (open loop)" : "") << " duration " << run_secs << "s\n"
+              << "events " << stats.eventsLogged.load() << " failures " << stats.writeFailures.load()
+              << " throughput " << events_per_sec << " events/s " << mb_per_sec << " MB/s\n"
+              << "write latency us: p50 " << write_latency.p50 / 1e3 << " p90 " << write_latency.p90 / 1e3
+              << " p99 " << write_latency.p99 / 1e3 << " p999 " << write_latency.p999 / 1e3 << " max "
+              << write_latency.max / 1e3 << "\n"
+              << "flush " << stats.flushNs / 1e3 << " us return code " << stats.flushReturn << "\n";
+    if(conf.readers > 0)
+    {
+        std::cout << "playbacks " << stats.playbacks.load() << " failures " << stats.playbackFailures.load()
+                  << " events " << stats.playbackEvents.load() << "\n"
+                  << "playback latency us: p50 " << playback_latency.p50 / 1e3 << " p90 " << playback_latency.p90 / 1e3
+                  << " p99 " << playback_latency.p99 / 1e3 << " max " << playback_latency.max / 1e3 << "\n";
+    }
+}
+
+static void usage(char const*program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --protocol <string>         (default ofi+sockets)\n"
+              << "  --visor-ip <ip>             (default 127.0.0.1)\n"
+              << "  --visor-port <port>         (default 5555)\n"
+              << "  --visor-provider-id <id>    (default 55)\n"
+              << "  --mock                      run against in-process mock Visor/Keeper/Player services\n"
+              << "  --mock-keepers <n>          (default 1)\n"
+              << "  --mock-latency-us <n>       latency injected by the mock services (default 0)\n"
+              << "  --mock-tail-latency-us <n>  latency added to a --mock-tail-rate fraction of the mock keeper requests\n"
+              << "  --mock-tail-rate <r>        fraction of the mock keeper requests that are slow (default 0)\n"
+              << "  --chronicle <name>          (default LoadgenChronicle)\n"
+              << "  --writers <n>               writer threads (default 1)\n"
+              << "  --stories <n>               stories written round robin by every writer (default 1)\n"
+              << "  --payload <dist>            fixed:N | uniform:MIN:MAX | exponential:MEAN (default fixed:64)\n"
+              << "  --compression <codec>       acquire the stories with the compression attribute (lz)\n"
+              << "  --replication <k>           send every event batch to k of the story keepers (default 1)\n"
+              << "  --write-quorum <q>          replica acknowledgements needed per batch (default majority)\n"
+              << "  --batch <n>                 events per log_events batch call (default 1, log_event)\n"
+              << "  --keeper-batch-rpc          keepers serve record_event_batch (for --batch, --replication)\n"
+              << "  --keeper-batching           coalesce the events of all the stories per keeper connection\n"
+              << "  --batch-delay-us <us>       longest wait of an event in a keeper batch (default 1000)\n"
+              << "  --adaptive-batching         keeper batch size and linger follow the load, --batch-delay-us is the target\n"
+              << "  --rpc-timeout-ms <ms>       deadline of every client RPC (default 0, none)\n"
+              << "  --hedging                   hedge the slow event batches and playback requests\n"
+              << "  --story-max-events <n/s>    events per second limit of every story (default 0, none)\n"
+              << "  --story-max-bytes <n/s>     bytes per second limit of every story (default 0, none)\n"
+              << "  --client-max-events <n/s>   events per second limit of the whole client (default 0, none)\n"
+              << "  --client-max-bytes <n/s>    bytes per second limit of the whole client (default 0, none)\n"
+              << "  --rate-limit-mode <mode>    block | drop | sample, for the events over a limit (default block)\n"
+              << "  --priority <p>              keeper batching lane of the stories: high | normal | low\n"
+              << "  --max-memory-mb <mb>        cap of the client SDK buffers (default 0, none)\n"
+              << "  --node-aggregation          forward the events through the node shared memory aggregator\n"
+              << "  --rate <events/s>           total target rate over all the writers, 0 for unthrottled\n"
+              << "  --open-loop                 Poisson arrivals at --rate, latency includes queueing delay\n"
+              << "  --duration <secs>           (default 10)\n"
+              << "  --readers <n>               concurrent playback reader threads (default 0)\n"
+              << "  --playback-interval <ms>    pause between the playbacks of a reader (default 1000)\n"
+              << "  --playback-window <ms>      most recent time window played back (default 1000)\n"
+              << "  --json                      print the report as a single JSON line\n"
+              << "  --metrics                   also print the client metrics snapshot\n";
+}
+
+int main(int argc, char**argv)
+{
+    LoadgenConf conf;
+    static struct option long_options[] = {{"protocol"           , required_argument, nullptr, 'P'}
+                                           , {"visor-ip"           , required_argument, nullptr, 'i'}
+                                           , {"visor-port"         , required_argument, nullptr, 'p'}
+                                           , {"visor-provider-id"  , required_argument, nullptr, 'I'}
+                                           , {"mock"               , no_argument      , nullptr, 'm'}
+                                           , {"mock-keepers"       , required_argument, nullptr, 'k'}
+                                           , {"mock-latency-us"    , required_argument, nullptr, 'l'}
+                                           , {"mock-tail-latency-us", required_argument, nullptr, 'L'}
+                                           , {"mock-tail-rate"     , required_argument, nullptr, 'u'}
+                                           , {"chronicle"          , required_argument, nullptr, 'c'}
+                                           , {"writers"            , required_argument, nullptr, 'w'}
+                                           , {"stories"            , required_argument, nullptr, 's'}
+                                           , {"payload"            , required_argument, nullptr, 'z'}
+                                           , {"compression"        , required_argument, nullptr, 'x'}
+                                           , {"replication"        , required_argument, nullptr, 'E'}
+                                           , {"write-quorum"       , required_argument, nullptr, 'Q'}
+                                           , {"batch"              , required_argument, nullptr, 'b'}
+                                           , {"keeper-batching"    , no_argument      , nullptr, 'K'}
+                                           , {"batch-delay-us"     , required_argument, nullptr, 'D'}
+                                           , {"adaptive-batching"  , no_argument      , nullptr, 'A'}
+                                           , {"rpc-timeout-ms"     , required_argument, nullptr, 'T'}
+                                           , {"hedging"            , no_argument      , nullptr, 'H'}
+                                           , {"story-max-events"   , required_argument, nullptr, 'e'}
+                                           , {"story-max-bytes"    , required_argument, nullptr, 'y'}
+                                           , {"client-max-events"  , required_argument, nullptr, 'C'}
+                                           , {"client-max-bytes"   , required_argument, nullptr, 'B'}
+                                           , {"rate-limit-mode"    , required_argument, nullptr, 'X'}
+                                           , {"priority"           , required_argument, nullptr, 'g'}
+                                           , {"max-memory-mb"      , required_argument, nullptr, 'G'}
+                                           , {"node-aggregation"   , no_argument      , nullptr, 'N'}
+                                           , {"keeper-batch-rpc"   , no_argument      , nullptr, 'F'}
+                                           , {"rate"               , required_argument, nullptr, 'r'}
+                                           , {"open-loop"          , no_argument      , nullptr, 'o'}
+                                           , {"duration"           , required_argument, nullptr, 'd'}
+                                           , {"readers"            , required_argument, nullptr, 'R'}
+                                           , {"playback-interval"  , required_argument, nullptr, 'n'}
+                                           , {"playback-window"    , required_argument, nullptr, 'W'}
+                                           , {"json"               , no_argument      , nullptr, 'j'}
+                                           , {"metrics"            , no_argument      , nullptr, 'M'}
+                                           , {"help"               , no_argument      , nullptr, 'h'}
+                                           , {nullptr              , 0                , nullptr, 0}};
+    int opt;
+    while((opt = getopt_long(argc, argv, "P:i:p:I:mk:l:L:u:c:w:s:z:x:E:Q:b:KD:AT:He:y:C:B:X:g:G:NFr:od:R:n:W:jMh"
+                             , long_options, nullptr)) != -1)
+    {
+        switch(opt)
+        {
+            case 'P': conf.protocol = optarg; break;
+            case 'i': conf.visor_ip = optarg; break;
+            case 'p': conf.visor_port = std::atoi(optarg); break;
+            case 'I': conf.visor_provider_id = std::atoi(optarg); break;
+            case 'm': conf.use_mock = true; break;
+            case 'k': conf.mock_keepers = std::atoi(optarg); break;
+            case 'l': conf.mock_latency_us = std::atoi(optarg); break;
+            case 'L': conf.mock_tail_latency_us = std::atoi(optarg); break;
+            case 'u': conf.mock_tail_rate = std::atof(optarg); break;
+            case 'c': conf.chronicle = optarg; break;
+            case 'w': conf.writers = std::max(1, std::atoi(optarg)); break;
+            case 's': conf.stories = std::max(1, std::atoi(optarg)); break;
+            case 'z': conf.payload = optarg; break;
+            case 'x': conf.compression = optarg; break;
+            case 'E': conf.replication = std::max(1, std::atoi(optarg)); break;
+            case 'Q': conf.write_quorum = std::atoi(optarg); break;
+            case 'b': conf.batch = std::max(1, std::atoi(optarg)); break;
+            case 'K': conf.keeper_batching = true; break;
+            case 'D': conf.batch_delay_us = std::atoi(optarg); break;
+            case 'A': conf.keeper_batching = conf.adaptive_batching = true; break;
+            case 'T': conf.rpc_timeout_ms = std::atoi(optarg); break;
+            case 'H': conf.hedging = true; break;
+            case 'e': conf.story_max_events_per_sec = std::atof(optarg); break;
+            case 'y': conf.story_max_bytes_per_sec = std::atof(optarg); break;
+            case 'C': conf.client_max_events_per_sec = std::atof(optarg); break;
+            case 'B': conf.client_max_bytes_per_sec = std::atof(optarg); break;
+            case 'X': conf.rate_limit_mode = optarg; break;
+            case 'g': conf.priority = optarg; break;
+            case 'G': conf.max_memory_mb = std::strtoull(optarg, nullptr, 10); break;
+            case 'N': conf.node_aggregation = true; break;
+            case 'F': conf.keeper_batch_rpc = true; break;
+            case 'r': conf.rate = std::atof(optarg); break;
+            case 'o': conf.open_loop = true; break;
+            case 'd': conf.duration_secs = std::atoi(optarg); break;
+            case 'R': conf.readers = std::atoi(optarg); break;
+            case 'n': conf.playback_interval_ms = std::atoi(optarg); break;
+            case 'W': conf.playback_window_ms = std::atoi(optarg); break;
+            case 'j': conf.json = true; break;
+            case 'M': conf.show_metrics = true; break;
+            case 'h': usage(argv[0]); return 0;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    PayloadSizeGenerator*payload_sizes = nullptr;
+    try
+    { payload_sizes = new PayloadSizeGenerator(conf.payload); }
+    catch(std::exception const &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    std::string payload_source(payload_sizes->max_size(), 'x');
+
+    chl::MockChronologDeployment*mock_deployment = nullptr;
+    chl::ClientPortalServiceConf portal_conf(conf.protocol, conf.visor_ip, conf.visor_port, conf.visor_provider_id);
+    if(conf.use_mock)
+    {
+        chl::MockDeploymentConf mock_conf;
+        mock_conf.protocol = conf.protocol;
+        mock_conf.keeper_count = conf.mock_keepers;
+        mock_conf.handler_threads = std::max <uint32_t>(1, conf.writers / 2);
+        mock_conf.keeper_faults.latency_us = conf.mock_latency_us;
+        mock_conf.keeper_faults.tail_latency_us = conf.mock_tail_latency_us;
+        mock_conf.keeper_faults.tail_rate = conf.mock_tail_rate;
+        mock_deployment = chl::MockChronologDeployment::CreateMockDeployment(mock_conf);
+        if(mock_deployment == nullptr)
+        {
+            std::cerr << "Failed to start the mock services" << std::endl;
+            return 1;
+        }
+        portal_conf = mock_deployment->getClientPortalServiceConf();
+    }
+
+    int return_code = chl::CL_SUCCESS;
+    {
+        chl::ClientRecordingConf recording_conf(conf.keeper_batching);
+        recording_conf.max_batch_delay_us_ = conf.batch_delay_us;
+        recording_conf.adaptive_batching_ = conf.adaptive_batching;
+        recording_conf.client_max_events_per_sec_ = conf.client_max_events_per_sec;
+        recording_conf.client_max_bytes_per_sec_ = conf.client_max_bytes_per_sec;
+        recording_conf.rate_limit_mode_ = (conf.rate_limit_mode == "drop" ? chl::RATE_LIMIT_DROP
+                                           : (conf.rate_limit_mode == "sample" ? chl::RATE_LIMIT_SAMPLE
+                                                                               : chl::RATE_LIMIT_BLOCK));
+        chl::ClientRpcConf rpc_conf(conf.rpc_timeout_ms, conf.hedging);
+        chl::ClientMemoryConf memory_conf(conf.max_memory_mb << 20);
+        chl::ClientAggregationConf aggregation_conf(conf.node_aggregation);
+        chl::Client client(portal_conf, recording_conf, rpc_conf, memory_conf, aggregation_conf);
+        if((return_code = client.Connect()) != chl::CL_SUCCESS)
+        {
+            std::cerr << "Failed to connect to the Visor, error code: " << return_code << std::endl;
+        }
+        else
+        {
+            int flags = 0;
+            std::map <std::string, std::string> attrs;
+            client.CreateChronicle(conf.chronicle, attrs, flags);
+            if(!conf.compression.empty())
+            { attrs["compression"] = conf.compression; }
+            if(conf.replication > 1)
+            { attrs["replication"] = std::to_string(conf.replication); }
+            if(conf.write_quorum > 0)
+            { attrs["write_quorum"] = std::to_string(conf.write_quorum); }
+            if(conf.keeper_batch_rpc)
+            { attrs["keeper_batch_rpc"] = "true"; }
+            if(!conf.priority.empty())
+            { attrs["priority"] = conf.priority; }
+            if(conf.story_max_events_per_sec > 0)
+            { attrs["max_events_per_sec"] = std::to_string(conf.story_max_events_per_sec); }
+            if(conf.story_max_bytes_per_sec > 0)
+            { attrs["max_bytes_per_sec"] = std::to_string(conf.story_max_bytes_per_sec); }
+
+            std::vector <chl::StoryHandle*> stories;
+            for(uint32_t i = 0; i < conf.stories && return_code == chl::CL_SUCCESS; ++i)
+            {
+                auto acquire_return = client.AcquireStory(conf.chronicle, "story_" + std::to_string(i), attrs, flags);
+                return_code = acquire_return.first;
+                if(return_code == chl::CL_SUCCESS)
+                { stories.push_back(acquire_return.second); }
+                else
+                { std::cerr << "Failed to acquire story_" << i << ", error code: " << return_code << std::endl; }
+            }
+
+            if(return_code == chl::CL_SUCCESS)
+            {
+                LoadgenStats stats;
+                loadgen_clock::time_point start_time = loadgen_clock::now();
+                loadgen_clock::time_point end_time = start_time + std::chrono::seconds(conf.duration_secs);
+
+                std::vector <std::thread> threads;
+                for(uint32_t i = 0; i < conf.writers; ++i)
+                {
+                    threads.emplace_back(writer_thread, std::cref(conf), i, std::cref(stories)
+                                         , std::cref(*payload_sizes), std::cref(payload_source), end_time
+                                         , std::ref(stats));
+                }
+                for(uint32_t i = 0; i < conf.readers; ++i)
+                {
+                    threads.emplace_back(reader_thread, std::cref(conf), i, std::cref(stories), end_time
+                                         , std::ref(stats));
+                }
+                for(auto &thread: threads)
+                { thread.join(); }
+
+                // durability point of the run, the events still in keeper batches are acknowledged here
+                loadgen_clock::time_point flush_start = loadgen_clock::now();
+                stats.flushReturn = client.Flush(std::chrono::steady_clock::now() + std::chrono::seconds(30));
+                stats.flushNs = elapsed_ns(flush_start, loadgen_clock::now());
+
+                double run_secs = elapsed_ns(start_time, loadgen_clock::now()) / 1e9;
+                print_report(conf, run_secs, stats);
+                if(conf.show_metrics)
+                {
+                    std::string metrics_snapshot;
+                    std::cout << client.GetMetricsSnapshot(metrics_snapshot, conf.json ? "json" : "prometheus");
+                }
+            }
+
+            for(uint32_t i = 0; i < stories.size(); ++i)
+            { client.ReleaseStory(conf.chronicle, "story_" + std::to_string(i)); }
+            client.Disconnect();
+        }
+    }
+
+    delete mock_deployment;
+    delete payload_sizes;
+    return (return_code == chl::CL_SUCCESS ? 0 : 1);
+}
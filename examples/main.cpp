@@ -59,6 +59,12 @@ int main() {
         } else {
             std::cout << "Event logged successfully." << std::endl;
         }
+
+        // Deferred formatting: only the format id and the binary arguments are logged
+        event_rc = story->log(FMT_ID("test event %d of story %s"), 2, "TestStory");
+        if (event_rc == 0) {
+            std::cerr << "Failed to log deferred event. Error code: " << event_rc << std::endl;
+        }
         
         // -----------------------------------------------------------------
         // Playback events from the story
@@ -69,6 +75,7 @@ int main() {
             std::cerr << "Failed to playback story events. Error code: " << event_rc << std::endl;
         } else {
             std::cout << "Playback of story events:" << std::endl;
+            render_deferred_events(events);
             for (const auto& event : events) {
                 std::cout << event.toString() << std::endl;
             }
@@ -26,6 +26,10 @@ struct ClientPortalServiceConf
     uint16_t provider_id_;
 };
 
+// The client engine the Players send the playback StoryChunks to : it listens on service_ip (the NIC of the
+// client pipeline, any interface if empty) at service_port plus the number of the client instance in the process,
+// or at a port of the engine's choosing if service_port is 0 or that sum passes 65535. The client advertises the
+// address the engine listens on.
 struct ClientQueryServiceConf   
 {
     ClientQueryServiceConf( const std::string & protocol="ofi+sockets", 
@@ -47,5 +51,160 @@ struct ClientQueryServiceConf
     uint16_t provider_id_;
 };
 
+enum RateLimitMode
+{
+    RATE_LIMIT_BLOCK = 0, RATE_LIMIT_DROP = 1, RATE_LIMIT_SAMPLE = 2
+};
+
+// Client side batching of the recorded events: when enabled the events of all the stories
+// that go to the same ChronoKeeper are coalesced into one multi-story batch RPC, sent when it holds
+// max_batch_events events or max_batch_bytes payload bytes, or max_batch_delay_us after its first event.
+// With adaptive_batching the batch size and linger time follow the load instead, max_batch_events
+// and max_batch_delay_us then being the upper bound of the batch and the delay target of the events.
+// Rate limiting: client_max_events_per_sec and client_max_bytes_per_sec (0 for no limit) bound all the
+// stories of the client together, the "max_events_per_sec" and "max_bytes_per_sec" story attributes
+// bound a single story; rate_limit_mode decides what happens to the events over a limit, see RateLimitPolicy.
+// Priority lanes: the keeper batches of the "priority" high, normal and low stories are queued apart and sent
+// in proportion to the lane weights when several are ready, see KeeperEventBatcher.
+// Disconnect stops taking events and gives the ones already logged drain_timeout_ms to reach the keepers.
+struct ClientRecordingConf
+{
+    ClientRecordingConf( bool batching=false, uint32_t max_batch_events=512, uint32_t max_batch_bytes=1<<20,
+            uint32_t max_batch_delay_us=1000, bool adaptive_batching=false,
+            double client_max_events_per_sec=0, double client_max_bytes_per_sec=0,
+            RateLimitMode rate_limit_mode=RATE_LIMIT_BLOCK, uint32_t rate_limit_block_ms=100,
+            uint32_t rate_limit_sample_every=100, uint32_t rate_limit_burst_ms=100,
+            uint32_t high_priority_weight=4, uint32_t normal_priority_weight=2, uint32_t low_priority_weight=1,
+            uint32_t drain_timeout_ms=5000)
+        : batching_(batching)
+        , max_batch_events_(max_batch_events)
+        , max_batch_bytes_(max_batch_bytes)
+        , max_batch_delay_us_(max_batch_delay_us)
+        , adaptive_batching_(adaptive_batching)
+        , client_max_events_per_sec_(client_max_events_per_sec)
+        , client_max_bytes_per_sec_(client_max_bytes_per_sec)
+        , rate_limit_mode_(rate_limit_mode)
+        , rate_limit_block_ms_(rate_limit_block_ms)
+        , rate_limit_sample_every_(rate_limit_sample_every)
+        , rate_limit_burst_ms_(rate_limit_burst_ms)
+        , high_priority_weight_(high_priority_weight)
+        , normal_priority_weight_(normal_priority_weight)
+        , low_priority_weight_(low_priority_weight)
+        , drain_timeout_ms_(drain_timeout_ms)
+        {}
+
+    bool batching() const { return batching_; }
+    uint32_t max_batch_events() const { return max_batch_events_; }
+    uint32_t max_batch_bytes() const { return max_batch_bytes_; }
+    uint32_t max_batch_delay_us() const { return max_batch_delay_us_; }
+    bool adaptive_batching() const { return adaptive_batching_; }
+    double client_max_events_per_sec() const { return client_max_events_per_sec_; }
+    double client_max_bytes_per_sec() const { return client_max_bytes_per_sec_; }
+    RateLimitMode rate_limit_mode() const { return rate_limit_mode_; }
+    uint32_t rate_limit_block_ms() const { return rate_limit_block_ms_; }
+    uint32_t rate_limit_sample_every() const { return rate_limit_sample_every_; }
+    uint32_t rate_limit_burst_ms() const { return rate_limit_burst_ms_; }
+    uint32_t high_priority_weight() const { return high_priority_weight_; }
+    uint32_t normal_priority_weight() const { return normal_priority_weight_; }
+    uint32_t low_priority_weight() const { return low_priority_weight_; }
+    uint32_t drain_timeout_ms() const { return drain_timeout_ms_; }
+
+    bool batching_;
+    uint32_t max_batch_events_;
+    uint32_t max_batch_bytes_;
+    uint32_t max_batch_delay_us_;
+    bool adaptive_batching_;
+    double client_max_events_per_sec_;
+    double client_max_bytes_per_sec_;
+    RateLimitMode rate_limit_mode_;
+    uint32_t rate_limit_block_ms_;
+    uint32_t rate_limit_sample_every_;
+    uint32_t rate_limit_burst_ms_;
+    uint32_t high_priority_weight_;
+    uint32_t normal_priority_weight_;
+    uint32_t low_priority_weight_;
+    uint32_t drain_timeout_ms_;
+};
+
+// Deadlines and hedging of the client RPCs. With a non zero rpc_timeout_ms every RPC the client issues
+// fails with a timeout once the deadline passes instead of waiting on an unresponsive service.
+// With hedging an event batch that is not acknowledged within the hedge_percentile send latency of its
+// keeper is sent again to another keeper of the story, and a playback request that is not answered within
+// the hedge_percentile playback latency is issued again to another player ; the first response wins,
+// the duplicate events are merged by their EventSequence.
+struct ClientRpcConf
+{
+    ClientRpcConf( uint32_t rpc_timeout_ms=0, bool hedging=false, double hedge_percentile=0.95)
+        : rpc_timeout_ms_(rpc_timeout_ms)
+        , hedging_(hedging)
+        , hedge_percentile_(hedge_percentile)
+        {}
+
+    uint32_t rpc_timeout_ms() const { return rpc_timeout_ms_; }
+    bool hedging() const { return hedging_; }
+    double hedge_percentile() const { return hedge_percentile_; }
+
+    uint32_t rpc_timeout_ms_;
+    bool hedging_;
+    double hedge_percentile_;
+};
+
+// Memory budget of the client: max_memory_bytes (0 for no cap) bounds the bytes held together by the keeper
+// batch staging buffers, the event batches being sent and the received playback StoryChunks.
+// Past reclaim_percent of the cap the staged keeper batches are sent early to release their memory ;
+// at the cap the writers and the playback transfers wait up to memory_wait_ms for memory to be released.
+struct ClientMemoryConf
+{
+    ClientMemoryConf( uint64_t max_memory_bytes=0, uint32_t reclaim_percent=80, uint32_t memory_wait_ms=1000)
+        : max_memory_bytes_(max_memory_bytes)
+        , reclaim_percent_(reclaim_percent)
+        , memory_wait_ms_(memory_wait_ms)
+        {}
+
+    uint64_t max_memory_bytes() const { return max_memory_bytes_; }
+    uint32_t reclaim_percent() const { return reclaim_percent_; }
+    uint32_t memory_wait_ms() const { return memory_wait_ms_; }
+
+    uint64_t max_memory_bytes_;
+    uint32_t reclaim_percent_;
+    uint32_t memory_wait_ms_;
+};
+
+// Node-local aggregation: the client processes of a node that enable it share the shared memory segment
+// segment_name, with a ring of ring_bytes for each of up to process_slots processes, and one of them forwards
+// the events of all the rings to the keepers. The forwarder looks for new events every forward_poll_us,
+// the other processes try to take over its role every election_interval_ms, and a writer that finds its ring
+// full for ring_wait_ms sends the event directly.
+struct ClientAggregationConf
+{
+    ClientAggregationConf( bool node_aggregation=false, std::string const& segment_name="/chronolog_aggregator"
+            , uint32_t process_slots=64, uint64_t ring_bytes=1048576, uint32_t ring_wait_ms=100
+            , uint32_t forward_poll_us=200, uint32_t election_interval_ms=100)
+        : node_aggregation_(node_aggregation)
+        , segment_name_(segment_name)
+        , process_slots_(process_slots)
+        , ring_bytes_(ring_bytes)
+        , ring_wait_ms_(ring_wait_ms)
+        , forward_poll_us_(forward_poll_us)
+        , election_interval_ms_(election_interval_ms)
+        {}
+
+    bool node_aggregation() const { return node_aggregation_; }
+    std::string const& segment_name() const { return segment_name_; }
+    uint32_t process_slots() const { return process_slots_; }
+    uint64_t ring_bytes() const { return ring_bytes_; }
+    uint32_t ring_wait_ms() const { return ring_wait_ms_; }
+    uint32_t forward_poll_us() const { return forward_poll_us_; }
+    uint32_t election_interval_ms() const { return election_interval_ms_; }
+
+    bool node_aggregation_;
+    std::string segment_name_;
+    uint32_t process_slots_;
+    uint64_t ring_bytes_;
+    uint32_t ring_wait_ms_;
+    uint32_t forward_poll_us_;
+    uint32_t election_interval_ms_;
+};
+
 }
 #endif
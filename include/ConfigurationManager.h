@@ -64,6 +64,9 @@ typedef struct LogConf_
     size_t LOGFILESIZE;
     size_t LOGFILENUM;
     spdlog::level::level_enum FLUSHLEVEL;
+    bool LOGASYNC;
+    size_t LOGASYNCQUEUESIZE;
+    bool LOGASYNCBLOCK;   // block the caller when the async queue is full instead of dropping the oldest message
 
     // Helper function to convert spdlog::level::level_enum to string
     static std::string LevelToString(spdlog::level::level_enum level)
@@ -93,10 +96,110 @@ typedef struct LogConf_
     {
         return "[TYPE: " + LOGTYPE + ", FILE: " + LOGFILE + ", LEVEL: " + LevelToString(LOGLEVEL) + ", NAME: " +
                LOGNAME + ", LOGFILESIZE: " + std::to_string(LOGFILESIZE) + ", LOGFILENUM: " +
-               std::to_string(LOGFILENUM) + ", FLUSH LEVEL: " + LevelToString(FLUSHLEVEL) + "]";
+               std::to_string(LOGFILENUM) + ", FLUSH LEVEL: " + LevelToString(FLUSHLEVEL) + ", ASYNC: " +
+               (LOGASYNC ? "true" : "false") + ", ASYNC QUEUE SIZE: " + std::to_string(LOGASYNCQUEUESIZE) +
+               ", ASYNC OVERFLOW: " + (LOGASYNCBLOCK ? "block" : "overrun_oldest") + "]";
     }
 } LogConf;
 
+typedef struct MetricsConf_
+{
+    std::string METRICS_FILE;
+    uint32_t DUMP_INTERVAL_SEC;
+    std::string DUMP_FORMAT;
+
+    [[nodiscard]] std::string to_String() const
+    {
+        return "[FILE: " + METRICS_FILE + ", DUMP_INTERVAL_SEC: " + std::to_string(DUMP_INTERVAL_SEC) + ", FORMAT: " +
+               DUMP_FORMAT + "]";
+    }
+} MetricsConf;
+
+typedef struct RecordingConf_
+{
+    // initialized here, a configuration file does not have to carry the Recording section
+    bool BATCHING = false;
+    uint32_t MAX_BATCH_EVENTS = 512;
+    uint32_t MAX_BATCH_BYTES = 1 << 20;
+    uint32_t MAX_BATCH_DELAY_US = 1000;
+    bool ADAPTIVE_BATCHING = false;
+    double CLIENT_MAX_EVENTS_PER_SEC = 0;
+    double CLIENT_MAX_BYTES_PER_SEC = 0;
+    std::string RATE_LIMIT_MODE = "block";
+    uint32_t RATE_LIMIT_BLOCK_MS = 100;
+    uint32_t RATE_LIMIT_SAMPLE_EVERY = 100;
+    uint32_t RATE_LIMIT_BURST_MS = 100;
+    uint32_t HIGH_PRIORITY_WEIGHT = 4;
+    uint32_t NORMAL_PRIORITY_WEIGHT = 2;
+    uint32_t LOW_PRIORITY_WEIGHT = 1;
+    uint32_t DRAIN_TIMEOUT_MS = 5000;
+
+    [[nodiscard]] std::string to_String() const
+    {
+        return "[BATCHING: " + std::string(BATCHING ? "true" : "false") + ", MAX_BATCH_EVENTS: " +
+               std::to_string(MAX_BATCH_EVENTS) + ", MAX_BATCH_BYTES: " + std::to_string(MAX_BATCH_BYTES) +
+               ", MAX_BATCH_DELAY_US: " + std::to_string(MAX_BATCH_DELAY_US) + ", ADAPTIVE_BATCHING: " +
+               std::string(ADAPTIVE_BATCHING ? "true" : "false") + ", CLIENT_MAX_EVENTS_PER_SEC: " +
+               std::to_string(CLIENT_MAX_EVENTS_PER_SEC) + ", CLIENT_MAX_BYTES_PER_SEC: " +
+               std::to_string(CLIENT_MAX_BYTES_PER_SEC) + ", RATE_LIMIT_MODE: " + RATE_LIMIT_MODE +
+               ", RATE_LIMIT_BLOCK_MS: " + std::to_string(RATE_LIMIT_BLOCK_MS) + ", RATE_LIMIT_SAMPLE_EVERY: " +
+               std::to_string(RATE_LIMIT_SAMPLE_EVERY) + ", RATE_LIMIT_BURST_MS: " +
+               std::to_string(RATE_LIMIT_BURST_MS) + ", HIGH_PRIORITY_WEIGHT: " + std::to_string(HIGH_PRIORITY_WEIGHT) +
+               ", NORMAL_PRIORITY_WEIGHT: " + std::to_string(NORMAL_PRIORITY_WEIGHT) + ", LOW_PRIORITY_WEIGHT: " +
+               std::to_string(LOW_PRIORITY_WEIGHT) + ", DRAIN_TIMEOUT_MS: " + std::to_string(DRAIN_TIMEOUT_MS) + "]";
+    }
+} RecordingConf;
+
+typedef struct RpcPolicyConf_
+{
+    // initialized here, a configuration file does not have to carry the RpcPolicy section
+    uint32_t RPC_TIMEOUT_MS = 0;
+    bool HEDGING = false;
+    double HEDGE_PERCENTILE = 0.95;
+
+    [[nodiscard]] std::string to_String() const
+    {
+        return "[RPC_TIMEOUT_MS: " + std::to_string(RPC_TIMEOUT_MS) + ", HEDGING: " +
+               std::string(HEDGING ? "true" : "false") + ", HEDGE_PERCENTILE: " + std::to_string(HEDGE_PERCENTILE) +
+               "]";
+    }
+} RpcPolicyConf;
+
+typedef struct MemoryConf_
+{
+    // initialized here, a configuration file does not have to carry the Memory section
+    uint64_t MAX_MEMORY_BYTES = 0;
+    uint32_t RECLAIM_PERCENT = 80;
+    uint32_t MEMORY_WAIT_MS = 1000;
+
+    [[nodiscard]] std::string to_String() const
+    {
+        return "[MAX_MEMORY_BYTES: " + std::to_string(MAX_MEMORY_BYTES) + ", RECLAIM_PERCENT: " +
+               std::to_string(RECLAIM_PERCENT) + ", MEMORY_WAIT_MS: " + std::to_string(MEMORY_WAIT_MS) + "]";
+    }
+} MemoryConf;
+
+typedef struct AggregationConf_
+{
+    // initialized here, a configuration file does not have to carry the Aggregation section
+    bool NODE_AGGREGATION = false;
+    std::string SEGMENT_NAME = "/chronolog_aggregator";
+    uint32_t PROCESS_SLOTS = 64;
+    uint64_t RING_BYTES = 1048576;
+    uint32_t RING_WAIT_MS = 100;
+    uint32_t FORWARD_POLL_US = 200;
+    uint32_t ELECTION_INTERVAL_MS = 100;
+
+    [[nodiscard]] std::string to_String() const
+    {
+        return "[NODE_AGGREGATION: " + std::string(NODE_AGGREGATION ? "true" : "false") + ", SEGMENT_NAME: " +
+               SEGMENT_NAME + ", PROCESS_SLOTS: " + std::to_string(PROCESS_SLOTS) + ", RING_BYTES: " +
+               std::to_string(RING_BYTES) + ", RING_WAIT_MS: " + std::to_string(RING_WAIT_MS) +
+               ", FORWARD_POLL_US: " + std::to_string(FORWARD_POLL_US) + ", ELECTION_INTERVAL_MS: " +
+               std::to_string(ELECTION_INTERVAL_MS) + "]";
+    }
+} AggregationConf;
+
 typedef struct VisorClientPortalServiceConf_
 {
     RPCProviderConf RPC_CONF;
@@ -285,12 +388,22 @@ typedef struct ClientConf_
     RPCProviderConf CLIENT_QUERY_SERVICE_CONF;
     VisorClientPortalServiceConf VISOR_CLIENT_PORTAL_SERVICE_CONF;
     LogConf CLIENT_LOG_CONF;
+    MetricsConf CLIENT_METRICS_CONF;
+    RecordingConf CLIENT_RECORDING_CONF;
+    RpcPolicyConf CLIENT_RPC_POLICY_CONF;
+    MemoryConf CLIENT_MEMORY_CONF;
+    AggregationConf CLIENT_AGGREGATION_CONF;
 
     [[nodiscard]] std::string to_String() const
     {
         return "[CLIENT_QUERY_SERVICE_CONF: " + CLIENT_QUERY_SERVICE_CONF.to_String() +
             ", [VISOR_CLIENT_PORTAL_SERVICE_CONF: " + VISOR_CLIENT_PORTAL_SERVICE_CONF.to_String() +
-               ", CLIENT_LOG_CONF:" + CLIENT_LOG_CONF.to_String() + "]";
+               ", CLIENT_LOG_CONF:" + CLIENT_LOG_CONF.to_String() +
+               ", CLIENT_METRICS_CONF:" + CLIENT_METRICS_CONF.to_String() +
+               ", CLIENT_RECORDING_CONF:" + CLIENT_RECORDING_CONF.to_String() +
+               ", CLIENT_RPC_POLICY_CONF:" + CLIENT_RPC_POLICY_CONF.to_String() +
+               ", CLIENT_MEMORY_CONF:" + CLIENT_MEMORY_CONF.to_String() +
+               ", CLIENT_AGGREGATION_CONF:" + CLIENT_AGGREGATION_CONF.to_String() + "]";
     }
 } ClientConf;
 
@@ -365,6 +478,13 @@ public:
         CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.PROTO_CONF = "ofi+sockets";
         CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.BASE_PORT = 5555;
         CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.SERVICE_PROVIDER_ID = 55;
+        CLIENT_CONF.CLIENT_METRICS_CONF.METRICS_FILE = "";
+        CLIENT_CONF.CLIENT_METRICS_CONF.DUMP_INTERVAL_SEC = 10;
+        CLIENT_CONF.CLIENT_METRICS_CONF.DUMP_FORMAT = "json";
+        CLIENT_CONF.CLIENT_RECORDING_CONF.BATCHING = false;
+        CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_EVENTS = 512;
+        CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_BYTES = 1 << 20;
+        CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_DELAY_US = 1000;
 
         PrintConf();
     }
@@ -780,6 +900,21 @@ private:
                 assert(json_object_is_type(val, json_type_string));
                 parseFlushLevelConf(val, log_conf.FLUSHLEVEL);
             }
+            else if(strcmp(key, "async") == 0)
+            {
+                assert(json_object_is_type(val, json_type_boolean));
+                log_conf.LOGASYNC = json_object_get_boolean(val);
+            }
+            else if(strcmp(key, "async_queue_size") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                log_conf.LOGASYNCQUEUESIZE = json_object_get_int(val);
+            }
+            else if(strcmp(key, "async_overflow_policy") == 0)
+            {
+                assert(json_object_is_type(val, json_type_string));
+                log_conf.LOGASYNCBLOCK = (strcmp(json_object_get_string(val), "block") == 0);
+            }
             else
             {
                 std::cerr << "[ConfigurationManager] Unknown log configuration: " << key << std::endl;
@@ -787,6 +922,223 @@ private:
         }
     }
 
+    void parseRecordingConf(json_object*json_conf, RecordingConf &recording_conf)
+    {
+        json_object_object_foreach(json_conf, key, val)
+        {
+            if(strcmp(key, "batching") == 0)
+            {
+                assert(json_object_is_type(val, json_type_boolean));
+                recording_conf.BATCHING = json_object_get_boolean(val);
+            }
+            else if(strcmp(key, "max_batch_events") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.MAX_BATCH_EVENTS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "max_batch_bytes") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.MAX_BATCH_BYTES = json_object_get_int(val);
+            }
+            else if(strcmp(key, "max_batch_delay_us") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.MAX_BATCH_DELAY_US = json_object_get_int(val);
+            }
+            else if(strcmp(key, "adaptive_batching") == 0)
+            {
+                assert(json_object_is_type(val, json_type_boolean));
+                recording_conf.ADAPTIVE_BATCHING = json_object_get_boolean(val);
+            }
+            else if(strcmp(key, "client_max_events_per_sec") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int) || json_object_is_type(val, json_type_double));
+                recording_conf.CLIENT_MAX_EVENTS_PER_SEC = json_object_get_double(val);
+            }
+            else if(strcmp(key, "client_max_bytes_per_sec") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int) || json_object_is_type(val, json_type_double));
+                recording_conf.CLIENT_MAX_BYTES_PER_SEC = json_object_get_double(val);
+            }
+            else if(strcmp(key, "rate_limit_mode") == 0)
+            {
+                assert(json_object_is_type(val, json_type_string));
+                recording_conf.RATE_LIMIT_MODE = json_object_get_string(val);
+                if(recording_conf.RATE_LIMIT_MODE != "block" && recording_conf.RATE_LIMIT_MODE != "drop"
+                   && recording_conf.RATE_LIMIT_MODE != "sample")
+                {
+                    std::cerr << "[ConfigurationManager] Unknown rate_limit_mode: " << recording_conf.RATE_LIMIT_MODE
+                              << ", using block" << std::endl;
+                    recording_conf.RATE_LIMIT_MODE = "block";
+                }
+            }
+            else if(strcmp(key, "rate_limit_block_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.RATE_LIMIT_BLOCK_MS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "rate_limit_sample_every") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.RATE_LIMIT_SAMPLE_EVERY = json_object_get_int(val);
+            }
+            else if(strcmp(key, "rate_limit_burst_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.RATE_LIMIT_BURST_MS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "high_priority_weight") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.HIGH_PRIORITY_WEIGHT = json_object_get_int(val);
+            }
+            else if(strcmp(key, "normal_priority_weight") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.NORMAL_PRIORITY_WEIGHT = json_object_get_int(val);
+            }
+            else if(strcmp(key, "low_priority_weight") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.LOW_PRIORITY_WEIGHT = json_object_get_int(val);
+            }
+            else if(strcmp(key, "drain_timeout_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                recording_conf.DRAIN_TIMEOUT_MS = json_object_get_int(val);
+            }
+            else
+            {
+                std::cerr << "[ConfigurationManager] Unknown recording configuration: " << key << std::endl;
+            }
+        }
+    }
+
+    void parseRpcPolicyConf(json_object*json_conf, RpcPolicyConf &rpc_policy_conf)
+    {
+        json_object_object_foreach(json_conf, key, val)
+        {
+            if(strcmp(key, "rpc_timeout_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                rpc_policy_conf.RPC_TIMEOUT_MS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "hedging") == 0)
+            {
+                assert(json_object_is_type(val, json_type_boolean));
+                rpc_policy_conf.HEDGING = json_object_get_boolean(val);
+            }
+            else if(strcmp(key, "hedge_percentile") == 0)
+            {
+                assert(json_object_is_type(val, json_type_double));
+                rpc_policy_conf.HEDGE_PERCENTILE = json_object_get_double(val);
+            }
+            else
+            {
+                std::cerr << "[ConfigurationManager] Unknown rpc policy configuration: " << key << std::endl;
+            }
+        }
+    }
+
+    void parseMemoryConf(json_object*json_conf, MemoryConf &memory_conf)
+    {
+        json_object_object_foreach(json_conf, key, val)
+        {
+            if(strcmp(key, "max_memory_bytes") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                memory_conf.MAX_MEMORY_BYTES = json_object_get_int64(val);
+            }
+            else if(strcmp(key, "reclaim_percent") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                memory_conf.RECLAIM_PERCENT = json_object_get_int(val);
+            }
+            else if(strcmp(key, "memory_wait_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                memory_conf.MEMORY_WAIT_MS = json_object_get_int(val);
+            }
+            else
+            {
+                std::cerr << "[ConfigurationManager] Unknown memory configuration: " << key << std::endl;
+            }
+        }
+    }
+
+    void parseAggregationConf(json_object*json_conf, AggregationConf &aggregation_conf)
+    {
+        json_object_object_foreach(json_conf, key, val)
+        {
+            if(strcmp(key, "node_aggregation") == 0)
+            {
+                assert(json_object_is_type(val, json_type_boolean));
+                aggregation_conf.NODE_AGGREGATION = json_object_get_boolean(val);
+            }
+            else if(strcmp(key, "segment_name") == 0)
+            {
+                assert(json_object_is_type(val, json_type_string));
+                aggregation_conf.SEGMENT_NAME = json_object_get_string(val);
+            }
+            else if(strcmp(key, "process_slots") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                aggregation_conf.PROCESS_SLOTS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "ring_bytes") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                aggregation_conf.RING_BYTES = json_object_get_int64(val);
+            }
+            else if(strcmp(key, "ring_wait_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                aggregation_conf.RING_WAIT_MS = json_object_get_int(val);
+            }
+            else if(strcmp(key, "forward_poll_us") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                aggregation_conf.FORWARD_POLL_US = json_object_get_int(val);
+            }
+            else if(strcmp(key, "election_interval_ms") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                aggregation_conf.ELECTION_INTERVAL_MS = json_object_get_int(val);
+            }
+            else
+            {
+                std::cerr << "[ConfigurationManager] Unknown aggregation configuration: " << key << std::endl;
+            }
+        }
+    }
+
+    void parseMetricsConf(json_object*json_conf, MetricsConf &metrics_conf)
+    {
+        json_object_object_foreach(json_conf, key, val)
+        {
+            if(strcmp(key, "file") == 0)
+            {
+                assert(json_object_is_type(val, json_type_string));
+                metrics_conf.METRICS_FILE = json_object_get_string(val);
+            }
+            else if(strcmp(key, "dump_interval_sec") == 0)
+            {
+                assert(json_object_is_type(val, json_type_int));
+                metrics_conf.DUMP_INTERVAL_SEC = json_object_get_int(val);
+            }
+            else if(strcmp(key, "format") == 0)
+            {
+                assert(json_object_is_type(val, json_type_string));
+                metrics_conf.DUMP_FORMAT = json_object_get_string(val);
+            }
+            else
+            {
+                std::cerr << "[ConfigurationManager] Unknown metrics configuration: " << key << std::endl;
+            }
+        }
+    }
+
     void parseVisorConf(json_object*json_conf)
     {
         json_object_object_foreach(json_conf, key, val)
@@ -1009,6 +1361,26 @@ private:
                     }
                 }
             }
+            else if(strcmp(key, "Recording") == 0)
+            {
+                assert(json_object_is_type(val, json_type_object));
+                parseRecordingConf(val, CLIENT_CONF.CLIENT_RECORDING_CONF);
+            }
+            else if(strcmp(key, "RpcPolicy") == 0)
+            {
+                assert(json_object_is_type(val, json_type_object));
+                parseRpcPolicyConf(val, CLIENT_CONF.CLIENT_RPC_POLICY_CONF);
+            }
+            else if(strcmp(key, "Memory") == 0)
+            {
+                assert(json_object_is_type(val, json_type_object));
+                parseMemoryConf(val, CLIENT_CONF.CLIENT_MEMORY_CONF);
+            }
+            else if(strcmp(key, "Aggregation") == 0)
+            {
+                assert(json_object_is_type(val, json_type_object));
+                parseAggregationConf(val, CLIENT_CONF.CLIENT_AGGREGATION_CONF);
+            }
             else if(strcmp(key, "Monitoring") == 0)
             {
                 assert(json_object_is_type(val, json_type_object));
@@ -1019,6 +1391,10 @@ private:
                     {
                         parseLogConf(val, CLIENT_CONF.CLIENT_LOG_CONF);
                     }
+                    else if(strcmp(key, "metrics") == 0)
+                    {
+                        parseMetricsConf(val, CLIENT_CONF.CLIENT_METRICS_CONF);
+                    }
                     else
                     {
                         std::cerr << "[ConfigurationManager] Unknown ClientLog configuration: " << key << std::endl;
@@ -1,12 +1,20 @@
 #ifndef CHRONOLOG_CLIENT_H
 #define CHRONOLOG_CLIENT_H
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <sys/uio.h>
+#ifdef CHRONOLOG_ENABLE_MPI
+#include <mpi.h>
+#endif
 
 #include "ConfigurationManager.h" 
 #include "ClientConfiguration.h"
+#include "chronolog_format.h"
 
 namespace chronolog
 {
@@ -17,6 +25,10 @@ typedef uint64_t ClientId;
 typedef uint64_t chrono_time;
 typedef uint32_t chrono_index;
 
+// timestamp of the events logged by the client, in nanoseconds
+inline chrono_time event_timestamp()
+{ return std::chrono::high_resolution_clock::now().time_since_epoch().count(); }
+
 class Event
 {
 public:
@@ -40,6 +52,13 @@ public:
     std::string const& log_record() const
     { return logRecord; }
 
+    Event(chrono_time event_time, ClientId client_id, chrono_index index, std::string &&record)
+        : eventTime(event_time)
+        , clientId(client_id)
+        , eventIndex(index)
+        , logRecord(std::move(record))
+    { }
+
     Event( Event const& other)
         : eventTime(other.time())
         , clientId(other.client_id())
@@ -47,6 +66,13 @@ public:
         , logRecord(other.log_record())
     { }
 
+    Event( Event && other) noexcept
+        : eventTime(other.eventTime)
+        , clientId(other.clientId)
+        , eventIndex(other.eventIndex)
+        , logRecord(std::move(other.logRecord))
+    { }
+
     Event& operator= (const Event & other) 
     {
         if (this != &other) 
@@ -59,6 +85,18 @@ public:
         return *this;
     }
 
+    Event& operator= (Event && other) noexcept
+    {
+        if (this != &other)
+        {
+            eventTime = other.eventTime;
+            clientId = other.clientId;
+            eventIndex = other.eventIndex;
+            logRecord = std::move(other.logRecord);
+        }
+        return *this;
+    }
+
     bool operator== (const Event &other) const
     {
         return (eventTime == other.eventTime && clientId == other.clientId && eventIndex == other.eventIndex );
@@ -98,6 +136,8 @@ private:
 
 };
 
+class StoryWriter;
+
 class StoryHandle
 {
 public:
@@ -105,26 +145,156 @@ public:
 
     virtual int log_event(std::string const &) = 0;
 
+    // the record is moved into the event instead of being copied
+    virtual int log_event(std::string &&record);
+
+    int log_event(std::string_view record)
+    { return log_event(std::string(record)); }
+
+    int log_event(char const *record)
+    { return log_event(std::string(record)); }
+
+    // deferred formatting, story_handle->log(FMT_ID("x=%d y=%f"), x, y) ; see chronolog_format.h
+    template <typename... Args>
+    int log(FormatId const &format_id, Args const &... args)
+    {
+        thread_local std::string record;
+        encode_deferred_record(record, format_id, args...);
+        return log_deferred_event(format_id, record);
+    }
+
+    // logs the records with a contiguous range of event indices, as one batch sent to one keeper if the story
+    // keepers serve the batch RPC and the keeper batchers are not enabled (see STORY_ATTR_KEEPER_BATCH_RPC) ;
+    // the events share one timestamp unless timestamp_each, returns the number of events logged
+    virtual int log_events(std::string_view const *records, std::size_t count, bool timestamp_each = false);
+
+    virtual int log_events(struct iovec const *records, std::size_t count, bool timestamp_each = false);
+
+    // logs an encoded deferred record
+    virtual int log_deferred_event(FormatId const &, std::string const &record);
+
     virtual int playback_story(uint64_t start, uint64_t end, std::vector<Event> & playback_events) = 0;
+
+    // non-virtual fast path writer for this story, see StoryWriter
+    virtual StoryWriter get_writer();
+
+    // blocks until every event logged on this story before the call was acknowledged by the ChronoKeepers ;
+    // CL_ERR_TIMEOUT if the deadline passed first, CL_ERR_NOT_ACKNOWLEDGED if events sent to the keepers
+    // of the story were lost since the previous flush of this handle
+    virtual int flush(std::chrono::steady_clock::time_point const &deadline);
+
+    int flush()
+    { return flush(std::chrono::steady_clock::time_point::max()); }
+};
+
+// records an event already timestamped and indexed, for the handle type the function was taken from
+typedef int (*RecordEventFunction)(StoryHandle*, chrono_time, chrono_index, std::string &&);
+
+// Non-virtual writer of an acquired story : the timestamping and indexing of log_event are inlined
+// into the caller and the event goes straight to the keeper selection, without virtual dispatch.
+// Obtained with StoryHandle::get_writer(), only valid while the story stays acquired.
+class StoryWriter final
+{
+public:
+    StoryWriter(StoryHandle *story_handle = nullptr, std::atomic <uint32_t> *event_index = nullptr
+                , RecordEventFunction record_event = nullptr)
+        : storyHandle(story_handle)
+        , eventIndex(event_index)
+        , recordEvent(record_event)
+    {}
+
+    // same return value as StoryHandle::log_event
+    int log_event(std::string &&record)
+    {
+        if(eventIndex == nullptr || recordEvent == nullptr)
+        { return storyHandle->log_event(std::move(record)); }
+
+        chrono_time event_time = event_timestamp();
+        chrono_index event_index = eventIndex->fetch_add(1, std::memory_order_relaxed) + 1;
+        return recordEvent(storyHandle, event_time, event_index, std::move(record));
+    }
+
+    int log_event(std::string const &record)
+    { return log_event(std::string(record)); }
+
+    int log_event(std::string_view record)
+    { return log_event(std::string(record)); }
+
+    int log_event(char const *record)
+    { return log_event(std::string(record)); }
+
+    StoryHandle *story_handle() const
+    { return storyHandle; }
+
+private:
+    StoryHandle *storyHandle;
+    std::atomic <uint32_t> *eventIndex;
+    RecordEventFunction recordEvent;
 };
 
 class ChronologClientImpl;
 
+#ifdef CHRONOLOG_ENABLE_MPI
+// where the events of a collective playback end up
+enum PlaybackRedistribution
+{
+    PLAYBACK_TIME_SLICES = 0,   // every rank keeps the events of its time slice
+    PLAYBACK_BALANCED = 1,      // the ranks hold consecutive time ranges with the same number of events
+    PLAYBACK_BY_CLIENT = 2      // an event goes to rank client_id % ranks, each rank sorted by time
+};
+#endif
+
 // top level Chronolog Client...
 // implementation details are in the ChronologClientImpl class 
+// the Clients of a process are independent, each one can talk to its own ChronoLog deployment or network interface
 class Client
 {
 public:
     Client(ChronoLog::ConfigurationManager const &);
     
-    Client(ClientPortalServiceConf const &);
+    // the query service engine listens on any interface of the portal protocol, at a port of its choosing
+    Client(ClientPortalServiceConf const &, ClientRecordingConf const & = ClientRecordingConf()
+           , ClientRpcConf const & = ClientRpcConf(), ClientMemoryConf const & = ClientMemoryConf()
+           , ClientAggregationConf const & = ClientAggregationConf());
+
+    // the query service engine listens where ClientQueryServiceConf says, one client per NIC for instance
+    Client(ClientPortalServiceConf const &, ClientQueryServiceConf const &
+           , ClientRecordingConf const & = ClientRecordingConf(), ClientRpcConf const & = ClientRpcConf()
+           , ClientMemoryConf const & = ClientMemoryConf(), ClientAggregationConf const & = ClientAggregationConf());
 
     ~Client();
 
+    Client(Client const &) = delete;
+    Client &operator=(Client const &) = delete;
+
     int Connect();
 
+    // stops taking events and gives the buffered ones drain_timeout_ms to be acknowledged by the ChronoKeepers,
+    // CL_ERR_TIMEOUT or CL_ERR_NOT_ACKNOWLEDGED if some were lost ; the destructor drains a connected client too
     int Disconnect();
 
+#ifdef CHRONOLOG_ENABLE_MPI
+    // collective over comm : rank 0 connects to the Visor and broadcasts the response, every rank records
+    // with a client id of its own derived from it ; ReleaseStory and Disconnect only reach the Visor from rank 0,
+    // which should call them once the other ranks are done
+    int ConnectAll(MPI_Comm comm);
+
+    // collective over comm : rank 0 acquires the story from the Visor and broadcasts the story id and keepers,
+    // every rank builds its StoryHandle locally ; all the ranks return the same error code
+    std::pair <int, StoryHandle*> AcquireStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                                         , std::string const &story_name
+                                                         , const std::map <std::string, std::string> &attrs
+                                                         , int &flags);
+
+    // collective over comm, the story acquired by every rank : [start, end) is split in consecutive ranges of
+    // whole chunk_duration chunks, one per rank, each read in concurrent_queries sub-queries that run on a fixed
+    // pool of client threads, then the events are redistributed ; all the ranks return the same error code
+    int PlaybackStoryCollective(MPI_Comm comm, std::string const &chronicle_name, std::string const &story_name
+                                , uint64_t start, uint64_t end, std::vector <Event> &playback_events
+                                , uint64_t chunk_duration, uint32_t concurrent_queries = 4
+                                , PlaybackRedistribution redistribution = PLAYBACK_TIME_SLICES);
+#endif
+
     int CreateChronicle(std::string const &chronicle_name, std::map <std::string, std::string> const &attrs , int &flags);
 
     int DestroyChronicle(std::string const &chronicle_name);
@@ -145,6 +315,17 @@ public:
 
     std::vector <std::string> &ShowStories(std::string const &chronicle_name, std::vector <std::string> &);
 
+    // snapshot of the SDK metrics of this client (per keeper send latency, events/bytes sent, playback ingest...)
+    // and of the process-wide Visor RPC latency, rendered as "json" or "prometheus" text exposition format
+    std::string &GetMetricsSnapshot(std::string &snapshot, std::string const &format = "json");
+
+    // durability point : blocks until every event logged by this client before the call was acknowledged
+    // by the ChronoKeepers, same return codes as StoryHandle::flush
+    int Flush(std::chrono::steady_clock::time_point const &deadline = std::chrono::steady_clock::time_point::max());
+
+    // bytes the SDK buffers hold right now, memory_limit is set to the configured cap (0 for none)
+    uint64_t GetMemoryUsage(uint64_t &memory_limit) const;
+
 private:
     ChronologClientImpl*chronologClientImpl;
 };
@@ -31,6 +31,10 @@ enum ErrorCode
     CL_ERR_STORY_CHUNK_DSET_NOT_EXIST = -20,// Story chunk dataset does not exist
     CL_ERR_STORY_CHUNK_EXTRACTION = -21,    // Error in extracting Story chunk in ChronoKeeper
     CL_ERR_NO_PLAYERS = -22,                // No ChronoPlayers are available for story playback
+    CL_ERR_TIMEOUT = -23,                   // Deadline passed before the operation completed
+    CL_ERR_NOT_ACKNOWLEDGED = -24,          // Some events were not acknowledged by the ChronoKeepers
+    CL_ERR_EVENT_SHED = -25,                // Low priority event shed by the client under overload
+    CL_ERR_NO_MEMORY = -26,                 // Client memory budget exhausted
 };
 }
 
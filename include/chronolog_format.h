@@ -0,0 +1,168 @@
+#ifndef CHRONOLOG_FORMAT_H
+#define CHRONOLOG_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace chronolog
+{
+
+// Deferred formatting of the event records:
+//
+//     story_handle->log(FMT_ID("x=%d y=%f"), x, y);
+//
+// only the binary arguments and the id of the printf style format string are sent with the event,
+// the text is produced on the playback/export side by render_record() or render_deferred_events().
+// The format id is a hash of the format string, so any process that registered the same format
+// can render the record ; the StoryHandle also logs a format definition record the first time
+// it uses a format so that the story itself carries the format strings.
+//
+// deferred record   : 0x00 'F' | format id (8 bytes) | args...
+//    arg            : 'i' zigzag varint | 'u' varint | 'd' 8 bytes double | 's' length varint, bytes
+// format definition : 0x00 'D' | format id (8 bytes) | format string
+
+class FormatId
+{
+public:
+    FormatId(uint64_t format_id = 0, uint32_t format_slot = 0)
+        : id(format_id)
+        , slot(format_slot)
+    {}
+
+    uint64_t id;     // hash of the format string, the same in all the processes
+    uint32_t slot;   // registration order in this process, 0 for a format that was not registered
+};
+
+class FormatRegistry
+{
+public:
+    // registers the format string, registering the same string again returns the same FormatId
+    static FormatId register_format(char const *format_string);
+
+    // CL_ERR_NOT_EXIST if no format with this id was registered or learned from a definition record
+    static int find_format(uint64_t format_id, std::string &format_string);
+
+    // registers the format carried by a format definition record
+    static int learn_format(std::string const &definition_record);
+
+    static uint64_t format_id(char const *format_string);
+};
+
+// registers the format string once, on the first pass through the call site
+#define FMT_ID(format_string) \
+    ([]() -> chronolog::FormatId const & \
+    { \
+        static const chronolog::FormatId chronolog_format_id = chronolog::FormatRegistry::register_format(format_string); \
+        return chronolog_format_id; \
+    }())
+
+const char DEFERRED_RECORD_TAG = 'F';
+const char FORMAT_DEFINITION_TAG = 'D';
+
+inline bool is_deferred_record(std::string const &record)
+{ return (record.size() >= 10 && record[0] == '\0' && record[1] == DEFERRED_RECORD_TAG); }
+
+inline bool is_format_definition(std::string const &record)
+{ return (record.size() >= 10 && record[0] == '\0' && record[1] == FORMAT_DEFINITION_TAG); }
+
+// CL_ERR_NOT_EXIST if the format was not registered in this process
+int make_format_definition(FormatId const &format_id, std::string &definition_record);
+
+// formats a deferred record, plain text records are copied as they are ;
+// CL_ERR_NOT_EXIST if the format is unknown, CL_ERR_INVALID_ARG if the record is malformed
+int render_record(std::string const &record, std::string &text);
+
+class Event;
+
+// learns the format definitions carried by the events, drops them and replaces
+// the deferred records with their text
+void render_deferred_events(std::vector <Event> &events);
+
+namespace format_detail
+{
+
+inline void put_varint(std::string &out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline void put_fixed(std::string &out, uint64_t value)
+{
+    char bytes[8];
+    for(int i = 0; i < 8; ++i)
+    { bytes[i] = static_cast<char>(value >> (8 * i)); }
+    out.append(bytes, 8);
+}
+
+inline void put_string(std::string &out, std::string_view a_string)
+{
+    out.push_back('s');
+    put_varint(out, a_string.size());
+    out.append(a_string.data(), a_string.size());
+}
+
+template <typename T>
+inline void put_arg(std::string &out, T const &arg)
+{
+    typedef typename std::decay <T>::type ArgType;
+    if constexpr(std::is_enum <ArgType>::value)
+    { put_arg(out, static_cast<typename std::underlying_type <ArgType>::type>(arg)); }
+    else if constexpr(std::is_same <ArgType, bool>::value || (std::is_integral <ArgType>::value
+                                                               && std::is_unsigned <ArgType>::value))
+    {
+        out.push_back('u');
+        put_varint(out, static_cast<uint64_t>(arg));
+    }
+    else if constexpr(std::is_integral <ArgType>::value)
+    {
+        int64_t value = static_cast<int64_t>(arg);
+        out.push_back('i');
+        put_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+    else if constexpr(std::is_floating_point <ArgType>::value)
+    {
+        double value = static_cast<double>(arg);
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        out.push_back('d');
+        put_fixed(out, bits);
+    }
+    else if constexpr(std::is_array <T>::value)
+    { put_string(out, std::string_view(arg)); }
+    else if constexpr(std::is_same <ArgType, char*>::value || std::is_same <ArgType, char const*>::value)
+    { put_string(out, (arg != nullptr ? std::string_view(arg) : std::string_view("(null)"))); }
+    else if constexpr(std::is_convertible <ArgType const &, std::string_view>::value)
+    { put_string(out, std::string_view(arg)); }
+    else if constexpr(std::is_pointer <ArgType>::value)
+    {
+        out.push_back('u');
+        put_varint(out, reinterpret_cast<uintptr_t>(arg));
+    }
+    else
+    { static_assert(std::is_arithmetic <ArgType>::value, "unsupported deferred format argument type"); }
+}
+
+}
+
+template <typename... Args>
+inline void encode_deferred_record(std::string &record, FormatId const &format_id, Args const &... args)
+{
+    record.clear();
+    record.push_back('\0');
+    record.push_back(DEFERRED_RECORD_TAG);
+    format_detail::put_fixed(record, format_id.id);
+    (format_detail::put_arg(record, args), ...);
+}
+
+}
+
+#endif
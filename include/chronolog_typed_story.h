@@ -0,0 +1,230 @@
+#ifndef CHRONOLOG_TYPED_STORY_H
+#define CHRONOLOG_TYPED_STORY_H
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "chronolog_client.h"
+
+namespace chronolog
+{
+
+// Typed records: trivially copyable structs logged as their raw bytes behind a 16 byte header,
+// no text encoding on the writer side and no parsing on the playback side.
+//
+//     struct Sample
+//     {
+//         static constexpr char const *schema_name = "sensor.sample.v1";
+//         uint64_t sensor;
+//         double value;
+//     };
+//     TypedStoryHandle <Sample> samples(story_handle);
+//     samples.log(Sample{7, 0.5});
+//
+// typed record : 0x00 'T' | 2 reserved bytes | payload size (4 bytes) | schema id (8 bytes) | Schema bytes
+//
+// the schema id hashes the schema name with the size and alignment of the struct, so the records of
+// a schema whose layout changed between the writer and the reader builds do not match.
+// The payload is the in-memory representation of the struct, writers and readers have to share the endianness.
+
+const char TYPED_RECORD_TAG = 'T';
+const std::size_t TYPED_RECORD_HEADER_SIZE = 16;
+
+// SchemaTraits can be specialized for structs that can not carry the schema_name member
+template <class Schema>
+class SchemaTraits
+{
+public:
+    static constexpr char const *name = Schema::schema_name;
+};
+
+constexpr uint64_t schema_hash(char const *schema_name, uint64_t size, uint64_t alignment)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(char const *c = schema_name; *c != '\0'; ++c)
+    { hash = (hash ^ static_cast<uint8_t>(*c)) * 1099511628211ull; }
+    hash = (hash ^ size) * 1099511628211ull;
+    return (hash ^ alignment) * 1099511628211ull;
+}
+
+inline bool is_typed_record(std::string const &record)
+{ return (record.size() >= TYPED_RECORD_HEADER_SIZE && record[0] == '\0' && record[1] == TYPED_RECORD_TAG); }
+
+template <class Schema>
+class TypedEvent
+{
+public:
+    TypedEvent(chrono_time event_time, ClientId client_id, chrono_index index, Schema const &a_record)
+        : eventTime(event_time)
+        , clientId(client_id)
+        , eventIndex(index)
+        , typedRecord(a_record)
+    {}
+
+    chrono_time time() const
+    { return eventTime; }
+
+    ClientId const &client_id() const
+    { return clientId; }
+
+    chrono_index index() const
+    { return eventIndex; }
+
+    Schema const &record() const
+    { return typedRecord; }
+
+private:
+    chrono_time eventTime;
+    ClientId clientId;
+    chrono_index eventIndex;
+    Schema typedRecord;
+};
+
+// a record of the schema in place in the Event it was played back in, valid as long as that Event
+template <class Schema>
+class TypedEventView
+{
+public:
+    TypedEventView(Event const &event, Schema const &a_record)
+        : theEvent(&event)
+        , typedRecord(&a_record)
+    {}
+
+    chrono_time time() const
+    { return theEvent->time(); }
+
+    ClientId const &client_id() const
+    { return theEvent->client_id(); }
+
+    chrono_index index() const
+    { return theEvent->index(); }
+
+    Schema const &record() const
+    { return *typedRecord; }
+
+private:
+    Event const *theEvent;
+    Schema const *typedRecord;
+};
+
+template <class Schema>
+class TypedStoryHandle
+{
+    static_assert(std::is_trivially_copyable <Schema>::value, "TypedStoryHandle schemas have to be trivially copyable");
+    static_assert(sizeof(Schema) <= UINT32_MAX, "TypedStoryHandle schema is too large");
+
+public:
+    static constexpr uint64_t schema_id = schema_hash(SchemaTraits <Schema>::name, sizeof(Schema), alignof(Schema));
+    static constexpr std::size_t record_size = TYPED_RECORD_HEADER_SIZE + sizeof(Schema);
+
+    explicit TypedStoryHandle(StoryHandle *story_handle)
+        : storyHandle(story_handle)
+    {}
+
+    StoryHandle *story_handle() const
+    { return storyHandle; }
+
+    // same return value as StoryHandle::log_event
+    int log(Schema const &record)
+    {
+        thread_local std::string typed_record = make_record_buffer();
+        std::memcpy(&typed_record[TYPED_RECORD_HEADER_SIZE], &record, sizeof(Schema));
+        return storyHandle->log_event(typed_record);
+    }
+
+    // plays back the story and keeps a copy of the records of this schema, the other records are skipped
+    int playback_story(uint64_t start, uint64_t end, std::vector <TypedEvent <Schema>> &typed_events)
+    {
+        std::vector <Event> events;
+        int return_code = storyHandle->playback_story(start, end, events);
+        typed_events.clear();
+        typed_events.reserve(events.size());
+        for(Event const &event: events)
+        {
+            // the record is made from its bytes, Schema does not need a default constructor
+            alignas(Schema) unsigned char record_bytes[sizeof(Schema)];
+            if(matches(event.log_record()))
+            {
+                std::memcpy(record_bytes, event.log_record().data() + TYPED_RECORD_HEADER_SIZE, sizeof(Schema));
+                typed_events.emplace_back(event.time(), event.client_id(), event.index()
+                                          , *std::launder(reinterpret_cast<Schema const*>(record_bytes)));
+            }
+        }
+        return return_code;
+    }
+
+    // same without copy : the views point into the played back events, which have to outlive them ;
+    // a record that is not suitably aligned for Schema in its Event is skipped like those of other schemas
+    int playback_story(uint64_t start, uint64_t end, std::vector <Event> &events
+                       , std::vector <TypedEventView <Schema>> &typed_views)
+    {
+        int return_code = storyHandle->playback_story(start, end, events);
+        typed_views.clear();
+        typed_views.reserve(events.size());
+        for(Event const &event: events)
+        {
+            Schema const *record = view(event.log_record());
+            if(record != nullptr)
+            { typed_views.emplace_back(event, *record); }
+        }
+        return return_code;
+    }
+
+    static void encode(Schema const &record, std::string &typed_record)
+    {
+        typed_record = make_record_buffer();
+        std::memcpy(&typed_record[TYPED_RECORD_HEADER_SIZE], &record, sizeof(Schema));
+    }
+
+    static bool matches(std::string const &typed_record)
+    {
+        if(typed_record.size() != record_size || !is_typed_record(typed_record))
+        { return false; }
+        uint64_t record_schema_id = 0;
+        for(int i = 0; i < 8; ++i)
+        { record_schema_id |= static_cast<uint64_t>(static_cast<uint8_t>(typed_record[8 + i])) << (8 * i); }
+        return (record_schema_id == schema_id);
+    }
+
+    static bool decode(std::string const &typed_record, Schema &record)
+    {
+        if(!matches(typed_record))
+        { return false; }
+        std::memcpy(&record, typed_record.data() + TYPED_RECORD_HEADER_SIZE, sizeof(Schema));
+        return true;
+    }
+
+    // the record in place, without copy ; nullptr if the record is of another schema
+    // or the payload is not suitably aligned for Schema
+    static Schema const *view(std::string const &typed_record)
+    {
+        if(!matches(typed_record))
+        { return nullptr; }
+        char const *payload = typed_record.data() + TYPED_RECORD_HEADER_SIZE;
+        if(reinterpret_cast<uintptr_t>(payload) % alignof(Schema) != 0)
+        { return nullptr; }
+        return reinterpret_cast<Schema const*>(payload);
+    }
+
+private:
+    static std::string make_record_buffer()
+    {
+        std::string typed_record(record_size, '\0');
+        typed_record[1] = TYPED_RECORD_TAG;
+        for(int i = 0; i < 4; ++i)
+        { typed_record[4 + i] = static_cast<char>(static_cast<uint64_t>(sizeof(Schema)) >> (8 * i)); }
+        for(int i = 0; i < 8; ++i)
+        { typed_record[8 + i] = static_cast<char>(schema_id >> (8 * i)); }
+        return typed_record;
+    }
+
+    StoryHandle *storyHandle;
+};
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include <thallium.hpp>
+
+#include "chrono_monitor.h"
+#include "MockVisorService.h"
+#include "MockKeeperService.h"
+#include "MockPlayerService.h"
+#include "MockChronologDeployment.h"
+
+namespace tl = thallium;
+namespace chl = chronolog;
+
+std::string chl::MockDeploymentConf::to_string() const
+{
+    return "MockDeploymentConf{" + protocol + "://" + ip + " visor:" + std::to_string(visor_port) + "/"
+           + std::to_string(visor_provider_id) + " keepers:" + std::to_string(keeper_count) + "x"
+           + std::to_string(keeper_base_port) + "/" + std::to_string(keeper_provider_id) + " player:"
+           + std::to_string(player_port) + "/" + std::to_string(player_provider_id) + " handler_threads:"
+           + std::to_string(handler_threads) + " chunk_duration:" + std::to_string(playback_chunk_duration)
+           + (compact_playback_chunks ? " compact_chunks" : "")
+           + " visor_faults:" + visor_faults.to_string() + " keeper_faults:" + keeper_faults.to_string()
+           + " player_faults:" + player_faults.to_string() + "}";
+}
+
+chl::MockChronologDeployment*chl::MockChronologDeployment::CreateMockDeployment(chl::MockDeploymentConf const &conf)
+{
+    // no-op when the application has already initialized the logger
+    chl::chrono_monitor::initialize("file", "/tmp/chrono_mock_services.log", spdlog::level::info
+                                    , "chrono_mock_services", 1024000, 3, spdlog::level::warn, true);
+    try
+    {
+        chl::MockChronologDeployment*deployment = new chl::MockChronologDeployment(conf);
+        if(deployment->visorService == nullptr || deployment->playerService == nullptr
+           || deployment->keeperServices.size() != conf.keeper_count)
+        {
+            delete deployment;
+            return nullptr;
+        }
+        return deployment;
+    }
+    catch(tl::exception const &ex)
+    {
+        LOG_ERROR("[MockChronologDeployment] Failed to create mock deployment {} exception: {}", conf.to_string()
+                  , ex.what());
+    }
+    return nullptr;
+}
+
+tl::engine*chl::MockChronologDeployment::create_engine(chl::MockDeploymentConf const &conf, uint16_t port)
+{
+    std::string service_addr = conf.protocol + "://" + conf.ip + ":" + std::to_string(port);
+    tl::engine*service_engine = new tl::engine(service_addr, THALLIUM_SERVER_MODE, true, conf.handler_threads);
+    LOG_INFO("[MockChronologDeployment] Engine listening on {}", std::string(service_engine->self()));
+    return service_engine;
+}
+
+chl::MockChronologDeployment::MockChronologDeployment(chl::MockDeploymentConf const &conf)
+        : deploymentConf(conf)
+        , visorEngine(nullptr)
+        , playerEngine(nullptr)
+        , visorService(nullptr)
+        , playerService(nullptr)
+{
+    std::vector <chl::KeeperIdCard> keeper_id_cards;
+    for(uint16_t i = 0; i < conf.keeper_count; ++i)
+    {
+        tl::engine*keeper_engine = create_engine(conf, conf.keeper_base_port + i);
+        keeperEngines.push_back(keeper_engine);
+        chl::MockKeeperService*keeper_service = chl::MockKeeperService::CreateMockKeeperService(
+                *keeper_engine, conf.keeper_provider_id, storyStore, conf.keeper_faults);
+        if(keeper_service == nullptr)
+        { return; }
+        keeperServices.push_back(keeper_service);
+        keeper_id_cards.push_back(chl::KeeperIdCard(0, chl::ServiceId(conf.protocol, conf.ip, conf.keeper_base_port + i
+                                                                      , conf.keeper_provider_id)));
+    }
+
+    playerEngine = create_engine(conf, conf.player_port);
+    playerService = chl::MockPlayerService::CreateMockPlayerService(*playerEngine, conf.player_provider_id, storyStore
+                                                                    , conf.playback_chunk_duration
+                                                                    , conf.compact_playback_chunks
+                                                                    , conf.player_faults);
+
+    visorEngine = create_engine(conf, conf.visor_port);
+    visorService = chl::MockVisorService::CreateMockVisorService(*visorEngine, conf.visor_provider_id, storyStore
+                                                                 , keeper_id_cards
+                                                                 , chl::ServiceId(conf.protocol, conf.ip
+                                                                                  , conf.player_port
+                                                                                  , conf.player_provider_id)
+                                                                 , conf.visor_faults);
+
+    LOG_INFO("[MockChronologDeployment] Started {}", conf.to_string());
+}
+
+chl::MockChronologDeployment::~MockChronologDeployment()
+{
+    shutdown();
+}
+
+chl::ClientPortalServiceConf chl::MockChronologDeployment::getClientPortalServiceConf() const
+{
+    return chl::ClientPortalServiceConf(deploymentConf.protocol, deploymentConf.ip, deploymentConf.visor_port
+                                        , deploymentConf.visor_provider_id);
+}
+
+void chl::MockChronologDeployment::shutdown()
+{
+    // the providers deregister their finalize callbacks, so they go before their engines
+    if(visorService != nullptr)
+    {
+        delete visorService;
+        visorService = nullptr;
+    }
+    if(playerService != nullptr)
+    {
+        delete playerService;
+        playerService = nullptr;
+    }
+    for(chl::MockKeeperService*keeper_service: keeperServices)
+    { delete keeper_service; }
+    keeperServices.clear();
+
+    std::vector <tl::engine*> engines(keeperEngines);
+    engines.push_back(playerEngine);
+    engines.push_back(visorEngine);
+    for(tl::engine*service_engine: engines)
+    {
+        if(service_engine != nullptr)
+        {
+            service_engine->finalize();
+            delete service_engine;
+        }
+    }
+    keeperEngines.clear();
+    playerEngine = nullptr;
+    visorEngine = nullptr;
+}
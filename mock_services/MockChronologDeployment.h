@@ -0,0 +1,90 @@
+#ifndef CHRONOLOG_MOCK_CHRONOLOG_DEPLOYMENT_H
+#define CHRONOLOG_MOCK_CHRONOLOG_DEPLOYMENT_H
+
+#include <string>
+#include <vector>
+#include <thallium.hpp>
+
+#include "ClientConfiguration.h"
+#include "KeeperIdCard.h"
+#include "MockStoryStore.h"
+#include "MockFaultInjector.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+class MockVisorService;
+class MockKeeperService;
+class MockPlayerService;
+
+struct MockDeploymentConf
+{
+    std::string protocol = "ofi+sockets";
+    std::string ip = "127.0.0.1";
+    uint16_t visor_port = 5555;
+    uint16_t visor_provider_id = 55;
+    uint16_t keeper_base_port = 6666;   // keeper i listens on keeper_base_port + i
+    uint16_t keeper_provider_id = 66;
+    uint16_t keeper_count = 1;
+    uint16_t player_port = 7777;
+    uint16_t player_provider_id = 77;
+    uint32_t handler_threads = 1;       // RPC handler xstreams of every service engine
+    uint64_t playback_chunk_duration = 0; // 0: a single StoryChunk per playback response
+    bool compact_playback_chunks = false; // send the chunks in the compact encoding rather than as cereal archives
+    MockFaultConf visor_faults;
+    MockFaultConf keeper_faults;
+    MockFaultConf player_faults;
+
+    std::string to_string() const;
+};
+
+/**
+ * @class MockChronologDeployment
+ * @brief Runs stand-in ChronoVisor, ChronoKeeper and ChronoPlayer thallium providers in the current process.
+ *
+ * Every service gets its own server engine listening on conf.ip, so a chronolog::Client
+ * in the same process (or on the same host, when run by chrono_mock_services) talks to them
+ * over the regular RPC path. All the services share one in-memory MockStoryStore,
+ * so the events recorded through the mock keepers are played back by the mock player.
+ */
+class MockChronologDeployment
+{
+public:
+    static MockChronologDeployment*CreateMockDeployment(MockDeploymentConf const &conf);
+
+    ~MockChronologDeployment();
+
+    // client configuration pointing at the mock Visor
+    ClientPortalServiceConf getClientPortalServiceConf() const;
+
+    MockStoryStore &getStoryStore()
+    { return storyStore; }
+
+    MockDeploymentConf const &getConf() const
+    { return deploymentConf; }
+
+    void shutdown();
+
+private:
+    explicit MockChronologDeployment(MockDeploymentConf const &conf);
+
+    MockChronologDeployment(MockChronologDeployment const &) = delete;
+    MockChronologDeployment &operator=(MockChronologDeployment const &) = delete;
+
+    static tl::engine*create_engine(MockDeploymentConf const &conf, uint16_t port);
+
+    MockDeploymentConf deploymentConf;
+    MockStoryStore storyStore;
+    tl::engine*visorEngine;
+    tl::engine*playerEngine;
+    std::vector <tl::engine*> keeperEngines;
+    MockVisorService*visorService;
+    MockPlayerService*playerService;
+    std::vector <MockKeeperService*> keeperServices;
+};
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CHRONOLOG_MOCK_FAULT_INJECTOR_H
+#define CHRONOLOG_MOCK_FAULT_INJECTOR_H
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <thallium.hpp>
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+// latency and failure injected into every RPC served by a mock provider
+struct MockFaultConf
+{
+    uint32_t latency_us = 0;        // added to every request
+    uint32_t tail_latency_us = 0;   // added on top of latency_us to a tail_rate fraction of the requests
+    double tail_rate = 0.0;
+    double failure_rate = 0.0;      // fraction of the requests answered with CL_ERR_UNKNOWN
+
+    std::string to_string() const
+    {
+        return "MockFaultConf{latency_us:" + std::to_string(latency_us) + " tail_latency_us:" +
+               std::to_string(tail_latency_us) + " tail_rate:" + std::to_string(tail_rate) + " failure_rate:" +
+               std::to_string(failure_rate) + "}";
+    }
+};
+
+class MockFaultInjector
+{
+public:
+    explicit MockFaultInjector(MockFaultConf const &fault_conf, uint64_t seed = 0)
+        : faultConf(fault_conf)
+        , randomEngine(seed != 0 ? seed : std::random_device{}())
+    {}
+
+    // sleep the handler ULT for the configured latency, letting the other handlers run meanwhile
+    void inject_latency(tl::engine &tl_engine)
+    {
+        uint32_t delay_us = faultConf.latency_us;
+        if(faultConf.tail_latency_us > 0 && draw() < faultConf.tail_rate)
+        { delay_us += faultConf.tail_latency_us; }
+        if(delay_us > 0)
+        { tl::thread::sleep(tl_engine, delay_us / 1000.0); }
+    }
+
+    bool inject_failure()
+    { return (faultConf.failure_rate > 0 && draw() < faultConf.failure_rate); }
+
+    MockFaultConf const &getConf() const
+    { return faultConf; }
+
+private:
+    double draw()
+    {
+        std::lock_guard <std::mutex> lock(randomMutex);
+        return std::uniform_real_distribution <double>(0.0, 1.0)(randomEngine);
+    }
+
+    MockFaultConf faultConf;
+    std::mutex randomMutex;
+    std::mt19937_64 randomEngine;
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef CHRONOLOG_MOCK_KEEPER_SERVICE_H
+#define CHRONOLOG_MOCK_KEEPER_SERVICE_H
+
+#include <thallium.hpp>
+#include <thallium/serialization/stl/string.hpp>
+
+#include "chrono_monitor.h"
+#include "chronolog_errcode.h"
+#include "chronolog_types.h"
+#include "EventBatch.h"
+#include "MockStoryStore.h"
+#include "MockFaultInjector.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+// Stand-in for the ChronoKeeper recording service: serves the record_event, record_event_batch and
+// record_multi_story_batch RPCs of KeeperRecordingClient and keeps the recorded events in the MockStoryStore shared with the mock Player.
+
+class MockKeeperService: public tl::provider <MockKeeperService>
+{
+public:
+    // Service should be created on the heap not the stack thus the constructor is private...
+    static MockKeeperService*
+    CreateMockKeeperService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                            , MockFaultConf const &fault_conf)
+    {
+        try
+        {
+            return new MockKeeperService(tl_engine, provider_id, story_store, fault_conf);
+        }
+        catch(tl::exception const &)
+        {
+            LOG_ERROR("[MockKeeperService] Failed to create MockKeeperService");
+        }
+        return nullptr;
+    }
+
+    ~MockKeeperService()
+    {
+        LOG_DEBUG("[MockKeeperService] Destructor called, recorded {} events", recordedEvents.load());
+        get_engine().pop_finalize_callback(this);
+    }
+
+    void record_event(tl::request const &request, LogEvent const &log_event)
+    {
+        faultInjector.inject_latency(serviceEngine);
+        if(faultInjector.inject_failure())
+        {
+            request.respond((int)CL_ERR_UNKNOWN);
+            return;
+        }
+        int return_code = storyStore.record_event(log_event);
+        if(return_code == CL_SUCCESS)
+        { recordedEvents.fetch_add(1, std::memory_order_relaxed); }
+        LOG_TRACE("[MockKeeperService] record_event StoryID={} time={} index={} : {}", log_event.getStoryId()
+                  , log_event.time(), log_event.index(), return_code);
+        request.respond(return_code);
+    }
+
+    void record_event_batch(tl::request const &request, std::string const &encoded_batch)
+    {
+        faultInjector.inject_latency(serviceEngine);
+        if(faultInjector.inject_failure())
+        {
+            request.respond((int)CL_ERR_UNKNOWN);
+            return;
+        }
+        std::vector <LogEvent> events;
+        int return_code = decode_event_batch(encoded_batch.data(), encoded_batch.size(), events);
+        for(LogEvent const &log_event: events)
+        {
+            if(return_code != CL_SUCCESS)
+            { break; }
+            return_code = storyStore.record_event(log_event);
+        }
+        if(return_code == CL_SUCCESS)
+        { recordedEvents.fetch_add(events.size(), std::memory_order_relaxed); }
+        LOG_TRACE("[MockKeeperService] record_event_batch {} bytes {} events : {}", encoded_batch.size()
+                  , events.size(), return_code);
+        request.respond(return_code);
+    }
+
+    void record_multi_story_batch(tl::request const &request, std::string const &encoded_batch)
+    {
+        faultInjector.inject_latency(serviceEngine);
+        if(faultInjector.inject_failure())
+        {
+            request.respond((int)CL_ERR_UNKNOWN);
+            return;
+        }
+        std::vector <LogEvent> events;
+        int return_code = decode_multi_story_batch(encoded_batch.data(), encoded_batch.size(), events);
+        for(LogEvent const &log_event: events)
+        {
+            if(return_code != CL_SUCCESS)
+            { break; }
+            return_code = storyStore.record_event(log_event);
+        }
+        if(return_code == CL_SUCCESS)
+        { recordedEvents.fetch_add(events.size(), std::memory_order_relaxed); }
+        LOG_TRACE("[MockKeeperService] record_multi_story_batch {} bytes {} events : {}", encoded_batch.size()
+                  , events.size(), return_code);
+        request.respond(return_code);
+    }
+
+    uint64_t getRecordedEventCount() const
+    { return recordedEvents.load(std::memory_order_relaxed); }
+
+private:
+    MockKeeperService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                      , MockFaultConf const &fault_conf)
+        : tl::provider <MockKeeperService>(tl_engine, provider_id)
+        , serviceEngine(tl_engine)
+        , storyStore(story_store)
+        , faultInjector(fault_conf)
+        , recordedEvents(0)
+    {
+        define("record_event", &MockKeeperService::record_event);
+        define("record_event_batch", &MockKeeperService::record_event_batch);
+        define("record_multi_story_batch", &MockKeeperService::record_multi_story_batch);
+        //set up callback for the case when the engine is being finalized while this provider is still alive
+        get_engine().push_finalize_callback(this, [p = this]()
+        { delete p; });
+    }
+
+    MockKeeperService(MockKeeperService const &) = delete;
+    MockKeeperService &operator=(MockKeeperService const &) = delete;
+
+    tl::engine serviceEngine;
+    MockStoryStore &storyStore;
+    MockFaultInjector faultInjector;
+    std::atomic <uint64_t> recordedEvents;
+};
+
+}
+
+#endif
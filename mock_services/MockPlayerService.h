@@ -0,0 +1,164 @@
+#ifndef CHRONOLOG_MOCK_PLAYER_SERVICE_H
+#define CHRONOLOG_MOCK_PLAYER_SERVICE_H
+
+#include <sstream>
+#include <vector>
+#include <thallium.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/tuple.hpp>
+
+#include "chrono_monitor.h"
+#include "chronolog_errcode.h"
+#include "ServiceId.h"
+#include "StoryChunk.h"
+#include "EventBatch.h"
+#include "MockStoryStore.h"
+#include "MockFaultInjector.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+// Stand-in for the ChronoPlayer playback service: serves the RPCs of PlaybackQueryRpcClient
+// and pushes the response StoryChunks to the client's receive_query_story_chunk RPC, tagged with the query id,
+// before responding to the story_playback_request.
+
+class MockPlayerService: public tl::provider <MockPlayerService>
+{
+public:
+    // Service should be created on the heap not the stack thus the constructor is private...
+    static MockPlayerService*
+    CreateMockPlayerService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                            , uint64_t chunk_duration, bool compact_chunks, MockFaultConf const &fault_conf)
+    {
+        try
+        {
+            return new MockPlayerService(tl_engine, provider_id, story_store, chunk_duration, compact_chunks
+                                         , fault_conf);
+        }
+        catch(tl::exception const &)
+        {
+            LOG_ERROR("[MockPlayerService] Failed to create MockPlayerService");
+        }
+        return nullptr;
+    }
+
+    ~MockPlayerService()
+    {
+        LOG_DEBUG("[MockPlayerService] Destructor called");
+        receive_query_story_chunk.deregister();
+        get_engine().pop_finalize_callback(this);
+    }
+
+    void playback_service_available(tl::request const &request)
+    {
+        faultInjector.inject_latency(serviceEngine);
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN : (int)CL_SUCCESS);
+    }
+
+    void story_playback_request(tl::request const &request, ServiceId const &client_service_id, uint32_t query_id
+                                , ChronicleName const &chronicle_name, StoryName const &story_name
+                                , uint64_t start_time, uint64_t end_time)
+    {
+        faultInjector.inject_latency(serviceEngine);
+        if(faultInjector.inject_failure() || start_time >= end_time)
+        {
+            request.respond((int)CL_ERR_UNKNOWN);
+            return;
+        }
+
+        std::vector <StoryChunk*> story_chunks;
+        int return_code = storyStore.extract_story_chunks(chronicle_name, story_name, start_time, end_time
+                                                          , chunkDuration, story_chunks);
+        LOG_DEBUG("[MockPlayerService] story_playback_request QueryID={} {} {} [{},{}) : {} chunks", query_id
+                  , chronicle_name, story_name, start_time, end_time, story_chunks.size());
+
+        // the client's ServiceId carries the host id rather than a routable address,
+        // so the chunks go back to the endpoint the request came from
+        tl::provider_handle client_service_ph(request.get_endpoint(), client_service_id.getProviderId());
+        bool lz_compression = storyStore.lz_compression(chronicle_name, story_name);
+        for(StoryChunk*story_chunk: story_chunks)
+        {
+            if(return_code == CL_SUCCESS)
+            { return_code = send_story_chunk(client_service_ph, query_id, *story_chunk, lz_compression); }
+            delete story_chunk;
+        }
+        request.respond(return_code);
+    }
+
+private:
+    MockPlayerService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                      , uint64_t chunk_duration, bool compact_chunks, MockFaultConf const &fault_conf)
+        : tl::provider <MockPlayerService>(tl_engine, provider_id)
+        , serviceEngine(tl_engine)
+        , storyStore(story_store)
+        , chunkDuration(chunk_duration)
+        , compactChunks(compact_chunks)
+        , faultInjector(fault_conf)
+    {
+        define("playback_service_available", &MockPlayerService::playback_service_available);
+        define("story_playback_request", &MockPlayerService::story_playback_request);
+        receive_query_story_chunk = tl_engine.define("receive_query_story_chunk");
+        //set up callback for the case when the engine is being finalized while this provider is still alive
+        get_engine().push_finalize_callback(this, [p = this]()
+        { delete p; });
+    }
+
+    MockPlayerService(MockPlayerService const &) = delete;
+    MockPlayerService &operator=(MockPlayerService const &) = delete;
+
+    int send_story_chunk(tl::provider_handle const &client_service_ph, uint32_t query_id, StoryChunk &story_chunk
+                         , bool lz_compression)
+    {
+        try
+        {
+            // compressed chunks only exist in the compact encoding
+            std::string serialized_chunk;
+            if(compactChunks || lz_compression)
+            { encode_story_chunk(story_chunk, serialized_chunk, lz_compression); }
+            else
+            {
+                std::ostringstream oss(std::ios::binary);
+                {
+                    cereal::BinaryOutputArchive oarchive(oss);
+                    oarchive(story_chunk);
+                }
+                serialized_chunk = oss.str();
+            }
+
+            std::vector <std::pair <void*, std::size_t>> segments(1);
+            segments[0].first = (void*)(&serialized_chunk[0]);
+            segments[0].second = serialized_chunk.size();
+            tl::bulk chunk_bulk = serviceEngine.expose(segments, tl::bulk_mode::read_only);
+
+            receive_query_story_chunk.on(client_service_ph)(query_id, chunk_bulk);
+            LOG_DEBUG("[MockPlayerService] Sent StoryChunk {}-{} : {} events, {} bytes", story_chunk.getStartTime()
+                      , story_chunk.getEndTime(), story_chunk.getEventCount(), serialized_chunk.size());
+            return CL_SUCCESS;
+        }
+        catch(tl::exception const &ex)
+        {
+            LOG_ERROR("[MockPlayerService] Failed to send StoryChunk, exception: {}", ex.what());
+        }
+        catch(cereal::Exception const &ex)
+        {
+            LOG_ERROR("[MockPlayerService] Failed to serialize StoryChunk, exception: {}", ex.what());
+        }
+        return CL_ERR_UNKNOWN;
+    }
+
+    tl::engine serviceEngine;
+    MockStoryStore &storyStore;
+    uint64_t chunkDuration;
+    bool compactChunks;   // compact EventBatch chunk encoding instead of the cereal archive of the ChronoPlayer
+    MockFaultInjector faultInjector;
+    tl::remote_procedure receive_query_story_chunk;
+};
+
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef CHRONOLOG_MOCK_STORY_STORE_H
+#define CHRONOLOG_MOCK_STORY_STORE_H
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <vector>
+
+#include "chronolog_types.h"
+#include "chronolog_errcode.h"
+#include "StoryChunk.h"
+
+namespace chronolog
+{
+
+// In-memory stand-in for the Visor metadata and the Keeper/Player story storage
+// shared by the mock Visor, Keeper and Player providers of a MockChronologDeployment.
+
+class MockStoryStore
+{
+public:
+    MockStoryStore() = default;
+
+    MockStoryStore(MockStoryStore const &) = delete;
+    MockStoryStore &operator=(MockStoryStore const &) = delete;
+
+    int create_chronicle(ChronicleName const &chronicle)
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        return (chronicles.insert(std::pair <ChronicleName, std::set <StoryName>>(chronicle, std::set <StoryName>{})).second
+                ? CL_SUCCESS : CL_ERR_CHRONICLE_EXISTS);
+    }
+
+    int destroy_chronicle(ChronicleName const &chronicle)
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        auto chronicle_iter = chronicles.find(chronicle);
+        if(chronicle_iter == chronicles.end())
+        { return CL_ERR_NOT_EXIST; }
+        for(auto const &story: (*chronicle_iter).second)
+        {
+            StoryId story_id = make_story_id(chronicle, story);
+            storyNames.erase(story_id);
+            storyEvents.erase(story_id);
+            compressedStories.erase(story_id);
+        }
+        chronicles.erase(chronicle_iter);
+        return CL_SUCCESS;
+    }
+
+    // creates the story on first acquisition, the chronicle has to exist
+    int acquire_story(ChronicleName const &chronicle, StoryName const &story, StoryId &story_id
+                      , bool lz_compression = false)
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        auto chronicle_iter = chronicles.find(chronicle);
+        if(chronicle_iter == chronicles.end())
+        { return CL_ERR_NOT_EXIST; }
+
+        (*chronicle_iter).second.insert(story);
+        story_id = make_story_id(chronicle, story);
+        storyNames[story_id] = std::pair <ChronicleName, StoryName>(chronicle, story);
+        if(lz_compression)
+        { compressedStories.insert(story_id); }
+        return CL_SUCCESS;
+    }
+
+    int destroy_story(ChronicleName const &chronicle, StoryName const &story)
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        auto chronicle_iter = chronicles.find(chronicle);
+        if(chronicle_iter == chronicles.end() || (*chronicle_iter).second.erase(story) == 0)
+        { return CL_ERR_NOT_EXIST; }
+        StoryId story_id = make_story_id(chronicle, story);
+        storyNames.erase(story_id);
+        storyEvents.erase(story_id);
+        compressedStories.erase(story_id);
+        return CL_SUCCESS;
+    }
+
+    std::vector <ChronicleName> show_chronicles() const
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        std::vector <ChronicleName> chronicle_names;
+        for(auto const &chronicle: chronicles)
+        { chronicle_names.push_back(chronicle.first); }
+        return chronicle_names;
+    }
+
+    std::vector <StoryName> show_stories(ChronicleName const &chronicle) const
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        auto chronicle_iter = chronicles.find(chronicle);
+        if(chronicle_iter == chronicles.end())
+        { return std::vector <StoryName>{}; }
+        return std::vector <StoryName>((*chronicle_iter).second.begin(), (*chronicle_iter).second.end());
+    }
+
+    int record_event(LogEvent const &event)
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        if(storyNames.find(event.getStoryId()) == storyNames.end())
+        { return CL_ERR_NOT_ACQUIRED; }
+        storyEvents[event.getStoryId()].insert(std::pair <EventSequence, LogEvent>(
+                EventSequence(event.time(), event.getClientId(), event.index()), event));
+        return CL_SUCCESS;
+    }
+
+    uint64_t event_count(StoryId const &story_id) const
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        auto events_iter = storyEvents.find(story_id);
+        return (events_iter == storyEvents.end() ? 0 : (*events_iter).second.size());
+    }
+
+    // copy the story events in [start_time, end_time) into StoryChunks of at most chunk_duration each
+    // (a single chunk covering the whole range when chunk_duration is 0)
+    int extract_story_chunks(ChronicleName const &chronicle, StoryName const &story, uint64_t start_time
+                             , uint64_t end_time, uint64_t chunk_duration, std::vector <StoryChunk*> &story_chunks) const
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+
+        StoryId story_id = make_story_id(chronicle, story);
+        if(storyNames.find(story_id) == storyNames.end())
+        { return CL_ERR_NOT_EXIST; }
+        if(chunk_duration == 0 || chunk_duration > end_time - start_time)
+        { chunk_duration = end_time - start_time; }
+
+        auto events_iter = storyEvents.find(story_id);
+        if(events_iter == storyEvents.end())
+        { return CL_SUCCESS; }
+
+        std::map <EventSequence, LogEvent> const &events = (*events_iter).second;
+        StoryChunk*story_chunk = nullptr;
+        for(auto iter = events.lower_bound(EventSequence{start_time, 0, 0});
+            iter != events.end() && (*iter).second.time() < end_time; ++iter)
+        {
+            if(story_chunk == nullptr || (*iter).second.time() >= story_chunk->getEndTime())
+            {
+                uint64_t chunk_start = start_time + (((*iter).second.time() - start_time) / chunk_duration) * chunk_duration;
+                uint64_t chunk_end = (end_time - chunk_start > chunk_duration ? chunk_start + chunk_duration : end_time);
+                story_chunk = new StoryChunk(chronicle, story, story_id, chunk_start, chunk_end);
+                story_chunks.push_back(story_chunk);
+            }
+            story_chunk->insertEvent((*iter).second);
+        }
+        return CL_SUCCESS;
+    }
+
+    // the story was acquired with the lz compression attribute
+    bool lz_compression(ChronicleName const &chronicle, StoryName const &story) const
+    {
+        std::lock_guard <std::mutex> lock(storeMutex);
+        return (compressedStories.find(make_story_id(chronicle, story)) != compressedStories.end());
+    }
+
+    static StoryId make_story_id(ChronicleName const &chronicle, StoryName const &story)
+    { return std::hash <std::string>{}(chronicle + "/" + story); }
+
+private:
+    mutable std::mutex storeMutex;
+    std::map <ChronicleName, std::set <StoryName>> chronicles;
+    std::map <StoryId, std::pair <ChronicleName, StoryName>> storyNames;
+    std::map <StoryId, std::map <EventSequence, LogEvent>> storyEvents;
+    std::set <StoryId> compressedStories;
+};
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef CHRONOLOG_MOCK_VISOR_SERVICE_H
+#define CHRONOLOG_MOCK_VISOR_SERVICE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <thallium.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <thallium/serialization/stl/map.hpp>
+
+#include "chrono_monitor.h"
+#include "chronolog_errcode.h"
+#include "ConnectResponseMsg.h"
+#include "AcquireStoryResponseMsg.h"
+#include "EventBatch.h"
+#include "MockStoryStore.h"
+#include "MockFaultInjector.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+// Stand-in for the ChronoVisor ClientPortalService: serves the RPCs defined by RpcVisorClient
+// and assigns every acquired story to all the mock keepers of the deployment.
+
+class MockVisorService: public tl::provider <MockVisorService>
+{
+public:
+    // Service should be created on the heap not the stack thus the constructor is private...
+    static MockVisorService*
+    CreateMockVisorService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                           , std::vector <KeeperIdCard> const &keepers, ServiceId const &player
+                           , MockFaultConf const &fault_conf)
+    {
+        try
+        {
+            return new MockVisorService(tl_engine, provider_id, story_store, keepers, player, fault_conf);
+        }
+        catch(tl::exception const &)
+        {
+            LOG_ERROR("[MockVisorService] Failed to create MockVisorService");
+        }
+        return nullptr;
+    }
+
+    ~MockVisorService()
+    {
+        LOG_DEBUG("[MockVisorService] Destructor called");
+        get_engine().pop_finalize_callback(this);
+    }
+
+    void Connect(tl::request const &request, uint32_t client_euid, uint32_t client_host_id, uint32_t client_pid)
+    {
+        inject_latency();
+        if(faultInjector.inject_failure())
+        {
+            request.respond(ConnectResponseMsg(CL_ERR_UNKNOWN, ClientId{0}));
+            return;
+        }
+        ClientId client_id = process_client_id(client_host_id, client_euid, client_pid);
+        LOG_INFO("[MockVisorService] Connect EUID={} HostID={} PID={} : ClientID={}", client_euid, client_host_id
+                 , client_pid, client_id);
+        request.respond(ConnectResponseMsg(CL_SUCCESS, client_id));
+    }
+
+    void Disconnect(tl::request const &request, ClientId const &client_id)
+    {
+        inject_latency();
+        LOG_INFO("[MockVisorService] Disconnect ClientID={}", client_id);
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN : (int)CL_SUCCESS);
+    }
+
+    void CreateChronicle(tl::request const &request, ClientId const &/*client_id*/, std::string const &chronicle_name
+                         , std::map <std::string, std::string> const &/*attrs*/, int const &/*flags*/)
+    {
+        inject_latency();
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN
+                                                       : storyStore.create_chronicle(chronicle_name));
+    }
+
+    void DestroyChronicle(tl::request const &request, ClientId const &/*client_id*/, std::string const &chronicle_name)
+    {
+        inject_latency();
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN
+                                                       : storyStore.destroy_chronicle(chronicle_name));
+    }
+
+    void GetChronicleAttr(tl::request const &request, ClientId const &/*client_id*/, std::string const &/*chronicle_name*/
+                          , std::string const &/*key*/, std::string const &/*value*/)
+    {
+        inject_latency();
+        request.respond((int)CL_SUCCESS);
+    }
+
+    void EditChronicleAttr(tl::request const &request, ClientId const &/*client_id*/, std::string const &/*chronicle_name*/
+                           , std::string const &/*key*/, std::string const &/*value*/)
+    {
+        inject_latency();
+        request.respond((int)CL_SUCCESS);
+    }
+
+    void AcquireStory(tl::request const &request, ClientId const &/*client_id*/, std::string const &chronicle_name
+                      , std::string const &story_name, std::map <std::string, std::string> const &attrs
+                      , int const &/*flags*/)
+    {
+        inject_latency();
+        StoryId story_id{0};
+        int return_code = (faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN
+                                                          : storyStore.acquire_story(chronicle_name, story_name, story_id
+                                                                                     , lz_compression_requested(attrs)));
+        if(return_code != CL_SUCCESS)
+        {
+            request.respond(AcquireStoryResponseMsg(return_code, 0, std::vector <KeeperIdCard>{}));
+            return;
+        }
+        LOG_INFO("[MockVisorService] AcquireStory {} {} : StoryID={} keepers={}", chronicle_name, story_name, story_id
+                 , storyKeepers.size());
+        request.respond(AcquireStoryResponseMsg(CL_SUCCESS, story_id, storyKeepers, storyPlayer));
+    }
+
+    void ReleaseStory(tl::request const &request, ClientId const &/*client_id*/, std::string const &/*chronicle_name*/
+                      , std::string const &/*story_name*/)
+    {
+        inject_latency();
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN : (int)CL_SUCCESS);
+    }
+
+    void DestroyStory(tl::request const &request, ClientId const &/*client_id*/, std::string const &chronicle_name
+                      , std::string const &story_name)
+    {
+        inject_latency();
+        request.respond(faultInjector.inject_failure() ? (int)CL_ERR_UNKNOWN
+                                                       : storyStore.destroy_story(chronicle_name, story_name));
+    }
+
+    void ShowChronicles(tl::request const &request, ClientId const &/*client_id*/)
+    {
+        inject_latency();
+        request.respond(storyStore.show_chronicles());
+    }
+
+    void ShowStories(tl::request const &request, ClientId const &/*client_id*/, std::string const &chronicle_name)
+    {
+        inject_latency();
+        request.respond(storyStore.show_stories(chronicle_name));
+    }
+
+private:
+    MockVisorService(tl::engine &tl_engine, uint16_t provider_id, MockStoryStore &story_store
+                     , std::vector <KeeperIdCard> const &keepers, ServiceId const &player
+                     , MockFaultConf const &fault_conf)
+        : tl::provider <MockVisorService>(tl_engine, provider_id)
+        , serviceEngine(tl_engine)
+        , storyStore(story_store)
+        , storyKeepers(keepers)
+        , storyPlayer(player)
+        , faultInjector(fault_conf)
+    {
+        define("Connect", &MockVisorService::Connect);
+        define("Disconnect", &MockVisorService::Disconnect);
+        define("CreateChronicle", &MockVisorService::CreateChronicle);
+        define("DestroyChronicle", &MockVisorService::DestroyChronicle);
+        define("GetChronicleAttr", &MockVisorService::GetChronicleAttr);
+        define("EditChronicleAttr", &MockVisorService::EditChronicleAttr);
+        define("AcquireStory", &MockVisorService::AcquireStory);
+        define("ReleaseStory", &MockVisorService::ReleaseStory);
+        define("DestroyStory", &MockVisorService::DestroyStory);
+        define("ShowChronicles", &MockVisorService::ShowChronicles);
+        define("ShowStories", &MockVisorService::ShowStories);
+        //set up callback for the case when the engine is being finalized while this provider is still alive
+        get_engine().push_finalize_callback(this, [p = this]()
+        { delete p; });
+    }
+
+    MockVisorService(MockVisorService const &) = delete;
+    MockVisorService &operator=(MockVisorService const &) = delete;
+
+    void inject_latency()
+    { faultInjector.inject_latency(serviceEngine); }
+
+    tl::engine serviceEngine;
+    MockStoryStore &storyStore;
+    std::vector <KeeperIdCard> storyKeepers;
+    ServiceId storyPlayer;
+    MockFaultInjector faultInjector;
+};
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "chrono_monitor.h"
+#include "MockChronologDeployment.h"
+
+namespace chl = chronolog;
+
+// Local daemon running the mock Visor, Keeper and Player services of MockChronologDeployment,
+// so that client applications and benchmarks on the same host can run without a ChronoLog deployment.
+
+static std::atomic <bool> keep_running(true);
+
+static void signal_handler(int)
+{ keep_running = false; }
+
+static void usage(char const*program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --protocol <string>        transport (default ofi+sockets)\n"
+              << "  --ip <dotted ip>           address the services listen on (default 127.0.0.1)\n"
+              << "  --visor-port <port>        (default 5555), provider id 55\n"
+              << "  --keeper-port <port>       base port of the keepers (default 6666), provider id 66\n"
+              << "  --keepers <n>              number of keepers (default 1)\n"
+              << "  --player-port <port>       (default 7777), provider id 77\n"
+              << "  --threads <n>              RPC handler threads per service (default 1)\n"
+              << "  --chunk-duration <n>       playback StoryChunk duration, 0 for a single chunk (default 0)\n"
+              << "  --compact-chunks           send playback chunks in the compact encoding instead of cereal\n"
+              << "  --latency-us <n>           latency injected into every RPC\n"
+              << "  --tail-latency-us <n>      extra latency injected into a tail-rate fraction of the RPCs\n"
+              << "  --tail-rate <r>            fraction of the RPCs getting the tail latency\n"
+              << "  --failure-rate <r>         fraction of the RPCs failing with CL_ERR_UNKNOWN\n"
+              << "  --log-level <level>        trace|debug|info|warning|error (default info)\n"
+              << "  --help\n";
+}
+
+int main(int argc, char**argv)
+{
+    chl::MockDeploymentConf conf;
+    chl::MockFaultConf fault_conf;
+    std::string log_level = "info";
+
+    static struct option long_options[] = {{"protocol"       , required_argument, nullptr, 'P'}
+                                           , {"ip"             , required_argument, nullptr, 'i'}
+                                           , {"visor-port"     , required_argument, nullptr, 'v'}
+                                           , {"keeper-port"    , required_argument, nullptr, 'k'}
+                                           , {"keepers"        , required_argument, nullptr, 'n'}
+                                           , {"player-port"    , required_argument, nullptr, 'p'}
+                                           , {"threads"        , required_argument, nullptr, 't'}
+                                           , {"chunk-duration" , required_argument, nullptr, 'c'}
+                                           , {"compact-chunks" , no_argument      , nullptr, 'C'}
+                                           , {"latency-us"     , required_argument, nullptr, 'l'}
+                                           , {"tail-latency-us", required_argument, nullptr, 'L'}
+                                           , {"tail-rate"      , required_argument, nullptr, 'r'}
+                                           , {"failure-rate"   , required_argument, nullptr, 'f'}
+                                           , {"log-level"      , required_argument, nullptr, 'd'}
+                                           , {"help"           , no_argument      , nullptr, 'h'}
+                                           , {nullptr          , 0                , nullptr, 0}};
+    int opt;
+    while((opt = getopt_long(argc, argv, "P:i:v:k:n:p:t:c:Cl:L:r:f:d:h", long_options, nullptr)) != -1)
+    {
+        switch(opt)
+        {
+            case 'P': conf.protocol = optarg; break;
+            case 'i': conf.ip = optarg; break;
+            case 'v': conf.visor_port = std::atoi(optarg); break;
+            case 'k': conf.keeper_base_port = std::atoi(optarg); break;
+            case 'n': conf.keeper_count = std::atoi(optarg); break;
+            case 'p': conf.player_port = std::atoi(optarg); break;
+            case 't': conf.handler_threads = std::atoi(optarg); break;
+            case 'c': conf.playback_chunk_duration = std::strtoull(optarg, nullptr, 10); break;
+            case 'C': conf.compact_playback_chunks = true; break;
+            case 'l': fault_conf.latency_us = std::atoi(optarg); break;
+            case 'L': fault_conf.tail_latency_us = std::atoi(optarg); break;
+            case 'r': fault_conf.tail_rate = std::atof(optarg); break;
+            case 'f': fault_conf.failure_rate = std::atof(optarg); break;
+            case 'd': log_level = optarg; break;
+            case 'h': usage(argv[0]); return 0;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    conf.visor_faults = conf.keeper_faults = conf.player_faults = fault_conf;
+
+    if(chl::chrono_monitor::initialize("console", "", spdlog::level::from_str(log_level), "chrono_mock_services") != 0)
+    {
+        std::cerr << "[chrono_mock_services] Failed to initialize the logger" << std::endl;
+        return 1;
+    }
+
+    chl::MockChronologDeployment*deployment = chl::MockChronologDeployment::CreateMockDeployment(conf);
+    if(deployment == nullptr)
+    {
+        LOG_CRITICAL("[chrono_mock_services] Failed to start the mock services");
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+    LOG_INFO("[chrono_mock_services] Running, send SIGINT or SIGTERM to stop");
+    while(keep_running)
+    { std::this_thread::sleep_for(std::chrono::milliseconds(200)); }
+
+    LOG_INFO("[chrono_mock_services] Shutting down");
+    delete deployment;
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chronolog_client.h"
+#include "chrono_monitor.h"
+#include "MockChronologDeployment.h"
+
+namespace chl = chronolog;
+
+// End-to-end check of the client against the in-process mock services, run by ctest :
+// connect, acquire a story, log events one by one and as a batch, flush, play the story back and compare.
+
+static constexpr uint32_t TEST_EVENTS = 200;
+
+#define TEST_CHECK(condition, what) \
+    do { if(!(condition)) { std::cerr << "[mock_client_test] " << scenario << ": " << what << std::endl; return 1; } \
+    } while(0)
+
+static int run_scenario(std::string const &scenario, chl::ClientPortalServiceConf const &portal_conf
+                        , chl::ClientRecordingConf const &recording_conf
+                        , std::map <std::string, std::string> const &story_attrs)
+{
+    chl::Client client(portal_conf, recording_conf);
+    TEST_CHECK(client.Connect() == chl::CL_SUCCESS, "Connect failed");
+
+    int flags = 0;
+    std::string chronicle = "mock_test_chronicle";
+    std::string story = "story_" + scenario;
+    std::map <std::string, std::string> chronicle_attrs;
+    int return_code = client.CreateChronicle(chronicle, chronicle_attrs, flags);
+    TEST_CHECK(return_code == chl::CL_SUCCESS || return_code == chl::CL_ERR_CHRONICLE_EXISTS
+               , "CreateChronicle failed with " << return_code);
+
+    auto acquire_return = client.AcquireStory(chronicle, story, story_attrs, flags);
+    TEST_CHECK(acquire_return.first == chl::CL_SUCCESS, "AcquireStory failed with " << acquire_return.first);
+    chl::StoryHandle*story_handle = acquire_return.second;
+
+    uint64_t start_time = chl::event_timestamp();
+    std::vector <std::string> records;
+    for(uint32_t i = 0; i < TEST_EVENTS; ++i)
+    { records.push_back("event_" + std::to_string(i)); }
+    for(uint32_t i = 0; i < TEST_EVENTS / 2; ++i)
+    { TEST_CHECK(story_handle->log_event(records[i]) == 1, "log_event of event " << i << " failed"); }
+    std::vector <std::string_view> batch(records.begin() + TEST_EVENTS / 2, records.end());
+    TEST_CHECK(story_handle->log_events(batch.data(), batch.size(), true) == static_cast<int>(batch.size())
+               , "log_events failed");
+
+    return_code = client.Flush(std::chrono::steady_clock::now() + std::chrono::seconds(30));
+    TEST_CHECK(return_code == chl::CL_SUCCESS, "Flush failed with " << return_code);
+    uint64_t end_time = chl::event_timestamp() + 1;
+
+    std::vector <chl::Event> playback_events;
+    return_code = story_handle->playback_story(start_time, end_time, playback_events);
+    TEST_CHECK(return_code == chl::CL_SUCCESS, "playback_story failed with " << return_code);
+    TEST_CHECK(playback_events.size() == TEST_EVENTS
+               , "played back " << playback_events.size() << " of " << TEST_EVENTS << " events");
+    for(uint32_t i = 0; i < TEST_EVENTS; ++i)
+    {
+        TEST_CHECK(playback_events[i].log_record() == records[i]
+                   , "event " << i << " played back as '" << playback_events[i].log_record() << "'");
+    }
+
+    TEST_CHECK(client.ReleaseStory(chronicle, story) == chl::CL_SUCCESS, "ReleaseStory failed");
+    TEST_CHECK(client.Disconnect() == chl::CL_SUCCESS, "Disconnect failed");
+    std::cout << "[mock_client_test] " << scenario << ": passed" << std::endl;
+    return 0;
+}
+
+int main()
+{
+    if(chl::chrono_monitor::initialize("console", "", spdlog::level::warn, "mock_client_test") != 0)
+    {
+        std::cerr << "[mock_client_test] Failed to initialize the logger" << std::endl;
+        return 1;
+    }
+
+    // ports away from the chrono_mock_services defaults, so a running daemon does not get in the way
+    chl::MockDeploymentConf mock_conf;
+    mock_conf.visor_port = 15555;
+    mock_conf.keeper_base_port = 16666;
+    mock_conf.keeper_count = 2;
+    mock_conf.player_port = 17777;
+    chl::MockChronologDeployment*mock_deployment = chl::MockChronologDeployment::CreateMockDeployment(mock_conf);
+    if(mock_deployment == nullptr)
+    {
+        std::cerr << "[mock_client_test] Failed to start the mock services" << std::endl;
+        return 1;
+    }
+    chl::ClientPortalServiceConf portal_conf = mock_deployment->getClientPortalServiceConf();
+
+    int failures = run_scenario("direct", portal_conf, chl::ClientRecordingConf(), {});
+    failures += run_scenario("keeper_batching", portal_conf, chl::ClientRecordingConf(true)
+                             , {{"keeper_batch_rpc", "true"}});
+    failures += run_scenario("batch_rpc", portal_conf, chl::ClientRecordingConf(), {{"keeper_batch_rpc", "true"}});
+
+    delete mock_deployment;
+    return (failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,101 @@
+#ifndef ADAPTIVE_BATCH_CONTROLLER_H
+#define ADAPTIVE_BATCH_CONTROLLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "ClientConfiguration.h"
+
+namespace chronolog
+{
+
+// Decides how large a keeper batch may grow and how long the flusher lingers for it.
+//
+// Without adaptive_batching the limits are the configured ones.
+// With adaptive_batching :
+// - Nagle : the first event of a batch is sent right away unless, at the observed arrival rate,
+//   at least one more event is expected before the delay target minus the RPC latency runs out,
+//   so a quiet client does not pay any linger time;
+// - AIMD : the batch size target grows additively while full batches meet the delay target and is
+//   halved when the events of a batch waited longer than the target. If the RPC latency alone exceeds
+//   the target the target can not be met anyway and the batches keep growing for amortization.
+// Not thread safe, KeeperEventBatcher calls it under its batch mutex.
+
+class AdaptiveBatchController
+{
+public:
+    explicit AdaptiveBatchController(ClientRecordingConf const &recording_conf)
+        : adaptive(recording_conf.adaptive_batching())
+        , maxBatchEvents(std::max <uint32_t>(1, recording_conf.max_batch_events()))
+        , maxDelayUs(recording_conf.max_batch_delay_us())
+        , increaseStep(std::max <uint32_t>(1, maxBatchEvents / 32))
+        , targetBatchEvents(adaptive ? std::min <uint32_t>(maxBatchEvents, 16) : maxBatchEvents)
+        , rpcLatencyUs(0)
+        , arrivalsPerUs(0)
+        , lastSendTime()
+    {}
+
+    uint32_t batch_events() const
+    { return targetBatchEvents; }
+
+    // expected RPC latency subtracted from the delay target, the rest is what a batch may linger
+    uint32_t linger_us() const
+    {
+        if(!adaptive)
+        { return maxDelayUs; }
+        return (rpcLatencyUs < maxDelayUs ? static_cast<uint32_t>(maxDelayUs - rpcLatencyUs) : 0);
+    }
+
+    std::chrono::steady_clock::time_point
+    send_time(std::chrono::steady_clock::time_point const &pending_since) const
+    {
+        uint32_t linger = linger_us();
+        if(adaptive && arrivalsPerUs * linger < 1.0)
+        { return pending_since; }
+        return pending_since + std::chrono::microseconds(linger);
+    }
+
+    // feedback of a completed send : the events it carried, how long its first event waited from
+    // being enqueued to the send completion, and the RPC latency itself
+    void batch_sent(uint32_t event_count, uint64_t event_delay_us, uint64_t rpc_latency_us
+                    , std::chrono::steady_clock::time_point const &send_start)
+    {
+        rpcLatencyUs = (rpcLatencyUs == 0 ? rpc_latency_us : (3 * rpcLatencyUs + rpc_latency_us) / 4);
+
+        uint64_t interval_us = std::chrono::duration_cast <std::chrono::microseconds>(send_start - lastSendTime).count();
+        lastSendTime = send_start;
+        double arrivals = static_cast<double>(event_count) / std::max <uint64_t>(1, interval_us);
+        // after an idle gap the old rate says nothing about the current load
+        arrivalsPerUs = (interval_us > 4 * static_cast<uint64_t>(maxDelayUs) ? arrivals
+                                                                           : (3 * arrivalsPerUs + arrivals) / 4);
+
+        if(!adaptive)
+        { return; }
+        if(event_delay_us > maxDelayUs && rpcLatencyUs < maxDelayUs)
+        { targetBatchEvents = std::max <uint32_t>(1, targetBatchEvents / 2); }
+        else if(event_count >= targetBatchEvents)
+        { targetBatchEvents = std::min(maxBatchEvents, targetBatchEvents + increaseStep); }
+    }
+
+    uint64_t rpc_latency_us() const
+    { return rpcLatencyUs; }
+
+    // events per second
+    double arrival_rate() const
+    { return arrivalsPerUs * 1e6; }
+
+private:
+    bool adaptive;
+    uint32_t maxBatchEvents;
+    uint32_t maxDelayUs;
+    uint32_t increaseStep;
+    uint32_t targetBatchEvents;
+    uint64_t rpcLatencyUs;
+    double arrivalsPerUs;
+    std::chrono::steady_clock::time_point lastSendTime;
+};
+
+}
+
+#endif
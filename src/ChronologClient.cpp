@@ -3,12 +3,31 @@
 
 chronolog::Client::Client(ChronoLog::ConfigurationManager const &confManager)
 {
-    chronologClientImpl = chronolog::ChronologClientImpl::GetClientImplInstance(confManager);
+    chronologClientImpl = chronolog::ChronologClientImpl::CreateClientImpl(confManager);
 }
 
-chronolog::Client::Client(chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf)
+chronolog::Client::Client(chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf
+                          , chronolog::ClientRecordingConf const &clientRecordingConf
+                          , chronolog::ClientRpcConf const &clientRpcConf
+                          , chronolog::ClientMemoryConf const &clientMemoryConf
+                          , chronolog::ClientAggregationConf const &clientAggregationConf)
 {
-    chronologClientImpl = chronolog::ChronologClientImpl::GetClientImplInstance(visorClientPortalServiceConf);
+    chronologClientImpl = chronolog::ChronologClientImpl::CreateClientImpl(visorClientPortalServiceConf
+                                                                           , clientRecordingConf, clientRpcConf
+                                                                           , clientMemoryConf, clientAggregationConf);
+}
+
+chronolog::Client::Client(chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf
+                          , chronolog::ClientQueryServiceConf const &clientQueryServiceConf
+                          , chronolog::ClientRecordingConf const &clientRecordingConf
+                          , chronolog::ClientRpcConf const &clientRpcConf
+                          , chronolog::ClientMemoryConf const &clientMemoryConf
+                          , chronolog::ClientAggregationConf const &clientAggregationConf)
+{
+    chronologClientImpl = chronolog::ChronologClientImpl::CreateClientImpl(visorClientPortalServiceConf
+                                                                           , clientQueryServiceConf
+                                                                           , clientRecordingConf, clientRpcConf
+                                                                           , clientMemoryConf, clientAggregationConf);
 }
 
 chronolog::Client::~Client()
@@ -26,6 +45,32 @@ int chronolog::Client::Disconnect()
     return chronologClientImpl->Disconnect();
 }
 
+#ifdef CHRONOLOG_ENABLE_MPI
+int chronolog::Client::ConnectAll(MPI_Comm comm)
+{
+    return chronologClientImpl->ConnectAll(comm);
+}
+
+std::pair <int, chronolog::StoryHandle*>
+chronolog::Client::AcquireStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                          , std::string const &story_name
+                                          , const std::map <std::string, std::string> &attrs, int &flags)
+{
+    return chronologClientImpl->AcquireStoryCollective(comm, chronicle_name, story_name, attrs, flags);
+}
+
+int chronolog::Client::PlaybackStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                               , std::string const &story_name, uint64_t start, uint64_t end
+                                               , std::vector <chronolog::Event> &playback_events
+                                               , uint64_t chunk_duration, uint32_t concurrent_queries
+                                               , chronolog::PlaybackRedistribution redistribution)
+{
+    return chronologClientImpl->PlaybackStoryCollective(comm, chronicle_name, story_name, start, end
+                                                        , playback_events, chunk_duration, concurrent_queries
+                                                        , redistribution);
+}
+#endif
+
 int chronolog::Client::CreateChronicle(std::string const &chronicle_name
                                        , std::map <std::string, std::string> const &attrs, int &flags)
 {
@@ -76,4 +121,17 @@ chronolog::Client::ShowStories(std::string const &chronicle_name, std::vector <s
     return chronologClientImpl->ShowStories(chronicle_name, stories);
 }
 
+std::string &chronolog::Client::GetMetricsSnapshot(std::string &snapshot, std::string const &format)
+{
+    return chronologClientImpl->GetMetricsSnapshot(snapshot, format);
+}
+
+int chronolog::Client::Flush(std::chrono::steady_clock::time_point const &deadline)
+{
+    return chronologClientImpl->Flush(deadline);
+}
 
+uint64_t chronolog::Client::GetMemoryUsage(uint64_t &memory_limit) const
+{
+    return chronologClientImpl->GetMemoryUsage(memory_limit);
+}
@@ -1,66 +1,183 @@
 #include <unistd.h>
 #include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
 #include "ChronologClientImpl.h"
 #include "StorytellerClient.h"
 #include "city.h"
 
 namespace chl = chronolog;
 
-std::mutex chronolog::ChronologClientImpl::chronologClientMutex;
-chronolog::ChronologClientImpl*chronolog::ChronologClientImpl::chronologClientImplInstance{nullptr};
+std::mutex chronolog::ChronologClientImpl::instanceSlotMutex;
+std::bitset <chronolog::MAX_CLIENT_INSTANCES> chronolog::ChronologClientImpl::instanceSlots;
+std::atomic <uint32_t> chronolog::ChronologClientImpl::liveInstances{0};
 
 
 chronolog::ChronologClientImpl*
-chronolog::ChronologClientImpl::GetClientImplInstance(ChronoLog::ConfigurationManager const &confManager)
+chronolog::ChronologClientImpl::CreateClientImpl(ChronoLog::ConfigurationManager const &confManager)
 {
-    std::lock_guard <std::mutex> lock_client(chronologClientMutex);
-    if(chronologClientImplInstance == nullptr)
+    ChronoLog::LogConf const &log_conf = confManager.CLIENT_CONF.CLIENT_LOG_CONF;
+    if(!log_conf.LOGTYPE.empty())
+    {
+        chrono_monitor::initialize(log_conf.LOGTYPE, log_conf.LOGFILE, log_conf.LOGLEVEL, log_conf.LOGNAME
+                                   , log_conf.LOGFILESIZE, log_conf.LOGFILENUM, log_conf.FLUSHLEVEL, log_conf.LOGASYNC
+                                   , (log_conf.LOGASYNCQUEUESIZE > 0 ? log_conf.LOGASYNCQUEUESIZE : 8192)
+                                   , (log_conf.LOGASYNCBLOCK ? spdlog::async_overflow_policy::block
+                                                             : spdlog::async_overflow_policy::overrun_oldest));
+    }
+    else
     {
-        chronologClientImplInstance = new ChronologClientImpl(confManager);
+        chrono_monitor::initialize("file", "/tmp/chrono_client.log", spdlog::level::info, "chrono_client", 1024000, 3
+                                   , spdlog::level::warn, true);
     }
 
-    return chronologClientImplInstance;
+    return new ChronologClientImpl(confManager);
 }
 
 
-chronolog::ChronologClientImpl*chronolog::ChronologClientImpl::GetClientImplInstance(
-        chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf)
+chronolog::ChronologClientImpl*chronolog::ChronologClientImpl::CreateClientImpl(
+        chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf
+        , chronolog::ClientRecordingConf const &clientRecordingConf
+        , chronolog::ClientRpcConf const &clientRpcConf
+        , chronolog::ClientMemoryConf const &clientMemoryConf
+        , chronolog::ClientAggregationConf const &clientAggregationConf)
+{
+    // any interface of the portal protocol, the engine picks the port
+    chronolog::ClientQueryServiceConf clientQueryServiceConf(visorClientPortalServiceConf.proto_conf(), "", 0);
+
+    return CreateClientImpl(visorClientPortalServiceConf, clientQueryServiceConf, clientRecordingConf, clientRpcConf
+                            , clientMemoryConf, clientAggregationConf);
+}
+
+chronolog::ChronologClientImpl*chronolog::ChronologClientImpl::CreateClientImpl(
+        chronolog::ClientPortalServiceConf const &visorClientPortalServiceConf
+        , chronolog::ClientQueryServiceConf const &clientQueryServiceConf
+        , chronolog::ClientRecordingConf const &clientRecordingConf
+        , chronolog::ClientRpcConf const &clientRpcConf
+        , chronolog::ClientMemoryConf const &clientMemoryConf
+        , chronolog::ClientAggregationConf const &clientAggregationConf)
 {
     chrono_monitor::initialize("file", "/tmp/chrono_client.log", spdlog::level::info, "chrono_client", 1024000, 3
-                               , spdlog::level::warn);
-        
-    chronolog::ClientQueryServiceConf clientQueryServiceConf;
+                               , spdlog::level::warn, true);
 
-    std::lock_guard <std::mutex> lock_client(chronologClientMutex);
+    return new ChronologClientImpl(clientQueryServiceConf, visorClientPortalServiceConf, clientRecordingConf
+                                   , clientRpcConf, clientMemoryConf, clientAggregationConf);
+}
 
-    if(chronologClientImplInstance == nullptr)
+////////
+namespace
+{
+// "block", "drop" or "sample" of the client configuration file
+chl::RateLimitMode rate_limit_mode(std::string const &mode_name)
+{
+    if(mode_name == "drop")
+    { return chl::RATE_LIMIT_DROP; }
+    if(mode_name == "sample")
+    { return chl::RATE_LIMIT_SAMPLE; }
+    return chl::RATE_LIMIT_BLOCK;
+}
+
+// the ServiceId of the address the engine listens on, "protocol://ip:port" or, with some providers,
+// "protocol://fi_sockaddr_in://ip:port" ; the configured ip is kept if the engine reports a host name
+chl::ServiceId engine_service_id(thallium::engine &engine, std::string const &protocol, std::string const &ip
+                                 , uint16_t provider_id)
+{
+    std::string self_address = engine.self();
+    std::size_t host_start = self_address.rfind("://");
+    host_start = (host_start == std::string::npos ? 0 : host_start + 3);
+    std::size_t port_start = self_address.rfind(':');
+    if(port_start == std::string::npos || port_start < host_start)
     {
-        chronologClientImplInstance = new ChronologClientImpl(clientQueryServiceConf, visorClientPortalServiceConf);
+        LOG_ERROR("[ChronologClientImpl] Can not tell the query service port from the engine address {}"
+                  , self_address);
+        return chl::ServiceId(protocol, ip, 0, provider_id);
     }
+    uint16_t port = static_cast<uint16_t>(std::strtoul(self_address.c_str() + port_start + 1, nullptr, 10));
+    chl::ServiceId service_id(protocol, self_address.substr(host_start, port_start - host_start), port, provider_id);
+    if(service_id.getIPaddr() == 0)
+    { service_id = chl::ServiceId(protocol, ip, port, provider_id); }
+    return service_id;
+}
+}
 
-    return chronologClientImplInstance;
+void chronolog::ChronologClientImpl::start_query_service(std::string const &protocol, std::string const &ip
+                                                         , uint16_t base_port, uint16_t provider_id)
+{
+    // the client instances of a process listen on consecutive ports from the configured one,
+    // past the port range the engine picks the port
+    std::string engine_address = protocol;
+    if(!ip.empty())
+    {
+        engine_address += "://" + ip;
+        uint32_t port = base_port + instanceNumber;
+        if(base_port != 0 && instanceNumber < MAX_CLIENT_INSTANCES && port <= std::numeric_limits <uint16_t>::max())
+        { engine_address += ":" + std::to_string(port); }
+        else if(base_port != 0)
+        {
+            LOG_ERROR("[ChronologClientImpl] Query service port {} of client instance {} is out of range, the engine"
+                      " picks the port", port, instanceNumber);
+        }
+    }
+    tlEngine = new thallium::engine(engine_address, THALLIUM_SERVER_MODE, true, 1);
+
+    chl::ServiceId query_service_id = engine_service_id(*tlEngine, protocol, ip, provider_id);
+    LOG_INFO("[ChronologClientImpl] Query service listening on {}", chl::to_string(query_service_id));
+    storyReaderService = chl::ClientQueryService::CreateClientQueryService(*tlEngine, query_service_id, rpcConf
+                                                                          , &memoryBudget, metricsLabels);
 }
 
-////////
 chronolog::ChronologClientImpl::ChronologClientImpl(const ChronoLog::ConfigurationManager &confManager)
         : clientState(UNKNOWN)
         , clientLogin("")
-        , hostId(0) , pid(0) , clientId(0)
+        , instanceNumber(acquire_instance_slot()), metricsLabels(chl::instance_metrics_labels(instanceNumber))
+        , hostId(0) , pid(0) , clientId(0), visorClientId(0), collectiveMember(false)
+        , recordingConf(confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.BATCHING
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_EVENTS
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_BYTES
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.MAX_BATCH_DELAY_US
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.ADAPTIVE_BATCHING
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.CLIENT_MAX_EVENTS_PER_SEC
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.CLIENT_MAX_BYTES_PER_SEC
+                        , rate_limit_mode(confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.RATE_LIMIT_MODE)
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.RATE_LIMIT_BLOCK_MS
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.RATE_LIMIT_SAMPLE_EVERY
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.RATE_LIMIT_BURST_MS
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.HIGH_PRIORITY_WEIGHT
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.NORMAL_PRIORITY_WEIGHT
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.LOW_PRIORITY_WEIGHT
+                        , confManager.CLIENT_CONF.CLIENT_RECORDING_CONF.DRAIN_TIMEOUT_MS)
+        , rpcConf(confManager.CLIENT_CONF.CLIENT_RPC_POLICY_CONF.RPC_TIMEOUT_MS
+                  , confManager.CLIENT_CONF.CLIENT_RPC_POLICY_CONF.HEDGING
+                  , confManager.CLIENT_CONF.CLIENT_RPC_POLICY_CONF.HEDGE_PERCENTILE)
+        , aggregationConf(confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.NODE_AGGREGATION
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.SEGMENT_NAME
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.PROCESS_SLOTS
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.RING_BYTES
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.RING_WAIT_MS
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.FORWARD_POLL_US
+                          , confManager.CLIENT_CONF.CLIENT_AGGREGATION_CONF.ELECTION_INTERVAL_MS)
+        , memoryBudget(chl::ClientMemoryConf(confManager.CLIENT_CONF.CLIENT_MEMORY_CONF.MAX_MEMORY_BYTES
+                                             , confManager.CLIENT_CONF.CLIENT_MEMORY_CONF.RECLAIM_PERCENT
+                                             , confManager.CLIENT_CONF.CLIENT_MEMORY_CONF.MEMORY_WAIT_MS)
+                       , metricsLabels)
         , tlEngine(nullptr)
         , rpcVisorClient(nullptr)
         , storyteller(nullptr)
         , storyReaderService(nullptr)
+        , playbackWorkers(PLAYBACK_WORKERS)
 {
+    ++liveInstances;
     defineClientIdentity();
 
-    tlEngine = new thallium::engine(confManager.CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.PROTO_CONF
-                                    , THALLIUM_SERVER_MODE, true, 1);
+    start_query_service(confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.PROTO_CONF
+                        , confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.IP
+                        , confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.BASE_PORT
+                        , confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.SERVICE_PROVIDER_ID);
 
-    storyReaderService= chl::ClientQueryService::CreateClientQueryService(*tlEngine, 
-                        chl::ServiceId( confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.PROTO_CONF,
-                        hostId, confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.BASE_PORT,
-                        confManager.CLIENT_CONF.CLIENT_QUERY_SERVICE_CONF.SERVICE_PROVIDER_ID));
-                    
 
     std::string CLIENT_VISOR_NA_STRING =
             confManager.CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.PROTO_CONF + "://" +
@@ -68,7 +185,15 @@ chronolog::ChronologClientImpl::ChronologClientImpl(const ChronoLog::Configurati
             std::to_string(confManager.CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.BASE_PORT);
 
     rpcVisorClient = chl::RpcVisorClient::CreateRpcVisorClient(*tlEngine, CLIENT_VISOR_NA_STRING
-                                                               , confManager.CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.SERVICE_PROVIDER_ID);
+                                                               , confManager.CLIENT_CONF.VISOR_CLIENT_PORTAL_SERVICE_CONF.RPC_CONF.SERVICE_PROVIDER_ID
+                                                               , rpcConf.rpc_timeout_ms());
+
+    if(!confManager.CLIENT_CONF.CLIENT_METRICS_CONF.METRICS_FILE.empty())
+    {
+        chl::chrono_metrics::start_periodic_dump(confManager.CLIENT_CONF.CLIENT_METRICS_CONF.METRICS_FILE
+                                                 , confManager.CLIENT_CONF.CLIENT_METRICS_CONF.DUMP_INTERVAL_SEC
+                                                 , confManager.CLIENT_CONF.CLIENT_METRICS_CONF.DUMP_FORMAT);
+    }
 
     //tlEngine->wait_for_finalize();
 }
@@ -76,33 +201,57 @@ chronolog::ChronologClientImpl::ChronologClientImpl(const ChronoLog::Configurati
 
 chronolog::ChronologClientImpl::ChronologClientImpl(
     chronolog::ClientQueryServiceConf const& clientQueryServiceConf,
-    chronolog::ClientPortalServiceConf const& clientPortalServiceConf)
+    chronolog::ClientPortalServiceConf const& clientPortalServiceConf,
+    chronolog::ClientRecordingConf const& clientRecordingConf,
+    chronolog::ClientRpcConf const& clientRpcConf,
+    chronolog::ClientMemoryConf const& clientMemoryConf,
+    chronolog::ClientAggregationConf const& clientAggregationConf)
         : clientState(UNKNOWN)
         , clientLogin("")
-        , hostId(0), pid(0), clientId(0)
+        , instanceNumber(acquire_instance_slot()), metricsLabels(chl::instance_metrics_labels(instanceNumber))
+        , hostId(0), pid(0), clientId(0), visorClientId(0), collectiveMember(false)
+        , recordingConf(clientRecordingConf)
+        , rpcConf(clientRpcConf)
+        , aggregationConf(clientAggregationConf)
+        , memoryBudget(clientMemoryConf, metricsLabels)
         , tlEngine(nullptr)
         , rpcVisorClient(nullptr)
         , storyteller(nullptr)
         , storyReaderService(nullptr)
+        , playbackWorkers(PLAYBACK_WORKERS)
 {
 
+    ++liveInstances;
     defineClientIdentity();
 
-    tlEngine = new thallium::engine(clientQueryServiceConf.proto_conf(), THALLIUM_SERVER_MODE, true, 1);
-    
-    storyReaderService= chl::ClientQueryService::CreateClientQueryService(*tlEngine, chronolog::ServiceId(clientQueryServiceConf.proto_conf(), 
-                                        hostId, clientQueryServiceConf.port(), clientQueryServiceConf.provider_id()));
+    start_query_service(clientQueryServiceConf.proto_conf(), clientQueryServiceConf.ip(), clientQueryServiceConf.port()
+                        , clientQueryServiceConf.provider_id());
 
     std::string CLIENT_VISOR_NA_STRING =
             clientPortalServiceConf.proto_conf() + "://" + clientPortalServiceConf.ip() + ":" +
             std::to_string(clientPortalServiceConf.port());
 
     rpcVisorClient = chl::RpcVisorClient::CreateRpcVisorClient(*tlEngine, CLIENT_VISOR_NA_STRING
-                                                               , clientPortalServiceConf.provider_id());
+                                                               , clientPortalServiceConf.provider_id()
+                                                               , rpcConf.rpc_timeout_ms());
 }
 
 ////////
 
+// the instances of the process share the Visor identity, they record under the client id of their slot
+uint32_t chronolog::ChronologClientImpl::acquire_instance_slot()
+{
+    std::lock_guard <std::mutex> slot_lock(instanceSlotMutex);
+    uint32_t instance = 0;
+    while(instance < MAX_CLIENT_INSTANCES && instanceSlots.test(instance))
+    { ++instance; }
+    if(instance < MAX_CLIENT_INSTANCES)
+    { instanceSlots.set(instance); }
+    else
+    { LOG_ERROR("[ChronologClientImpl] All {} client instance slots are in use", MAX_CLIENT_INSTANCES); }
+    return instance;
+}
+
 void chronolog::ChronologClientImpl::defineClientIdentity()
 {
     euid = geteuid(); //TODO: effective uid might be a better choice than login name ...
@@ -115,15 +264,25 @@ void chronolog::ChronologClientImpl::defineClientIdentity()
     //32bit host identifier
     hostId = gethostid();
     //32bit process id
-    pid = getpid();
+    pid = static_cast<uint32_t>(getpid());
     LOG_INFO("[ChronologClientImpl] Client Identity - Login: {}, EUID: {}, HostID: {}, PID: {}", clientLogin, euid
              , hostId, pid);
 }
 
 chronolog::ChronologClientImpl::~ChronologClientImpl()
 {
+    // the dump covers the metrics of all the instances, the last client instance stops it ;
+    // no-op if it was never started
+    if(--liveInstances == 0)
+    { chl::chrono_metrics::stop_periodic_dump(); }
+
     if(storyteller != nullptr)
-    { delete storyteller; }
+    {
+        // the client was not disconnected : what it still holds gets the same bounded drain
+        if(clientState == CONNECTED)
+        { drain_storyteller(); }
+        delete storyteller;
+    }
 
     if(rpcVisorClient != nullptr)
     { delete rpcVisorClient; }
@@ -137,6 +296,19 @@ chronolog::ChronologClientImpl::~ChronologClientImpl()
         delete tlEngine;
     }
 
+    if(instanceNumber < MAX_CLIENT_INSTANCES)
+    {
+        std::lock_guard <std::mutex> slot_lock(instanceSlotMutex);
+        instanceSlots.reset(instanceNumber);
+    }
+}
+
+int chronolog::ChronologClientImpl::drain_storyteller()
+{
+    if(storyteller == nullptr)
+    { return chronolog::CL_SUCCESS; }
+    return storyteller->drain(std::chrono::steady_clock::now()
+                              + std::chrono::milliseconds(recordingConf.drain_timeout_ms()));
 }
 
 int chronolog::ChronologClientImpl::Connect()
@@ -150,24 +322,26 @@ int chronolog::ChronologClientImpl::Connect()
                 "[ChronoLogClientImpl] Already connected or in the process of shutting down. No further action taken.");
         return chronolog::CL_SUCCESS;
     }
-
+    if(instanceNumber == MAX_CLIENT_INSTANCES)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Connection refused: the client instance has no instance slot.");
+        return chronolog::CL_ERR_UNKNOWN;
+    }
 
     auto connectResponseMsg = rpcVisorClient->Connect(euid, hostId, pid);
 
-    std::stringstream ss;
-    ss << connectResponseMsg;
-    LOG_DEBUG("[ChronoLogClientImpl] Connection attempt to Visor completed. Response received: {}", ss.str());
+    if(LOG_LEVEL_ENABLED(spdlog::level::debug))
+    {
+        std::stringstream ss;
+        ss << connectResponseMsg;
+        LOG_DEBUG("[ChronoLogClientImpl] Connection attempt to Visor completed. Response received: {}", ss.str());
+    }
 
     int return_code = connectResponseMsg.getErrorCode();
     if(return_code == chronolog::CL_SUCCESS)
     {
-        clientState = CONNECTED;
-        clientId = connectResponseMsg.getClientId();
-        if(storyteller == nullptr)
-        {
-            storyteller = new StorytellerClient(clockProxy, *storyReaderService, clientId);
-        }
-        //TODO: if we ever change the connection hashing algorithm we'd need to handle reconnection case with the new client_id 
+        set_connected(connectResponseMsg.getClientId()
+                      , chronolog::instance_client_id(connectResponseMsg.getClientId(), instanceNumber), false);
     }
     else
     {
@@ -176,6 +350,23 @@ int chronolog::ChronologClientImpl::Connect()
     return return_code;
 }
 
+void chronolog::ChronologClientImpl::set_connected(ClientId visor_client_id, ClientId client_id
+                                                   , bool collective_member)
+{
+    clientState = CONNECTED;
+    visorClientId = visor_client_id;
+    clientId = client_id;
+    collectiveMember = collective_member;
+    if(storyteller == nullptr)
+    {
+        storyteller = new StorytellerClient(clockProxy, *storyReaderService, clientId, recordingConf, rpcConf
+                                            , &memoryBudget, aggregationConf, metricsLabels);
+    }
+    else
+    { storyteller->resume_events(); }
+    //TODO: if we ever change the connection hashing algorithm we'd need to handle reconnection case with the new client_id 
+}
+
 int chronolog::ChronologClientImpl::Disconnect()
 {
     std::lock_guard <std::mutex> lock_client(chronologClientMutex);
@@ -186,7 +377,18 @@ int chronolog::ChronologClientImpl::Disconnect()
         return chronolog::CL_SUCCESS;
     }
 
-    auto return_code = rpcVisorClient->Disconnect(clientId);
+    // the events already logged reach the keepers before the Visor lets go of the client
+    int drain_return = drain_storyteller();
+
+    // the Visor only knows rank 0 of a collective connection
+    if(collectiveMember)
+    {
+        clientState = SHUTTING_DOWN;
+        LOG_INFO("[ChronoLogClientImpl] Left the collective connection to Visor.");
+        return drain_return;
+    }
+
+    auto return_code = rpcVisorClient->Disconnect(visorClientId);
     if(return_code == chronolog::CL_SUCCESS)
     {
         clientState = SHUTTING_DOWN;
@@ -196,7 +398,7 @@ int chronolog::ChronologClientImpl::Disconnect()
     {
         LOG_ERROR("[ChronoLogClientImpl] Failed to disconnect from Visor. Error code: {}", return_code);
     }
-    return return_code;
+    return (return_code == chronolog::CL_SUCCESS ? drain_return : return_code);
 
 }
 
@@ -219,7 +421,7 @@ int chronolog::ChronologClientImpl::CreateChronicle(std::string const &chronicle
     }
 
     // Attempt to create the chronicle using the Visor client.
-    int result = rpcVisorClient->CreateChronicle(clientId, chronicle_name, attrs, flags);
+    int result = rpcVisorClient->CreateChronicle(visorClientId, chronicle_name, attrs, flags);
 
     // Log the outcome of the create operation.
     if(result == chronolog::CL_SUCCESS)
@@ -243,7 +445,7 @@ int chronolog::ChronologClientImpl::DestroyChronicle(std::string const &chronicl
     if((clientState == UNKNOWN) || (clientState == SHUTTING_DOWN))
     { return chronolog::CL_ERR_NO_CONNECTION; }
 
-    int result = rpcVisorClient->DestroyChronicle(clientId, chronicle_name);
+    int result = rpcVisorClient->DestroyChronicle(visorClientId, chronicle_name);
 
     // Log the outcome of the destroy operation.
     if(result == chronolog::CL_SUCCESS)
@@ -276,7 +478,7 @@ int chronolog::ChronologClientImpl::DestroyStory(std::string const &chronicle_na
     }
 
     // Attempt to destroy the chronicle using the Visor client.
-    int result = rpcVisorClient->DestroyStory(clientId, chronicle_name, story_name);
+    int result = rpcVisorClient->DestroyStory(visorClientId, chronicle_name, story_name);
 
     // Log the outcome of the destroy operation.
     if(result == chronolog::CL_SUCCESS)
@@ -328,11 +530,23 @@ chronolog::ChronologClientImpl::AcquireStory(std::string const &chronicle_name,
     }
 
     // issue rpc request to the Visor
-    auto acquireStoryResponse = rpcVisorClient->AcquireStory(clientId, chronicle_name, story_name, attrs, flags);
+    auto acquireStoryResponse = rpcVisorClient->AcquireStory(visorClientId, chronicle_name, story_name, attrs, flags);
+
+    if(LOG_LEVEL_ENABLED(spdlog::level::debug))
+    {
+        std::stringstream ss;
+        ss << acquireStoryResponse;
+        LOG_DEBUG("[ChronoLogClientImpl] Response from AcquireStory RPC call: {}", ss.str());
+    }
+    return initialize_acquired_story(chronicle_name, story_name, acquireStoryResponse, attrs);
+}
 
-    std::stringstream ss;
-    ss << acquireStoryResponse;
-    LOG_DEBUG("[ChronoLogClientImpl] Response from AcquireStory RPC call: {}", ss.str());
+std::pair <int, chronolog::StoryHandle*>
+chronolog::ChronologClientImpl::initialize_acquired_story(std::string const &chronicle_name
+                                                          , std::string const &story_name
+                                                          , AcquireStoryResponseMsg const &acquireStoryResponse
+                                                          , const std::map <std::string, std::string> &attrs)
+{
     if(acquireStoryResponse.getErrorCode() != chronolog::CL_SUCCESS)
     {
         LOG_ERROR("[ChronoLogClientImpl] Failed to acquire story '{}' from chronicle '{}'. Error code: {}", story_name
@@ -343,10 +557,10 @@ chronolog::ChronologClientImpl::AcquireStory(std::string const &chronicle_name,
     //successfull AcquireStoryResponse carries Visor generated StoryId & vector<KeeperIdCard> 
     // for the Keepers assigned to record the acquired story
 
-    storyHandle = storyteller->initializeStoryWritingHandle(chronicle_name, story_name
+    chronolog::StoryHandle*storyHandle = storyteller->initializeStoryWritingHandle(chronicle_name, story_name
                                                             , acquireStoryResponse.getStoryId()
                                                             , acquireStoryResponse.getKeepers()
-                    , acquireStoryResponse.getPlayer());
+                    , acquireStoryResponse.getPlayer(), attrs);
 
     if(storyHandle == nullptr)
     {
@@ -399,8 +613,12 @@ int chronolog::ChronologClientImpl::ReleaseStory(std::string const &chronicle_na
         return chronolog::CL_ERR_NO_CONNECTION;
     }
 
+    // the story was acquired by rank 0 on behalf of the collective connection, rank 0 releases it
+    if(collectiveMember)
+    { return chronolog::CL_SUCCESS; }
+
     // Attempt to release the story by sending a request to the Visor.
-    auto releaseStatus = rpcVisorClient->ReleaseStory(clientId, chronicle_name, story_name);
+    auto releaseStatus = rpcVisorClient->ReleaseStory(visorClientId, chronicle_name, story_name);
     if(releaseStatus != chronolog::CL_SUCCESS)
     {
         LOG_ERROR("[ChronoLogClientImpl] Failed to release story '{}' from chronicle '{}'. Error code: {}", story_name
@@ -415,6 +633,426 @@ int chronolog::ChronologClientImpl::ReleaseStory(std::string const &chronicle_na
     return releaseStatus;
 }
 
+#ifdef CHRONOLOG_ENABLE_MPI
+namespace
+{
+// bytes rank 0 broadcasts to the other ranks, or the ranks exchange with each other
+class CollectiveBuffer
+{
+public:
+    std::string bytes;
+    std::size_t readOffset = 0;
+    bool readFailed = false;
+
+    template <typename T>
+    void put(T value)
+    { bytes.append(reinterpret_cast<char const*>(&value), sizeof(T)); }
+
+    void put(std::string const &value)
+    {
+        put(static_cast<uint32_t>(value.size()));
+        bytes.append(value);
+    }
+
+    void put(chl::ServiceId const &service_id)
+    {
+        put(service_id.getProtocol());
+        put(service_id.getIPaddr());
+        put(service_id.getPort());
+        put(service_id.getProviderId());
+    }
+
+    template <typename T>
+    T get()
+    {
+        T value{};
+        if(readOffset + sizeof(T) > bytes.size())
+        {
+            readFailed = true;
+            return value;
+        }
+        std::memcpy(&value, bytes.data() + readOffset, sizeof(T));
+        readOffset += sizeof(T);
+        return value;
+    }
+
+    std::string get_string()
+    {
+        uint32_t length = get <uint32_t>();
+        if(readFailed || readOffset + length > bytes.size())
+        {
+            readFailed = true;
+            return std::string();
+        }
+        readOffset += length;
+        return bytes.substr(readOffset - length, length);
+    }
+
+    chl::ServiceId get_service_id()
+    {
+        std::string protocol = get_string();
+        uint32_t ip_addr = get <uint32_t>();
+        uint16_t port = get <uint16_t>();
+        uint16_t provider_id = get <uint16_t>();
+        return chl::ServiceId(protocol, ip_addr, port, provider_id);
+    }
+};
+
+void pack_acquire_story_response(chl::AcquireStoryResponseMsg const &response, CollectiveBuffer &buffer)
+{
+    buffer.put(static_cast<int32_t>(response.getErrorCode()));
+    buffer.put(static_cast<uint64_t>(response.getStoryId()));
+    buffer.put(static_cast<uint32_t>(response.getKeepers().size()));
+    for(auto const &keeper_id_card: response.getKeepers())
+    {
+        buffer.put(static_cast<uint32_t>(keeper_id_card.getGroupId()));
+        buffer.put(keeper_id_card.getRecordingServiceId());
+    }
+    buffer.put(response.getPlayer());
+}
+
+chl::AcquireStoryResponseMsg unpack_acquire_story_response(CollectiveBuffer &buffer)
+{
+    int error_code = buffer.get <int32_t>();
+    chl::StoryId story_id = buffer.get <uint64_t>();
+    uint32_t keeper_count = buffer.get <uint32_t>();
+    std::vector <chl::KeeperIdCard> keepers;
+    for(uint32_t i = 0; i < keeper_count && !buffer.readFailed; ++i)
+    {
+        chl::RecordingGroupId group_id = buffer.get <uint32_t>();
+        keepers.emplace_back(group_id, buffer.get_service_id());
+    }
+    chl::ServiceId player = buffer.get_service_id();
+    if(buffer.readFailed)
+    { return chl::AcquireStoryResponseMsg(chl::CL_ERR_UNKNOWN, 0, std::vector <chl::KeeperIdCard>()); }
+    return chl::AcquireStoryResponseMsg(error_code, story_id, keepers, player);
+}
+
+// rank 0's bytes end up in the buffer of every rank
+bool broadcast_response(MPI_Comm comm, int rank, CollectiveBuffer &buffer)
+{
+    uint64_t byte_count = buffer.bytes.size();
+    if(MPI_Bcast(&byte_count, 1, MPI_UINT64_T, 0, comm) != MPI_SUCCESS)
+    { return false; }
+    if(rank != 0)
+    { buffer.bytes.resize(byte_count); }
+    return (MPI_Bcast(&buffer.bytes[0], static_cast<int>(byte_count), MPI_BYTE, 0, comm) == MPI_SUCCESS);
+}
+
+// first of the count items that go to part out of parts, without overflowing count * part
+uint64_t split_point(uint64_t count, int part, int parts)
+{
+    uint64_t part_index = static_cast<uint64_t>(part);
+    return count / parts * part_index + count % parts * part_index / parts;
+}
+
+// [slice_start, slice_end) : part out of parts of [start, end) in whole chunk_duration chunks, empty if there are
+// fewer chunks than parts
+void time_slice(uint64_t start, uint64_t end, uint64_t chunk_duration, int part, int parts, uint64_t &slice_start
+                , uint64_t &slice_end)
+{
+    uint64_t first_chunk = start / chunk_duration;
+    uint64_t chunk_count = (end - 1) / chunk_duration + 1 - first_chunk;
+    uint64_t max_chunk = std::numeric_limits <uint64_t>::max() / chunk_duration;
+    uint64_t slice_first_chunk = first_chunk + split_point(chunk_count, part, parts);
+    uint64_t slice_end_chunk = first_chunk + split_point(chunk_count, part + 1, parts);
+    slice_start = std::max(start, slice_first_chunk * chunk_duration);
+    slice_end = (slice_end_chunk > max_chunk ? end : std::min(end, slice_end_chunk * chunk_duration));
+    if(slice_start > slice_end)
+    { slice_start = slice_end; }
+}
+
+// sends every event to the rank destination(i) of its index, the events received are appended in rank order
+bool exchange_events(MPI_Comm comm, int ranks, std::vector <chl::Event> &events
+                     , std::function <int(std::size_t)> const &destination)
+{
+    std::vector <CollectiveBuffer> send_buffers(ranks);
+    for(std::size_t i = 0; i < events.size(); ++i)
+    {
+        CollectiveBuffer &buffer = send_buffers[destination(i)];
+        buffer.put(static_cast<uint64_t>(events[i].time()));
+        buffer.put(static_cast<uint64_t>(events[i].client_id()));
+        buffer.put(static_cast<uint32_t>(events[i].index()));
+        buffer.put(events[i].log_record());
+    }
+    events.clear();
+
+    std::vector <int64_t> send_bytes(ranks);
+    std::vector <int64_t> receive_bytes(ranks);
+    for(int rank = 0; rank < ranks; ++rank)
+    { send_bytes[rank] = static_cast<int64_t>(send_buffers[rank].bytes.size()); }
+    if(MPI_Alltoall(send_bytes.data(), 1, MPI_INT64_T, receive_bytes.data(), 1, MPI_INT64_T, comm) != MPI_SUCCESS)
+    { return false; }
+
+    // MPI_Alltoallv counts and displacements are ints, every rank gives up if any would overflow them
+    std::vector <int> send_counts(ranks), send_displs(ranks), receive_counts(ranks), receive_displs(ranks);
+    int64_t send_total = 0;
+    int64_t receive_total = 0;
+    for(int rank = 0; rank < ranks; ++rank)
+    {
+        send_counts[rank] = static_cast<int>(send_bytes[rank]);
+        send_displs[rank] = static_cast<int>(send_total);
+        send_total += send_bytes[rank];
+        receive_counts[rank] = static_cast<int>(receive_bytes[rank]);
+        receive_displs[rank] = static_cast<int>(receive_total);
+        receive_total += receive_bytes[rank];
+    }
+    int fits = (send_total <= std::numeric_limits <int>::max() && receive_total <= std::numeric_limits <int>::max());
+    int all_fit = 0;
+    if(MPI_Allreduce(&fits, &all_fit, 1, MPI_INT, MPI_MIN, comm) != MPI_SUCCESS || !all_fit)
+    { return false; }
+
+    std::string send_data;
+    send_data.reserve(send_total);
+    for(auto const &buffer: send_buffers)
+    { send_data.append(buffer.bytes); }
+    send_buffers.clear();
+    CollectiveBuffer received;
+    received.bytes.resize(receive_total);
+    if(MPI_Alltoallv(&send_data[0], send_counts.data(), send_displs.data(), MPI_BYTE, &received.bytes[0]
+                     , receive_counts.data(), receive_displs.data(), MPI_BYTE, comm) != MPI_SUCCESS)
+    { return false; }
+
+    while(received.readOffset < received.bytes.size() && !received.readFailed)
+    {
+        uint64_t event_time = received.get <uint64_t>();
+        chl::ClientId client_id = received.get <uint64_t>();
+        uint32_t event_index = received.get <uint32_t>();
+        std::string record = received.get_string();
+        if(!received.readFailed)
+        { events.emplace_back(event_time, client_id, event_index, std::move(record)); }
+    }
+    return !received.readFailed;
+}
+}
+
+int chronolog::ChronologClientImpl::ConnectAll(MPI_Comm comm)
+{
+    int rank = 0;
+    if(MPI_Comm_rank(comm, &rank) != MPI_SUCCESS)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective connection failed: MPI_Comm_rank error.");
+        return chronolog::CL_ERR_UNKNOWN;
+    }
+
+    std::lock_guard <std::mutex> lock_client(chronologClientMutex);
+    bool connected = ((clientState != UNKNOWN) && (clientState != SHUTTING_DOWN));
+
+    // error code and Visor client id, only rank 0 talks to the Visor
+    int64_t response[2] = {chronolog::CL_SUCCESS, static_cast<int64_t>(visorClientId)};
+    if(rank == 0 && !connected)
+    {
+        auto connectResponseMsg = rpcVisorClient->Connect(euid, hostId, pid);
+        response[0] = connectResponseMsg.getErrorCode();
+        response[1] = static_cast<int64_t>(connectResponseMsg.getClientId());
+    }
+    if(MPI_Bcast(response, 2, MPI_INT64_T, 0, comm) != MPI_SUCCESS)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective connection failed: MPI_Bcast error.");
+        return chronolog::CL_ERR_UNKNOWN;
+    }
+
+    int return_code = static_cast<int>(response[0]);
+    if(return_code != chronolog::CL_SUCCESS)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective connection to Visor failed with error code: {}", return_code);
+        return return_code;
+    }
+    if(connected)
+    {
+        LOG_INFO("[ChronoLogClientImpl] Already connected. No further action taken.");
+        return chronolog::CL_SUCCESS;
+    }
+    if(instanceNumber == MAX_CLIENT_INSTANCES)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Rank {} can not join the collective connection: no instance slot.", rank);
+        return chronolog::CL_ERR_UNKNOWN;
+    }
+
+    // the other ranks talk to the Visor with rank 0's client id but record under the id the Visor
+    // would issue their own process, so their events can not be confused with any other client's
+    ClientId visor_client_id = static_cast<ClientId>(response[1]);
+    ClientId rank_client_id = chronolog::instance_client_id(
+            (rank == 0 ? visor_client_id : chronolog::process_client_id(hostId, euid, pid)), instanceNumber);
+    set_connected(visor_client_id, rank_client_id, (rank != 0));
+    LOG_INFO("[ChronoLogClientImpl] Rank {} joined the collective connection to Visor, ClientId {}", rank, clientId);
+    return chronolog::CL_SUCCESS;
+}
+
+std::pair <int, chronolog::StoryHandle*>
+chronolog::ChronologClientImpl::AcquireStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                                       , std::string const &story_name
+                                                       , const std::map <std::string, std::string> &attrs
+                                                       , int &flags)
+{
+    // the arguments are the same on all the ranks, so they all return here
+    if(chronicle_name.empty() || story_name.empty())
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Failed to acquire story: Missing essential parameters.");
+        return std::pair <int, chronolog::StoryHandle*>(chronolog::CL_ERR_INVALID_ARG, nullptr);
+    }
+
+    int rank = 0;
+    if(MPI_Comm_rank(comm, &rank) != MPI_SUCCESS)
+    { return std::pair <int, chronolog::StoryHandle*>(chronolog::CL_ERR_UNKNOWN, nullptr); }
+
+    std::lock_guard <std::mutex> lock_client(chronologClientMutex);
+    bool connected = ((clientState != UNKNOWN) && (clientState != SHUTTING_DOWN));
+
+    CollectiveBuffer buffer;
+    if(rank == 0)
+    {
+        // rank 0 asks the Visor even if it holds the story already, the other ranks may not
+        AcquireStoryResponseMsg acquireStoryResponse(chronolog::CL_ERR_NO_CONNECTION, 0
+                                                     , std::vector <KeeperIdCard>());
+        if(connected)
+        {
+            acquireStoryResponse = rpcVisorClient->AcquireStory(visorClientId, chronicle_name, story_name, attrs
+                                                                , flags);
+        }
+        pack_acquire_story_response(acquireStoryResponse, buffer);
+    }
+    if(!broadcast_response(comm, rank, buffer))
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective acquisition of story '{}' failed: MPI_Bcast error.", story_name);
+        return std::pair <int, chronolog::StoryHandle*>(chronolog::CL_ERR_UNKNOWN, nullptr);
+    }
+    AcquireStoryResponseMsg acquireStoryResponse = unpack_acquire_story_response(buffer);
+
+    if(!connected)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Failed to acquire story '{}' from chronicle '{}': Client is not connected."
+                  , story_name, chronicle_name);
+        return std::pair <int, chronolog::StoryHandle*>(chronolog::CL_ERR_NO_CONNECTION, nullptr);
+    }
+
+    chronolog::StoryHandle*storyHandle = storyteller->findStoryWritingHandle(chronicle_name, story_name);
+    if(storyHandle != nullptr && acquireStoryResponse.getErrorCode() == chronolog::CL_SUCCESS)
+    { return std::pair <int, chronolog::StoryHandle*>(chronolog::CL_SUCCESS, storyHandle); }
+
+    return initialize_acquired_story(chronicle_name, story_name, acquireStoryResponse, attrs);
+}
+
+int chronolog::ChronologClientImpl::PlaybackStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                                            , std::string const &story_name, uint64_t start
+                                                            , uint64_t end, std::vector <Event> &playback_events
+                                                            , uint64_t chunk_duration, uint32_t concurrent_queries
+                                                            , PlaybackRedistribution redistribution)
+{
+    playback_events.clear();
+
+    // the arguments are the same on all the ranks, so they all return here
+    if(chronicle_name.empty() || story_name.empty() || start >= end)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective playback: invalid story or time range.");
+        return chronolog::CL_ERR_INVALID_ARG;
+    }
+
+    int rank = 0;
+    int ranks = 0;
+    if(MPI_Comm_rank(comm, &rank) != MPI_SUCCESS || MPI_Comm_size(comm, &ranks) != MPI_SUCCESS)
+    { return chronolog::CL_ERR_UNKNOWN; }
+
+    uint64_t playback_start = chl::metrics_now_ns();
+    chronolog::StoryHandle*storyHandle = nullptr;
+    {
+        std::lock_guard <std::mutex> lock_client(chronologClientMutex);
+        if(storyteller != nullptr && clientState != UNKNOWN && clientState != SHUTTING_DOWN)
+        { storyHandle = storyteller->findStoryWritingHandle(chronicle_name, story_name); }
+    }
+
+    int return_code = chronolog::CL_ERR_NOT_ACQUIRED;
+    if(storyHandle != nullptr)
+    {
+        // the slice of this rank, read in chunk aligned sub-ranges that each go to the player as a query
+        chunk_duration = std::max <uint64_t>(1, chunk_duration);
+        uint64_t slice_start = 0;
+        uint64_t slice_end = 0;
+        time_slice(start, end, chunk_duration, rank, ranks, slice_start, slice_end);
+
+        uint32_t query_count = std::max <uint32_t>(1, concurrent_queries);
+        std::vector <std::vector <Event>> query_events(query_count);
+        std::vector <int> query_returns(query_count, chronolog::CL_SUCCESS);
+        std::vector <std::function <void()>> queries;
+        for(uint32_t i = 0; i < query_count && slice_start < slice_end; ++i)
+        {
+            uint64_t query_start = 0;
+            uint64_t query_end = 0;
+            time_slice(slice_start, slice_end, chunk_duration, i, query_count, query_start, query_end);
+            if(query_start < query_end)
+            {
+                queries.emplace_back([storyHandle, query_start, query_end, &query_events, &query_returns, i]()
+                                     {
+                                         query_returns[i] = storyHandle->playback_story(query_start, query_end
+                                                                                        , query_events[i]);
+                                     });
+            }
+        }
+        // at most PLAYBACK_WORKERS of the sub-queries run at once
+        playbackWorkers.run(queries);
+
+        // the sub-ranges follow each other, so do their sorted events
+        return_code = chronolog::CL_SUCCESS;
+        for(uint32_t i = 0; i < query_count; ++i)
+        {
+            if(query_returns[i] != chronolog::CL_SUCCESS)
+            { return_code = query_returns[i]; }
+            std::move(query_events[i].begin(), query_events[i].end(), std::back_inserter(playback_events));
+        }
+    }
+
+    int all_return_code = return_code;
+    if(MPI_Allreduce(&return_code, &all_return_code, 1, MPI_INT, MPI_MIN, comm) != MPI_SUCCESS)
+    { return chronolog::CL_ERR_UNKNOWN; }
+    if(all_return_code != chronolog::CL_SUCCESS)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective playback of story '{}' failed, local error code: {}", story_name
+                  , return_code);
+        return all_return_code;
+    }
+
+    bool exchanged = true;
+    if(redistribution == PLAYBACK_BALANCED)
+    {
+        // the slices are in rank order, so are the events ; rank r gets the r-th equal share of all of them
+        uint64_t event_count = playback_events.size();
+        uint64_t event_offset = 0;
+        uint64_t total_events = 0;
+        if(MPI_Exscan(&event_count, &event_offset, 1, MPI_UINT64_T, MPI_SUM, comm) != MPI_SUCCESS
+           || MPI_Allreduce(&event_count, &total_events, 1, MPI_UINT64_T, MPI_SUM, comm) != MPI_SUCCESS)
+        { return chronolog::CL_ERR_UNKNOWN; }
+        if(rank == 0)
+        { event_offset = 0; }   // MPI_Exscan leaves it undefined on rank 0
+
+        int destination_rank = 0;
+        exchanged = exchange_events(comm, ranks, playback_events, [&](std::size_t i)
+        {
+            while(destination_rank + 1 < ranks
+                  && event_offset + i >= split_point(total_events, destination_rank + 1, ranks))
+            { ++destination_rank; }
+            return destination_rank;
+        });
+    }
+    else if(redistribution == PLAYBACK_BY_CLIENT)
+    {
+        exchanged = exchange_events(comm, ranks, playback_events, [&](std::size_t i)
+        { return static_cast<int>(playback_events[i].client_id() % static_cast<uint64_t>(ranks)); });
+        std::sort(playback_events.begin(), playback_events.end());
+    }
+    if(!exchanged)
+    {
+        LOG_ERROR("[ChronoLogClientImpl] Collective playback of story '{}': event redistribution failed.", story_name);
+        return chronolog::CL_ERR_UNKNOWN;
+    }
+
+    chl::chrono_metrics::getInstance().histogram("chronolog_collective_playback_duration_ns", metricsLabels).record(
+            chl::metrics_now_ns() - playback_start);
+    LOG_DEBUG("[ChronoLogClientImpl] Collective playback of story '{}' [{},{}) : rank {} holds {} events", story_name
+              , start, end, rank, playback_events.size());
+    return chronolog::CL_SUCCESS;
+}
+#endif
+
 //TODO: client account must be passed into the rpc call 
 int chronolog::ChronologClientImpl::GetChronicleAttr(std::string const &chronicle_name, const std::string &key
                                                      , std::string &value)
@@ -438,7 +1076,7 @@ int chronolog::ChronologClientImpl::GetChronicleAttr(std::string const &chronicl
     }
 
     // Attempt to fetch the attribute from the Visor using the RPC call.
-    int fetchStatus = rpcVisorClient->GetChronicleAttr(clientId, chronicle_name, key, value);
+    int fetchStatus = rpcVisorClient->GetChronicleAttr(visorClientId, chronicle_name, key, value);
     if(fetchStatus != chronolog::CL_SUCCESS)
     {
         LOG_ERROR("[ChronoLogClientImpl] Failed to fetch attribute '{}' for chronicle '{}'. Error code: {}", key
@@ -474,7 +1112,7 @@ int chronolog::ChronologClientImpl::EditChronicleAttr(std::string const &chronic
     }
 
     // Attempt to edit the attribute in the Visor using the RPC call.
-    int editStatus = rpcVisorClient->EditChronicleAttr(clientId, chronicle_name, key, value);
+    int editStatus = rpcVisorClient->EditChronicleAttr(visorClientId, chronicle_name, key, value);
     if(editStatus != chronolog::CL_SUCCESS)
     {
         LOG_ERROR("[ChronoLogClientImpl] Failed to edit attribute '{}' for chronicle '{}'. Error code: {}", key
@@ -499,7 +1137,7 @@ std::vector <std::string> &chronolog::ChronologClientImpl::ShowChronicles(std::v
     }
 
     // Fetch the list of chronicles from the Visor using the RPC call.
-    chronicles = rpcVisorClient->ShowChronicles(clientId);
+    chronicles = rpcVisorClient->ShowChronicles(visorClientId);
 
     // Log the number of chronicles fetched and return the list.
     if(!chronicles.empty())
@@ -533,7 +1171,7 @@ chronolog::ChronologClientImpl::ShowStories(std::string const &chronicle_name, s
     }
 
     // Fetch stories for the given chronicle name using the RPC call.
-    stories = rpcVisorClient->ShowStories(clientId, chronicle_name);
+    stories = rpcVisorClient->ShowStories(visorClientId, chronicle_name);
 
     // Log the number of stories fetched and return the list.
     if(!stories.empty())
@@ -550,3 +1188,33 @@ chronolog::ChronologClientImpl::ShowStories(std::string const &chronicle_name, s
 
 //////////////////////////////
 
+std::string &chronolog::ChronologClientImpl::GetMetricsSnapshot(std::string &snapshot, std::string const &format)
+{
+    chl::MetricsSnapshot metrics_snapshot = chl::chrono_metrics::getInstance().snapshot();
+    metrics_snapshot.keep_instance(metricsLabels);
+    snapshot = (format == "prometheus" ? metrics_snapshot.to_prometheus() : metrics_snapshot.to_json());
+    return snapshot;
+}
+
+//////////////////////////////
+
+int chronolog::ChronologClientImpl::Flush(std::chrono::steady_clock::time_point const &deadline)
+{
+    std::lock_guard <std::mutex> lock_client(chronologClientMutex);
+
+    // no storyteller, no events were logged
+    if(nullptr == storyteller)
+    { return chronolog::CL_SUCCESS; }
+
+    return storyteller->flush(deadline);
+}
+
+//////////////////////////////
+
+uint64_t chronolog::ChronologClientImpl::GetMemoryUsage(uint64_t &memory_limit) const
+{
+    memory_limit = memoryBudget.limit_bytes();
+    return memoryBudget.used_bytes();
+}
+
+//////////////////////////////
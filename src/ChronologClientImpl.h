@@ -1,6 +1,9 @@
 #ifndef CHRONOLOG_CLIENT_IMPL_H
 #define CHRONOLOG_CLIENT_IMPL_H
 
+#include <bitset>
+#include <mutex>
+
 #include "chronolog_errcode.h"
 #include "ConfigurationManager.h"
 #include "ClientConfiguration.h"
@@ -12,6 +15,9 @@
 #include "rpcVisorClient.h"
 #include "StorytellerClient.h"
 #include "ClientQueryService.h"
+#include "chrono_metrics.h"
+#include "MemoryBudget.h"
+#include "PlaybackWorkerPool.h"
 
 namespace chronolog
 {
@@ -25,16 +31,22 @@ class ChronologClientImpl
 {
 public:
 
-    // static mutex ensures that there'd be the single instance
-    // of ChronologClientImpl ever created regardless of the
-    // thread(s) GetClientImplInstance() is called from
-    static std::mutex chronologClientMutex;
-    static ChronologClientImpl*chronologClientImplInstance;
-
+    // every call creates an independent client, with its own engine, Visor connection, storyteller
+    // and query service ; the logger and the metrics registry are shared by the instances of the process
     static ChronologClientImpl*
-    GetClientImplInstance(ChronoLog::ConfigurationManager const &);
+    CreateClientImpl(ChronoLog::ConfigurationManager const &);
     static ChronologClientImpl*
-    GetClientImplInstance(chronolog::ClientPortalServiceConf const &);
+    CreateClientImpl(chronolog::ClientPortalServiceConf const &
+                          , chronolog::ClientRecordingConf const & = chronolog::ClientRecordingConf()
+                          , chronolog::ClientRpcConf const & = chronolog::ClientRpcConf()
+                          , chronolog::ClientMemoryConf const & = chronolog::ClientMemoryConf()
+                          , chronolog::ClientAggregationConf const & = chronolog::ClientAggregationConf());
+    static ChronologClientImpl*
+    CreateClientImpl(chronolog::ClientPortalServiceConf const &, chronolog::ClientQueryServiceConf const &
+                          , chronolog::ClientRecordingConf const & = chronolog::ClientRecordingConf()
+                          , chronolog::ClientRpcConf const & = chronolog::ClientRpcConf()
+                          , chronolog::ClientMemoryConf const & = chronolog::ClientMemoryConf()
+                          , chronolog::ClientAggregationConf const & = chronolog::ClientAggregationConf());
 
     // the classs is non-copyable
     ChronologClientImpl(ChronologClientImpl const &) = delete;
@@ -47,6 +59,20 @@ public:
 
     int Disconnect(); 
 
+#ifdef CHRONOLOG_ENABLE_MPI
+    int ConnectAll(MPI_Comm comm);
+
+    std::pair <int, StoryHandle*> AcquireStoryCollective(MPI_Comm comm, std::string const &chronicle_name
+                                                         , std::string const &story_name
+                                                         , const std::map <std::string, std::string> &attrs
+                                                         , int &flags);
+
+    int PlaybackStoryCollective(MPI_Comm comm, std::string const &chronicle_name, std::string const &story_name
+                                , uint64_t start, uint64_t end, std::vector <Event> &playback_events
+                                , uint64_t chunk_duration, uint32_t concurrent_queries
+                                , PlaybackRedistribution redistribution);
+#endif
+
     int CreateChronicle(std::string const &chronicle_name, const std::map <std::string, std::string> &attrs
                         , int &flags);
 
@@ -66,25 +92,69 @@ public:
     std::vector <std::string> &ShowChronicles(std::vector <std::string> &);
     std::vector <std::string> &ShowStories(const std::string &chronicle_name, std::vector <std::string> &);
 
+    std::string &GetMetricsSnapshot(std::string &, std::string const &format);
+
+    int Flush(std::chrono::steady_clock::time_point const &deadline);
+
+    uint64_t GetMemoryUsage(uint64_t &memory_limit) const;
+
 private:
 
+    // the instance slots of the live clients of the process, a destroyed client frees its slot
+    // threads the concurrent sub-queries of the collective playbacks of a client share
+    static constexpr uint32_t PLAYBACK_WORKERS = 8;
+
+    static std::mutex instanceSlotMutex;
+    static std::bitset <MAX_CLIENT_INSTANCES> instanceSlots;
+    static std::atomic <uint32_t> liveInstances;
+
+    std::mutex chronologClientMutex;   // serializes the calls of the client threads on this instance
     ChronologClientState clientState;
     std::string clientLogin;
+    uint32_t instanceNumber;   // slot of the client instance in the process, MAX_CLIENT_INSTANCES if none was free
+    std::string metricsLabels;   // instance label of the metric series of this client instance
     uint32_t euid;
     uint32_t hostId;
     uint32_t pid;
-    ClientId clientId;
+    ClientId clientId;        // the client id of the events recorded by this process
+    ClientId visorClientId;   // the client id the Visor knows, rank 0's for the ranks of a collective connection
+    bool collectiveMember;    // non root rank of a collective connection, the Visor does not know this process
+    ClientRecordingConf recordingConf;
+    ClientRpcConf rpcConf;
+    ClientAggregationConf aggregationConf;
+    MemoryBudget memoryBudget;   // outlives the storyteller and the query service that charge it
     ChronologTimer clockProxy;
     thallium::engine*tlEngine;
     RpcVisorClient*rpcVisorClient;
     StorytellerClient*storyteller;
     ClientQueryService * storyReaderService;
+    PlaybackWorkerPool playbackWorkers;   // runs the sub-queries of the collective playbacks
     
     ChronologClientImpl(const ChronoLog::ConfigurationManager &conf_manager);
-    ChronologClientImpl( ClientQueryServiceConf const& , ClientPortalServiceConf const&);
+    ChronologClientImpl( ClientQueryServiceConf const& , ClientPortalServiceConf const&, ClientRecordingConf const&
+                       , ClientRpcConf const&, ClientMemoryConf const&, ClientAggregationConf const&);
 
     void defineClientIdentity();
 
+    // the lowest free instance slot of the process, MAX_CLIENT_INSTANCES if all are taken
+    static uint32_t acquire_instance_slot();
+
+    // creates the engine listening on the query service address and the ClientQueryService,
+    // which advertises the address the engine actually listens on
+    void start_query_service(std::string const &protocol, std::string const &ip, uint16_t base_port
+                             , uint16_t provider_id);
+
+    // called with the client mutex held once the Visor accepted the connection
+    void set_connected(ClientId visor_client_id, ClientId client_id, bool collective_member);
+
+    std::pair <int, StoryHandle*> initialize_acquired_story(std::string const &chronicle_name
+                                                            , std::string const &story_name
+                                                            , AcquireStoryResponseMsg const &acquire_story_response
+                                                            , const std::map <std::string, std::string> &attrs);
+
+    // stops the intake and waits up to drain_timeout_ms for the buffered events to reach the keepers
+    int drain_storyteller();
+
 };
 } //namespace chronolog
 
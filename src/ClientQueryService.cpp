@@ -1,12 +1,18 @@
 
 
+#include <algorithm>
+#include <chrono>
 #include <thallium.hpp>
 #include <thallium/serialization/stl/vector.hpp>
 #include <cereal/archives/binary.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/tuple.hpp>
 
 #include "chronolog_errcode.h"
 #include "chrono_monitor.h"
 #include "StoryChunk.h"
+#include "EventBatch.h"
 #include "ClientQueryService.h"
 #include "PlaybackQueryRpcClient.h"
 
@@ -15,15 +21,35 @@ namespace chl = chronolog;
 
 
 
-chl::ClientQueryService::ClientQueryService(thallium::engine & tl_engine, chl::ServiceId const& client_service_id)
+chl::ClientQueryService::ClientQueryService(thallium::engine & tl_engine, chl::ServiceId const& client_service_id
+        , chl::ClientRpcConf const& rpc_conf, chl::MemoryBudget * memory_budget, std::string const& metrics_labels)
         : tl::provider <ClientQueryService>(tl_engine, client_service_id.getProviderId())
         , queryServiceEngine(tl_engine)
         , queryServiceId(client_service_id)
+        , queryIdIndex(0)
+        , rpcConf(rpc_conf)
+        , memoryBudget(memory_budget)
+        , chunkIngestLatency(chl::chrono_metrics::getInstance().histogram("chronolog_playback_chunk_ingest_latency_ns"
+                                                           , metrics_labels))
+        , chunksReceived(chl::chrono_metrics::getInstance().counter("chronolog_playback_chunks_received_total"
+                                                           , metrics_labels))
+        , chunkBytesReceived(chl::chrono_metrics::getInstance().counter("chronolog_playback_bytes_received_total"
+                                                           , metrics_labels))
+        , chunkEventsReceived(chl::chrono_metrics::getInstance().counter("chronolog_playback_events_received_total"
+                                                           , metrics_labels))
+        , chunkIngestFailures(chl::chrono_metrics::getInstance().counter("chronolog_playback_chunk_failures_total"
+                                                           , metrics_labels))
+        , playbackLatency(chl::chrono_metrics::getInstance().histogram("chronolog_playback_request_latency_ns"
+                                                           , metrics_labels))
+        , hedgedRequests(chl::chrono_metrics::getInstance().counter("chronolog_playback_hedged_requests_total"
+                                                           , metrics_labels))
 {
 
     LOG_DEBUG("[ClientQueryService] created  service {}", chl::to_string(queryServiceId));
 
          define("receive_story_chunk", &ClientQueryService::receive_story_chunk, tl::ignore_return_value());
+         define("receive_query_story_chunk", &ClientQueryService::receive_query_story_chunk
+                , tl::ignore_return_value());
          //set up callback for the case when the engine is being finalized while this provider is still alive
          get_engine().push_finalize_callback(this, [p = this]()
          { delete p; });
@@ -33,6 +59,8 @@ chl::ClientQueryService::ClientQueryService(thallium::engine & tl_engine, chl::S
 chl::ClientQueryService::~ClientQueryService()
 {
     LOG_DEBUG("[ClientQueryService] Destructor called. Cleaning up...");
+    // a stray request is bounded by the rpc timeout, if any
+    reap_stray_requests(true);
     get_engine().pop_finalize_callback(this);
 }
 
@@ -51,6 +79,260 @@ uint32_t chl::ClientQueryService::start_new_query(chl::ChronicleName const& chro
     return query_id;
 }
 
+// attach the StoryChunk to its query ; a chunk received without the query goes to the oldest active query
+// for the same story whose time range it overlaps, and the other overlapping queries get a copy of the events
+// in their range, charged to the memory budget in proportion to the events copied
+bool chl::ClientQueryService::attach_story_chunk(uint32_t query_id, chl::StoryChunk * story_chunk
+                                                 , std::size_t chunk_bytes)
+{
+    std::lock_guard <std::mutex> lock(queryServiceMutex);
+
+    std::vector <chl::StoryPlaybackQuery*> queries;
+    for(auto query_iter = (query_id == ANY_QUERY ? activeQueryMap.begin() : activeQueryMap.find(query_id));
+            query_iter != activeQueryMap.end(); ++query_iter)
+    {
+        chl::StoryPlaybackQuery & query = (*query_iter).second;
+        if(query.chronicleName == story_chunk->getChronicleName() && query.storyName == story_chunk->getStoryName()
+           && story_chunk->getStartTime() < query.endTime && story_chunk->getEndTime() > query.startTime)
+        { queries.push_back(&query); }
+        if(query_id != ANY_QUERY)
+        { break; }
+    }
+    if(queries.empty())
+    { return false; }
+
+    // the copies are made before the chunk itself is handed over, merging it moves its events out
+    for(std::size_t i = queries.size(); i-- > 0;)
+    {
+        chl::StoryPlaybackQuery & query = *queries[i];
+        chl::StoryChunk * query_chunk = story_chunk;
+        if(i > 0)
+        {
+            query_chunk = new chl::StoryChunk(story_chunk->getChronicleName(), story_chunk->getStoryName()
+                                              , story_chunk->getStoryId()
+                                              , std::max(story_chunk->getStartTime(), query.startTime)
+                                              , std::min(story_chunk->getEndTime(), query.endTime));
+            for(auto event_iter = story_chunk->lower_bound(query.startTime);
+                    event_iter != story_chunk->end() && (*event_iter).second.time() < query.endTime; ++event_iter)
+            { query_chunk->insertEvent((*event_iter).second); }
+
+            // the query service lock is held, the copy does not wait for the budget
+            std::size_t copy_bytes = (story_chunk->getEventCount() == 0 ? 0
+                                      : chunk_bytes * query_chunk->getEventCount() / story_chunk->getEventCount());
+            if(memoryBudget != nullptr && !memoryBudget->try_acquire(copy_bytes, chl::MEMORY_PLAYBACK))
+            {
+                LOG_WARNING("[ClientQueryService] Memory budget exhausted, query {} misses {} events of StoryChunk"
+                            " {}-{}", query.queryId, query_chunk->getEventCount(), story_chunk->getStartTime()
+                            , story_chunk->getEndTime());
+                chunkIngestFailures.add(1);
+                delete query_chunk;
+                continue;
+            }
+            query.responseBytes += copy_bytes;
+        }
+        else
+        { query.responseBytes += chunk_bytes; }
+
+        auto insert_return = query.PlaybackResponse.insert(
+                std::pair <uint64_t, chl::StoryChunk*>(query_chunk->getStartTime(), query_chunk));
+        if(!insert_return.second)
+        {
+            // the Player split the response differently, fold the events into the chunk we already have
+            (*insert_return.first).second->mergeEvents(*query_chunk);
+            delete query_chunk;
+        }
+    }
+    return true;
+}
+
+int chl::ClientQueryService::collect_query_response(uint32_t query_id, std::vector<chl::Event> & playback_events)
+{
+    std::lock_guard <std::mutex> lock(queryServiceMutex);
+
+    auto query_iter = activeQueryMap.find(query_id);
+    if(query_iter == activeQueryMap.end())
+    { return chl::CL_ERR_NOT_EXIST; }
+
+    chl::StoryPlaybackQuery & query = (*query_iter).second;
+    for(auto & chunk_record : query.PlaybackResponse)
+    {
+        chl::StoryChunk * story_chunk = chunk_record.second;
+        for(auto event_iter = story_chunk->lower_bound(query.startTime);
+                event_iter != story_chunk->end() && (*event_iter).second.time() < query.endTime; ++event_iter)
+        {
+            // the chunk is deleted right after, its records are moved out
+            chl::LogEvent & log_event = (*event_iter).second;
+            playback_events.emplace_back(log_event.time(), log_event.getClientId(), log_event.index()
+                                         , std::move(log_event.logRecord));
+        }
+        delete story_chunk;
+    }
+    if(memoryBudget != nullptr)
+    { memoryBudget->release(query.responseBytes, chl::MEMORY_PLAYBACK); }
+    activeQueryMap.erase(query_iter);
+
+    // response chunks are keyed by their start time, so only overlapping chunks would leave the events unordered ;
+    // chunks of hedged requests split differently by two players overlap, their common events appear twice
+    if(!std::is_sorted(playback_events.begin(), playback_events.end()))
+    {
+        std::sort(playback_events.begin(), playback_events.end());
+        playback_events.erase(std::unique(playback_events.begin(), playback_events.end()), playback_events.end());
+    }
+
+    return chl::CL_SUCCESS;
+}
+
+int chl::ClientQueryService::run_playback_query(chl::PlaybackQueryRpcClient * player, chl::ChronicleName const& chronicle
+        , chl::StoryName const& story, chl::chrono_time const& start_time, chl::chrono_time const& end_time
+        , uint32_t & query_id)
+{
+    reap_stray_requests(false);
+
+    uint64_t request_start = chl::metrics_now_ns();
+    chl::PlaybackQueryRpcClient * alternate = (rpcConf.hedging() ? alternate_player(player, chronicle, story)
+                                                                 : nullptr);
+    uint64_t hedge_delay_ns = (alternate != nullptr && playbackLatency.count() >= MIN_HEDGE_SAMPLES
+                                       ? playbackLatency.percentile(rpcConf.hedge_percentile()) : 0);
+    if(hedge_delay_ns == 0)
+    {
+        int return_code = player->send_story_playback_request(chronicle, story, start_time, end_time, query_id);
+        playbackLatency.record(chl::metrics_now_ns() - request_start);
+        return return_code;
+    }
+
+    query_id = start_new_query(chronicle, story, start_time, end_time);
+
+    chl::PlaybackQueryRpcClient * players[] = {player, alternate};
+    auto hedged_responses = std::make_shared<HedgedResponses>();
+    std::vector<std::future<int>> responses;
+    std::vector<bool> answered;
+    std::size_t issued_players = 0;
+    std::size_t pending_requests = 0;
+    auto hedge_time = std::chrono::steady_clock::now() + std::chrono::nanoseconds(hedge_delay_ns);
+    int return_code = chl::CL_ERR_UNKNOWN;
+
+    std::unique_lock<std::mutex> response_lock(hedged_responses->responseMutex);
+    while(return_code != chl::CL_SUCCESS)
+    {
+        if(issued_players < 2 && (pending_requests == 0 || std::chrono::steady_clock::now() >= hedge_time))
+        {
+            if(issued_players > 0)
+            {
+                hedgedRequests.add(1);
+                LOG_DEBUG("[ClientQueryService] Hedging playback query {} to {}", query_id
+                          , chl::to_string(alternate->get_service_id()));
+            }
+            response_lock.unlock();
+            try
+            {
+                responses.push_back(send_hedged_request(players[issued_players], chronicle, story, start_time
+                                                        , end_time, query_id, issued_players, hedged_responses));
+                answered.push_back(false);
+                ++pending_requests;
+            }
+            catch(tl::exception const &ex)
+            {
+                LOG_ERROR("[ClientQueryService] Failed to send playback query {} to {} exception {}", query_id
+                          , chl::to_string(players[issued_players]->get_service_id()), ex.what());
+            }
+            ++issued_players;
+            response_lock.lock();
+            continue;
+        }
+        if(pending_requests == 0)
+        { break; }
+
+        // blocks until a response arrives, or until the hedge time while the alternate is not sent yet
+        if(hedged_responses->returnCodes.empty())
+        {
+            if(issued_players < 2)
+            { hedged_responses->responseCondition.wait_until(response_lock, hedge_time); }
+            else
+            { hedged_responses->responseCondition.wait(response_lock); }
+            continue;
+        }
+        for(auto const & request_return : hedged_responses->returnCodes)
+        {
+            answered[request_return.first] = true;
+            --pending_requests;
+            if(return_code != chl::CL_SUCCESS)
+            { return_code = request_return.second; }
+        }
+        hedged_responses->returnCodes.clear();
+    }
+    response_lock.unlock();
+    playbackLatency.record(chl::metrics_now_ns() - request_start);
+
+    // the losing player may still push chunks into the query, its response is waited for later
+    std::lock_guard <std::mutex> lock(strayRequestMutex);
+    for(std::size_t i = 0; i < responses.size(); ++i)
+    {
+        if(!answered[i])
+        { strayPlaybackRequests.push_back(std::move(responses[i])); }
+        else
+        { responses[i].get(); }
+    }
+    return return_code;
+}
+
+std::future<int> chl::ClientQueryService::send_hedged_request(chl::PlaybackQueryRpcClient * player
+        , chl::ChronicleName const& chronicle, chl::StoryName const& story, chl::chrono_time const& start_time
+        , chl::chrono_time const& end_time, uint32_t query_id, std::size_t request_index
+        , std::shared_ptr<HedgedResponses> const& hedged_responses)
+{
+    tl::async_response response = player->send_story_playback_request_async(chronicle, story, start_time, end_time
+                                                                            , query_id);
+    return std::async(std::launch::async
+                      , [player, request_index, hedged_responses, response = std::move(response)]() mutable
+    {
+        int return_code = player->complete_story_playback_request(response);
+        {
+            std::lock_guard<std::mutex> lock(hedged_responses->responseMutex);
+            hedged_responses->returnCodes.emplace_back(request_index, return_code);
+        }
+        hedged_responses->responseCondition.notify_all();
+        return return_code;
+    });
+}
+
+void chl::ClientQueryService::addStoryPlayer(chl::ChronicleName const& chronicle, chl::StoryName const& story
+                                             , chl::PlaybackQueryRpcClient * player)
+{
+    std::lock_guard <std::mutex> lock(queryServiceMutex);
+    storyPlayers[std::make_pair(chronicle, story)].insert(player);
+}
+
+chl::PlaybackQueryRpcClient * chl::ClientQueryService::alternate_player(chl::PlaybackQueryRpcClient * player
+        , chl::ChronicleName const& chronicle, chl::StoryName const& story)
+{
+    std::lock_guard <std::mutex> lock(queryServiceMutex);
+    auto story_iter = storyPlayers.find(std::make_pair(chronicle, story));
+    if(story_iter == storyPlayers.end())
+    { return nullptr; }
+    for(chl::PlaybackQueryRpcClient * story_player : (*story_iter).second)
+    {
+        if(story_player != nullptr && story_player != player)
+        { return story_player; }
+    }
+    return nullptr;
+}
+
+void chl::ClientQueryService::reap_stray_requests(bool wait_all)
+{
+    std::lock_guard <std::mutex> lock(strayRequestMutex);
+    for(auto request_iter = strayPlaybackRequests.begin(); request_iter != strayPlaybackRequests.end();)
+    {
+        if(!wait_all && (*request_iter).wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++request_iter;
+            continue;
+        }
+        // the request thread logs a failed response
+        (*request_iter).get();
+        request_iter = strayPlaybackRequests.erase(request_iter);
+    }
+}
+
 // find or create PlaybackServiceRpcClient associated with the remote Playback Service
 chl::PlaybackQueryRpcClient * chronolog::ClientQueryService::addPlaybackQueryClient(chl::ServiceId const& player_card)
 {
@@ -72,7 +354,8 @@ chl::PlaybackQueryRpcClient * chronolog::ClientQueryService::addPlaybackQueryCli
 
     try
     {
-        playbackRpcClient = chronolog::PlaybackQueryRpcClient::CreatePlaybackQueryRpcClient(*this, player_card); 
+        playbackRpcClient = chronolog::PlaybackQueryRpcClient::CreatePlaybackQueryRpcClient(*this, player_card
+                                                                                            , rpcConf.rpc_timeout_ms());
 
         auto insert_return = playbackRpcClientMap.insert(
                 std::pair <chl::service_endpoint, chl::PlaybackQueryRpcClient*>(
@@ -107,9 +390,30 @@ void chronolog::ClientQueryService::removePlaybackQueryClient(chl::ServiceId con
     // to safely remove it
 }
 
-// build transfer of the Response StoryChunks
 void chl::ClientQueryService::receive_story_chunk(tl::request  const& request, tl::bulk &b)
+{ ingest_story_chunk(request, b, ANY_QUERY); }
+
+void chl::ClientQueryService::receive_query_story_chunk(tl::request const& request, uint32_t query_id, tl::bulk &b)
+{ ingest_story_chunk(request, b, query_id); }
+
+// build transfer of the Response StoryChunks
+void chl::ClientQueryService::ingest_story_chunk(tl::request  const& request, tl::bulk &b, uint32_t query_id)
 {
+    uint64_t ingest_start = chl::metrics_now_ns();
+    // the transfer waits for the memory budget, which pushes back on the Player
+    std::size_t charged_bytes = 0;
+    if(memoryBudget != nullptr)
+    {
+        if(!memoryBudget->acquire(b.size(), chl::MEMORY_PLAYBACK))
+        {
+            LOG_ERROR("[ClientQueryService] Memory budget exhausted, refusing a story chunk of {} bytes, ThreadID={}"
+                      , b.size(), tl::thread::self_id());
+            chunkIngestFailures.add(1);
+            request.respond(30000000 + tl::thread::self_id());
+            return;
+        }
+        charged_bytes = b.size();
+    }
     try
     {
         tl::endpoint ep = request.get_endpoint();
@@ -128,13 +432,18 @@ void chl::ClientQueryService::receive_story_chunk(tl::request  const& request, t
         LOG_DEBUG("[ClientQueryService] Received {} bytes of StoryChunk data, ThreadID={}", b.size(), tl::thread::self_id());
   
         StoryChunk*story_chunk = new StoryChunk();
-        int ret = deserializedWithCereal(&mem_vec[0], b.size()
-                                               , *story_chunk);
+        // Players using the compact chunk encoding are told apart by its magic, the others send cereal archives
+        int ret = (chl::is_encoded_story_chunk(&mem_vec[0], b.size())
+                        ? chl::decode_story_chunk(&mem_vec[0], b.size(), *story_chunk)
+                        : deserializedWithCereal(&mem_vec[0], b.size(), *story_chunk));
         if(ret != CL_SUCCESS)
         {
             LOG_ERROR("[ClientQueryService] Failed to deserialize a story chunk, ThreadID={}"
                             , tl::thread::self_id());
             delete story_chunk;
+            if(memoryBudget != nullptr)
+            { memoryBudget->release(charged_bytes, chl::MEMORY_PLAYBACK); }
+            chunkIngestFailures.add(1);
             ret = 10000000 + tl::thread::self_id(); // arbitrary error code encoded with thread id
             LOG_ERROR("[ClientQueryService] Discarding the story chunk, responding {} to Keeper", ret);
             request.respond(ret);
@@ -143,16 +452,37 @@ void chl::ClientQueryService::receive_story_chunk(tl::request  const& request, t
         LOG_DEBUG("[ClientQueryService] StoryChunk received: StoryId {} StartTime {} eventCount {} ThreadID={}"
                         , story_chunk->getStoryId(), story_chunk->getStartTime(), story_chunk->getEventCount()
                         , tl::thread::self_id());
+
+        chunkIngestLatency.record(chl::metrics_now_ns() - ingest_start);
+        chunksReceived.add(1);
+        chunkBytesReceived.add(b.size());
+        chunkEventsReceived.add(story_chunk->getEventCount());
   
+        // the chunk is attached before the Player is answered : once it answers the story_playback_request
+        // the query may be collected, a chunk attached after that would be lost
+        if(!attach_story_chunk(query_id, story_chunk, charged_bytes))
+        {
+            LOG_WARNING("[ClientQueryService] No active query {} for StoryChunk {}-{} of Story {} {}, discarding it"
+                        , query_id, story_chunk->getStartTime(), story_chunk->getEndTime()
+                        , story_chunk->getChronicleName(), story_chunk->getStoryName());
+            delete story_chunk;
+            if(memoryBudget != nullptr)
+            { memoryBudget->release(charged_bytes, chl::MEMORY_PLAYBACK); }
+            chunkIngestFailures.add(1);
+            request.respond(40000000 + tl::thread::self_id());
+            return;
+        }
+
         request.respond(b.size());
         LOG_DEBUG("[ClientQueryService] StoryChunk recording RPC responded {}, ThreadID={}", b.size()
                         , tl::thread::self_id());
- 
-        // add StoryChunk to the QueryResponse Object 
         }
         catch(std::bad_alloc const &ex)
         {
             LOG_ERROR("[ClientQueryService] Failed to allocate memory for StoryChunk data, ThreadID={}" , tl::thread::self_id());
+            if(memoryBudget != nullptr)
+            { memoryBudget->release(charged_bytes, chl::MEMORY_PLAYBACK); }
+            chunkIngestFailures.add(1);
             request.respond(20000000 + tl::thread::self_id());
         }
 }
@@ -2,12 +2,21 @@
 #define CLIENT_QUERY_SERVICE_H
 
 #include <atomic>
+#include <condition_variable>
+#include <future>
+#include <limits>
+#include <list>
 #include <map>
 #include <mutex>
+#include <set>
 #include <thallium.hpp>
 
 #include "chronolog_types.h"
+#include "chronolog_client.h"
 #include "ServiceId.h"
+#include "ClientConfiguration.h"
+#include "chrono_metrics.h"
+#include "MemoryBudget.h"
 
 
 namespace tl = thallium;
@@ -27,9 +36,10 @@ struct StoryPlaybackQuery
     chrono_time startTime;
     chrono_time endTime;
     std::map<uint64_t,StoryChunk*> PlaybackResponse;
+    std::size_t responseBytes;   // charged to the client memory budget until the response is collected
 
     StoryPlaybackQuery(uint32_t query_id, ChronicleName const& chronicle, StoryName const& story, chrono_time const& start, chrono_time const& end)
-    : queryId(query_id),chronicleName(chronicle), storyName(story), startTime(start),endTime(end)
+    : queryId(query_id),chronicleName(chronicle), storyName(story), startTime(start),endTime(end), responseBytes(0)
     { }
 };
 
@@ -38,11 +48,13 @@ class ClientQueryService : public tl::provider <ClientQueryService>
 public:
     // Service should be created on the heap not the stack thus the constructor is private...
     static ClientQueryService *
-    CreateClientQueryService(thallium::engine & tl_engine, ServiceId const& client_service_id)
+    CreateClientQueryService(thallium::engine & tl_engine, ServiceId const& client_service_id
+                             , ClientRpcConf const& rpc_conf = ClientRpcConf(), MemoryBudget * memory_budget = nullptr
+                             , std::string const& metrics_labels = std::string())
     {
         try 
         {
-            return new ClientQueryService(tl_engine, client_service_id);
+            return new ClientQueryService(tl_engine, client_service_id, rpc_conf, memory_budget, metrics_labels);
         }
         catch(thallium::exception &)
         {
@@ -63,24 +75,92 @@ public:
     // destroy PlaybackServiceRpcClient associated with the remote Playback Service
     void removePlaybackQueryClient(ServiceId const& );
 
+    // record that the player serves the story, the playback requests of the story are only hedged
+    // to another player known to serve it
+    void addStoryPlayer(ChronicleName const&, StoryName const&, PlaybackQueryRpcClient *);
+
     uint32_t start_new_query(ChronicleName const&, StoryName const&, chrono_time const&, chrono_time const&);
 
+    // sends the story playback request to the player; with hedging the request is issued again to another
+    // player serving the story if the first one does not answer within the hedge percentile of the playback
+    // latency, both push their StoryChunks into the same query and the first successful response completes it
+    int run_playback_query(PlaybackQueryRpcClient * player, ChronicleName const&, StoryName const&
+                           , chrono_time const&, chrono_time const&, uint32_t & query_id);
+
+    // move the events of the StoryChunks received for the query into playback_events and retire the query
+    int collect_query_response(uint32_t query_id, std::vector<Event> & playback_events);
+
+    // StoryChunk of a Player that does not tell the query, attached to the queries of the story it overlaps
     void receive_story_chunk(tl::request const&, tl::bulk &);
 
+    // StoryChunk answering the query_id the Player was sent with the story_playback_request
+    void receive_query_story_chunk(tl::request const&, uint32_t query_id, tl::bulk &);
+
+    static int deserializedWithCereal(char *buffer, size_t size, StoryChunk &story_chunk);
+
 
 private:
-    ClientQueryService(thallium::engine & tl_engine, ServiceId const&);
+    ClientQueryService(thallium::engine & tl_engine, ServiceId const&, ClientRpcConf const&, MemoryBudget *
+                       , std::string const& metrics_labels);
 
     ClientQueryService() = delete;
     ClientQueryService(ClientQueryService const&) = delete;
 
-    int deserializedWithCereal(char *buffer, size_t size, StoryChunk &story_chunk);
+    // playback latency samples needed before the requests are hedged
+    static constexpr uint64_t MIN_HEDGE_SAMPLES = 16;
+
+    // query_id of the chunks received without one
+    static constexpr uint32_t ANY_QUERY = std::numeric_limits<uint32_t>::max();
+
+    // transfers, decodes and attaches the StoryChunk, then answers the Player
+    void ingest_story_chunk(tl::request const&, tl::bulk &, uint32_t query_id);
+
+    // attach the received StoryChunk to the active query it answers, takes ownership of the chunk
+    // and of the chunk_bytes it was charged to the memory budget
+    bool attach_story_chunk(uint32_t query_id, StoryChunk * story_chunk, std::size_t chunk_bytes);
+
+    // responses of the requests of one hedged playback query : request index, return code
+    struct HedgedResponses
+    {
+        std::mutex responseMutex;
+        std::condition_variable responseCondition;
+        std::vector<std::pair<std::size_t, int>> returnCodes;
+    };
+
+    // issues the playback request and waits for its response on a separate thread, which reports
+    // the return code to the hedged responses
+    std::future<int> send_hedged_request(PlaybackQueryRpcClient * player, ChronicleName const&, StoryName const&
+                                         , chrono_time const&, chrono_time const&, uint32_t query_id
+                                         , std::size_t request_index
+                                         , std::shared_ptr<HedgedResponses> const& hedged_responses);
+
+    // another player known to serve the story, nullptr if there is none
+    PlaybackQueryRpcClient * alternate_player(PlaybackQueryRpcClient * player, ChronicleName const&
+                                              , StoryName const&);
+
+    // waits for the responses of the losing hedged requests that have arrived
+    void reap_stray_requests(bool wait_all);
+
     thallium::engine  queryServiceEngine;
     ServiceId       queryServiceId;
     std::mutex queryServiceMutex;    
     std::atomic<int> queryIdIndex;
     std::map<uint32_t, StoryPlaybackQuery> activeQueryMap; // map of active queries by queryId
     std::map<service_endpoint, PlaybackQueryRpcClient*> playbackRpcClientMap; 
+    std::map<std::pair<ChronicleName, StoryName>, std::set<PlaybackQueryRpcClient*>> storyPlayers;
+    ClientRpcConf rpcConf;
+    MemoryBudget * memoryBudget;   // nullptr if the memory is not accounted
+    std::mutex strayRequestMutex;
+    std::list<std::future<int>> strayPlaybackRequests;   // hedged requests that lost the race
+
+    // playback ingest metrics
+    LatencyHistogram & chunkIngestLatency;
+    ShardedCounter & chunksReceived;
+    ShardedCounter & chunkBytesReceived;
+    ShardedCounter & chunkEventsReceived;
+    ShardedCounter & chunkIngestFailures;
+    LatencyHistogram & playbackLatency;
+    ShardedCounter & hedgedRequests;
 };
 
 
@@ -0,0 +1,483 @@
+#include <cstring>
+#include <map>
+
+#include "chronolog_errcode.h"
+#include "StoryChunk.h"
+#include "EventBatch.h"
+#include "chrono_lz.h"
+
+namespace chl = chronolog;
+
+namespace
+{
+
+const char EVENT_BATCH_MAGIC[4] = {'C', 'L', 'E', 'B'};
+const char STORY_CHUNK_MAGIC[4] = {'C', 'L', 'S', 'C'};
+const char MULTI_STORY_BATCH_MAGIC[4] = {'C', 'L', 'M', 'B'};
+const uint8_t ENCODING_VERSION = 1;
+
+inline void put_varint(std::string &out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline void put_signed_varint(std::string &out, int64_t value)
+{ put_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+
+inline void put_string(std::string &out, std::string const &a_string)
+{
+    put_varint(out, a_string.size());
+    out.append(a_string);
+}
+
+inline void put_header(std::string &out, char const magic[4], uint8_t flags)
+{
+    out.append(magic, 4);
+    out.push_back(static_cast<char>(ENCODING_VERSION));
+    out.push_back(static_cast<char>(flags));
+}
+
+// bounds checked reader, any read past the end of the buffer leaves the reader in the failed state
+class ByteReader
+{
+public:
+    ByteReader(char const *buffer, std::size_t size)
+        : position(reinterpret_cast<uint8_t const*>(buffer))
+        , end(reinterpret_cast<uint8_t const*>(buffer) + size)
+        , failed(false)
+    {}
+
+    bool ok() const
+    { return !failed; }
+
+    bool at_end() const
+    { return position == end; }
+
+    char const *current() const
+    { return reinterpret_cast<char const*>(position); }
+
+    std::size_t remaining() const
+    { return end - position; }
+
+    uint64_t get_varint()
+    {
+        uint64_t value = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if(position == end)
+            { break; }
+            uint8_t byte = *position++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0)
+            { return value; }
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t get_signed_varint()
+    {
+        uint64_t value = get_varint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    uint8_t get_byte()
+    {
+        if(position == end)
+        {
+            failed = true;
+            return 0;
+        }
+        return *position++;
+    }
+
+    bool get_bytes(std::string &out, uint64_t length)
+    {
+        if(failed || length > static_cast<uint64_t>(end - position))
+        {
+            failed = true;
+            return false;
+        }
+        out.assign(reinterpret_cast<char const*>(position), length);
+        position += length;
+        return true;
+    }
+
+    bool get_string(std::string &out)
+    { return get_bytes(out, get_varint()); }
+
+    bool skip(uint64_t length)
+    {
+        if(failed || length > static_cast<uint64_t>(end - position))
+        {
+            failed = true;
+            return false;
+        }
+        position += length;
+        return true;
+    }
+
+    bool get_header(char const magic[4], uint8_t &flags)
+    {
+        std::string header_magic;
+        if(!get_bytes(header_magic, 4) || std::memcmp(header_magic.data(), magic, 4) != 0
+           || get_byte() != ENCODING_VERSION)
+        {
+            failed = true;
+            return false;
+        }
+        flags = get_byte();
+        return ok();
+    }
+
+private:
+    uint8_t const *position;
+    uint8_t const *end;
+    bool failed;
+};
+
+inline bool has_magic(char const *buffer, std::size_t size, char const magic[4])
+{ return (buffer != nullptr && size >= 6 && std::memcmp(buffer, magic, 4) == 0); }
+
+// header followed by the body, or by the compressed body when that is smaller
+void put_body(std::string &out, char const magic[4], std::string const &body, bool lz_compression)
+{
+    if(lz_compression)
+    {
+        std::string compressed_body;
+        put_varint(compressed_body, body.size());
+        chl::chrono_lz::compress(body.data(), body.size(), compressed_body);
+        if(compressed_body.size() < body.size())
+        {
+            put_header(out, magic, chl::EVENT_BATCH_LZ_COMPRESSED);
+            out.append(compressed_body);
+            return;
+        }
+    }
+    put_header(out, magic, chl::EVENT_BATCH_NO_FLAGS);
+    out.append(body);
+}
+
+// reads the header and leaves the (decompressed) body in body_buffer unless it can be read in place
+bool get_body(ByteReader &reader, char const magic[4], std::string &body_buffer, char const *&body
+              , std::size_t &body_size)
+{
+    uint8_t flags = 0;
+    if(!reader.get_header(magic, flags))
+    { return false; }
+    if(flags == chl::EVENT_BATCH_NO_FLAGS)
+    {
+        body = reader.current();
+        body_size = reader.remaining();
+        return true;
+    }
+    if(flags != chl::EVENT_BATCH_LZ_COMPRESSED)
+    { return false; }
+
+    uint64_t decompressed_size = reader.get_varint();
+    if(!reader.ok() || !chl::chrono_lz::decompress(reader.current(), reader.remaining(), body_buffer
+                                                   , decompressed_size))
+    { return false; }
+    body = body_buffer.data();
+    body_size = body_buffer.size();
+    return true;
+}
+
+// events encoded by EventBatchEncoder, appended to events ; false if they are not well formed,
+// in which case events is left as it was
+bool get_events(ByteReader &reader, chl::StoryId story_id, chl::ClientId client_id, uint64_t event_count
+                , std::vector <chl::LogEvent> &events)
+{
+    // every event takes at least 3 bytes, reject corrupted counts before reserving for them
+    if(!reader.ok() || event_count > reader.remaining() / 3)
+    { return false; }
+
+    std::size_t first_event = events.size();
+    events.reserve(first_event + event_count);
+    chl::chrono_time event_time = 0;
+    int64_t event_index = 0;
+    for(uint64_t i = 0; i < event_count; ++i)
+    {
+        event_time += reader.get_signed_varint();
+        event_index += reader.get_signed_varint();
+        events.emplace_back(story_id, event_time, client_id, static_cast<chl::chrono_index>(event_index)
+                            , std::string());
+        if(!reader.get_string(events.back().logRecord))
+        { break; }
+    }
+    if(!reader.ok())
+    {
+        events.resize(first_event);
+        return false;
+    }
+    return true;
+}
+
+}
+
+/////////////////
+
+chl::EventBatchEncoder::EventBatchEncoder(chl::StoryId const &story_id, chl::ClientId const &client_id
+                                          , bool lz_compression)
+        : storyId(story_id)
+        , clientId(client_id)
+        , lzCompression(lz_compression)
+        , eventCount(0)
+        , payloadSize(0)
+        , lastTime(0)
+        , lastIndex(0)
+{}
+
+void chl::EventBatchEncoder::add_event(chl::chrono_time event_time, chl::chrono_index event_index
+                                       , char const *record, std::size_t record_size)
+{
+    put_signed_varint(encodedEvents, static_cast<int64_t>(event_time - lastTime));
+    put_signed_varint(encodedEvents, static_cast<int64_t>(event_index) - static_cast<int64_t>(lastIndex));
+    put_varint(encodedEvents, record_size);
+    encodedEvents.append(record, record_size);
+    lastTime = event_time;
+    lastIndex = event_index;
+    payloadSize += record_size;
+    ++eventCount;
+}
+
+void chl::EventBatchEncoder::encode(std::string &encoded_batch) const
+{
+    encoded_batch.clear();
+    if(!lzCompression)
+    {
+        encoded_batch.reserve(32 + encodedEvents.size());
+        put_header(encoded_batch, EVENT_BATCH_MAGIC, chl::EVENT_BATCH_NO_FLAGS);
+        put_varint(encoded_batch, storyId);
+        put_varint(encoded_batch, clientId);
+        put_varint(encoded_batch, eventCount);
+        encoded_batch.append(encodedEvents);
+        return;
+    }
+
+    std::string body;
+    body.reserve(32 + encodedEvents.size());
+    put_varint(body, storyId);
+    put_varint(body, clientId);
+    put_varint(body, eventCount);
+    body.append(encodedEvents);
+    put_body(encoded_batch, EVENT_BATCH_MAGIC, body, true);
+}
+
+void chl::EventBatchEncoder::clear()
+{
+    eventCount = 0;
+    payloadSize = 0;
+    lastTime = 0;
+    lastIndex = 0;
+    encodedEvents.clear();
+}
+
+/////////////////
+
+bool chl::is_encoded_event_batch(char const *buffer, std::size_t size)
+{ return has_magic(buffer, size, EVENT_BATCH_MAGIC); }
+
+int chl::decode_event_batch(char const *buffer, std::size_t size, std::vector <chl::LogEvent> &events)
+{
+    ByteReader header_reader(buffer, size);
+    std::string body_buffer;
+    char const *body = nullptr;
+    std::size_t body_size = 0;
+    if(!get_body(header_reader, EVENT_BATCH_MAGIC, body_buffer, body, body_size))
+    { return chl::CL_ERR_INVALID_ARG; }
+
+    ByteReader reader(body, body_size);
+    chl::StoryId story_id = reader.get_varint();
+    chl::ClientId client_id = reader.get_varint();
+    uint64_t event_count = reader.get_varint();
+
+    std::size_t first_event = events.size();
+    if(!get_events(reader, story_id, client_id, event_count, events))
+    { return chl::CL_ERR_INVALID_ARG; }
+    if(!reader.at_end())
+    {
+        events.resize(first_event);
+        return chl::CL_ERR_INVALID_ARG;
+    }
+    return chl::CL_SUCCESS;
+}
+
+/////////////////
+
+void chl::MultiStoryBatchEncoder::add_event(chl::LogEvent const &event, bool lz_compression)
+{
+    auto index_iter = storyBatchIndex.find(event.getStoryId());
+    if(index_iter == storyBatchIndex.end())
+    {
+        index_iter = storyBatchIndex.emplace(event.getStoryId(), storyBatches.size()).first;
+        storyBatches.emplace_back(event.getStoryId(), clientId);
+    }
+    storyBatches[(*index_iter).second].add_event(event);
+    lzCompression = (lzCompression || lz_compression);
+    payloadSize += event.getRecord().size();
+    ++eventCount;
+}
+
+void chl::MultiStoryBatchEncoder::encode(std::string &encoded_batch) const
+{
+    std::string body;
+    body.reserve(32 + payloadSize + 8 * eventCount);
+    put_varint(body, clientId);
+    put_varint(body, storyBatches.size());
+    for(auto const &story_batch: storyBatches)
+    {
+        put_varint(body, story_batch.getStoryId());
+        put_varint(body, story_batch.event_count());
+        put_string(body, story_batch.encoded_events());
+    }
+    encoded_batch.clear();
+    put_body(encoded_batch, MULTI_STORY_BATCH_MAGIC, body, lzCompression);
+}
+
+void chl::MultiStoryBatchEncoder::clear()
+{
+    lzCompression = false;
+    eventCount = 0;
+    payloadSize = 0;
+    storyBatches.clear();
+    storyBatchIndex.clear();
+}
+
+bool chl::is_encoded_multi_story_batch(char const *buffer, std::size_t size)
+{ return has_magic(buffer, size, MULTI_STORY_BATCH_MAGIC); }
+
+int chl::decode_multi_story_batch(char const *buffer, std::size_t size, std::vector <chl::LogEvent> &events)
+{
+    ByteReader header_reader(buffer, size);
+    std::string body_buffer;
+    char const *body = nullptr;
+    std::size_t body_size = 0;
+    if(!get_body(header_reader, MULTI_STORY_BATCH_MAGIC, body_buffer, body, body_size))
+    { return chl::CL_ERR_INVALID_ARG; }
+
+    ByteReader reader(body, body_size);
+    chl::ClientId client_id = reader.get_varint();
+    uint64_t story_count = reader.get_varint();
+    if(!reader.ok() || story_count > body_size)
+    { return chl::CL_ERR_INVALID_ARG; }
+
+    std::size_t first_event = events.size();
+    bool well_formed = true;
+    for(uint64_t i = 0; well_formed && i < story_count; ++i)
+    {
+        chl::StoryId story_id = reader.get_varint();
+        uint64_t event_count = reader.get_varint();
+        uint64_t events_size = reader.get_varint();
+        if(!reader.ok() || events_size > reader.remaining())
+        {
+            well_formed = false;
+            break;
+        }
+        ByteReader story_reader(reader.current(), events_size);
+        well_formed = (get_events(story_reader, story_id, client_id, event_count, events) && story_reader.at_end()
+                       && reader.skip(events_size));
+    }
+    if(!well_formed || !reader.at_end())
+    {
+        events.resize(first_event);
+        return chl::CL_ERR_INVALID_ARG;
+    }
+    return chl::CL_SUCCESS;
+}
+
+/////////////////
+
+bool chl::is_encoded_story_chunk(char const *buffer, std::size_t size)
+{ return has_magic(buffer, size, STORY_CHUNK_MAGIC); }
+
+void chl::encode_story_chunk(chl::StoryChunk const &story_chunk, std::string &encoded_chunk, bool lz_compression)
+{
+    // the chunk events usually come from a handful of clients, send each ClientId once
+    std::map <chl::ClientId, uint64_t> client_slots;
+    for(auto const &event_record: story_chunk)
+    { client_slots.insert(std::pair <chl::ClientId, uint64_t>(event_record.second.getClientId(), client_slots.size())); }
+
+    std::string body;
+    put_string(body, story_chunk.getChronicleName());
+    put_string(body, story_chunk.getStoryName());
+    put_varint(body, story_chunk.getStoryId());
+    put_varint(body, story_chunk.getStartTime());
+    put_varint(body, story_chunk.getEndTime());
+
+    std::vector <chl::ClientId> client_ids(client_slots.size());
+    for(auto const &client_slot: client_slots)
+    { client_ids[client_slot.second] = client_slot.first; }
+    put_varint(body, client_ids.size());
+    for(chl::ClientId client_id: client_ids)
+    { put_varint(body, client_id); }
+
+    put_varint(body, story_chunk.getEventCount());
+    chl::chrono_time last_time = 0;
+    int64_t last_index = 0;
+    for(auto const &event_record: story_chunk)
+    {
+        chl::LogEvent const &event = event_record.second;
+        put_signed_varint(body, static_cast<int64_t>(event.time() - last_time));
+        put_varint(body, client_slots[event.getClientId()]);
+        put_signed_varint(body, static_cast<int64_t>(event.index()) - last_index);
+        put_string(body, event.getRecord());
+        last_time = event.time();
+        last_index = event.index();
+    }
+
+    encoded_chunk.clear();
+    put_body(encoded_chunk, STORY_CHUNK_MAGIC, body, lz_compression);
+}
+
+int chl::decode_story_chunk(char const *buffer, std::size_t size, chl::StoryChunk &story_chunk)
+{
+    ByteReader header_reader(buffer, size);
+    std::string body_buffer;
+    char const *body = nullptr;
+    std::size_t body_size = 0;
+    if(!get_body(header_reader, STORY_CHUNK_MAGIC, body_buffer, body, body_size))
+    { return chl::CL_ERR_INVALID_ARG; }
+
+    ByteReader reader(body, body_size);
+
+    chl::ChronicleName chronicle_name;
+    chl::StoryName story_name;
+    reader.get_string(chronicle_name);
+    reader.get_string(story_name);
+    chl::StoryId story_id = reader.get_varint();
+    uint64_t start_time = reader.get_varint();
+    uint64_t end_time = reader.get_varint();
+
+    uint64_t client_count = reader.get_varint();
+    if(!reader.ok() || client_count > body_size)
+    { return chl::CL_ERR_INVALID_ARG; }
+    std::vector <chl::ClientId> client_ids(client_count);
+    for(auto &client_id: client_ids)
+    { client_id = reader.get_varint(); }
+
+    uint64_t event_count = reader.get_varint();
+    if(!reader.ok())
+    { return chl::CL_ERR_INVALID_ARG; }
+
+    story_chunk = chl::StoryChunk(chronicle_name, story_name, story_id, start_time, end_time);
+    chl::LogEvent event(story_id, 0, 0, 0, std::string());
+    int64_t event_index = 0;
+    for(uint64_t i = 0; i < event_count && reader.ok(); ++i)
+    {
+        event.eventTime += reader.get_signed_varint();
+        uint64_t client_slot = reader.get_varint();
+        event_index += reader.get_signed_varint();
+        if(client_slot >= client_ids.size() || !reader.get_string(event.logRecord))
+        { return chl::CL_ERR_INVALID_ARG; }
+        event.clientId = client_ids[client_slot];
+        event.eventIndex = static_cast<chl::chrono_index>(event_index);
+        story_chunk.insertEvent(std::move(event));
+    }
+    return ((reader.ok() && reader.at_end()) ? chl::CL_SUCCESS : chl::CL_ERR_INVALID_ARG);
+}
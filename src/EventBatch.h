@@ -0,0 +1,181 @@
+#ifndef CHRONOLOG_EVENT_BATCH_H
+#define CHRONOLOG_EVENT_BATCH_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chronolog_types.h"
+
+namespace chronolog
+{
+
+class StoryChunk;
+
+// Compact wire encoding of a batch of events logged by one client to one story
+// and of the StoryChunks sent back by the Player.
+//
+// event batch : magic "CLEB" | version | flags | storyId | clientId | eventCount | events...
+//    event    : zigzag(time - previous time) | zigzag(index - previous index) | record length | record bytes
+// story chunk : magic "CLSC" | version | flags | chronicle | story | storyId | startTime | endTime
+//               | clientCount | clientIds... | eventCount | events...
+//    event    : zigzag(time - previous time) | client slot | zigzag(index - previous index) | record length | record bytes
+// multi story : magic "CLMB" | version | flags | clientId | storyCount | stories...
+//    story    : storyId | eventCount | events length | events...  (events encoded as in the event batch)
+//
+// all the integers are LEB128 varints, strings are length prefixed ; the events of a batch are kept
+// in the order they were added, so out of order timestamps only cost a wider delta.
+// With EVENT_BATCH_LZ_COMPRESSED everything after the flags byte is replaced by
+// the uncompressed length and the chrono_lz block of those bytes.
+
+enum EventBatchFlags
+{
+    EVENT_BATCH_NO_FLAGS = 0,
+    EVENT_BATCH_LZ_COMPRESSED = 1   // body compressed with chrono_lz
+};
+
+// story acquisition attribute requesting compressed event batches and playback chunks for the story
+const char STORY_ATTR_COMPRESSION[] = "compression";
+const char STORY_COMPRESSION_LZ[] = "lz";
+
+inline bool lz_compression_requested(std::map <std::string, std::string> const &story_attrs)
+{
+    auto attr_iter = story_attrs.find(STORY_ATTR_COMPRESSION);
+    return (attr_iter != story_attrs.end() && (*attr_iter).second == STORY_COMPRESSION_LZ);
+}
+
+// story acquisition attribute telling that the story keepers serve the record_event_batch RPC ;
+// without it the events go one by one through record_event, which every ChronoKeeper serves.
+// Compressed batches only exist in the batch encoding, compression implies the batch RPC.
+// With the keeper batchers enabled, the log_events batches of an unreplicated story are staged in the batchers
+// like single events ; those of a replicated or hedged story are sent as they are by the ReplicatedBatchSender,
+// outside the priority lanes and the adaptive batching.
+const char STORY_ATTR_KEEPER_BATCH_RPC[] = "keeper_batch_rpc";
+
+inline bool keeper_batch_rpc_enabled(std::map <std::string, std::string> const &story_attrs)
+{
+    auto attr_iter = story_attrs.find(STORY_ATTR_KEEPER_BATCH_RPC);
+    return ((attr_iter != story_attrs.end() && (*attr_iter).second == "true")
+            || lz_compression_requested(story_attrs));
+}
+
+class EventBatchEncoder
+{
+public:
+    EventBatchEncoder(StoryId const &story_id = 0, ClientId const &client_id = 0, bool lz_compression = false);
+
+    void add_event(chrono_time event_time, chrono_index event_index, char const *record, std::size_t record_size);
+
+    void add_event(chrono_time event_time, chrono_index event_index, std::string const &record)
+    { add_event(event_time, event_index, record.data(), record.size()); }
+
+    void add_event(LogEvent const &event)
+    { add_event(event.time(), event.index(), event.getRecord()); }
+
+    StoryId const &getStoryId() const
+    { return storyId; }
+
+    ClientId const &getClientId() const
+    { return clientId; }
+
+    uint32_t event_count() const
+    { return eventCount; }
+
+    bool empty() const
+    { return (eventCount == 0); }
+
+    // sum of the record sizes added to the batch
+    std::size_t payload_size() const
+    { return payloadSize; }
+
+    // size of the encoded events, without the batch header
+    std::size_t encoded_events_size() const
+    { return encodedEvents.size(); }
+
+    std::string const &encoded_events() const
+    { return encodedEvents; }
+
+    bool compressed() const
+    { return lzCompression; }
+
+    // the complete encoded batch : header followed by the encoded events, compressed if the encoder
+    // was created with lz_compression and compression makes the batch smaller
+    void encode(std::string &encoded_batch) const;
+
+    void clear();
+
+private:
+    StoryId storyId;
+    ClientId clientId;
+    bool lzCompression;
+    uint32_t eventCount;
+    std::size_t payloadSize;
+    chrono_time lastTime;
+    chrono_index lastIndex;
+    std::string encodedEvents;
+};
+
+// appends the decoded events to events ; CL_ERR_INVALID_ARG if the buffer is not a well formed batch
+int decode_event_batch(char const *buffer, std::size_t size, std::vector <LogEvent> &events);
+
+// events of any number of stories logged by one client, sent to one keeper in a single RPC ;
+// the events are grouped by story, keeping the order they were added in within each story
+class MultiStoryBatchEncoder
+{
+public:
+    MultiStoryBatchEncoder(ClientId const &client_id = 0)
+        : clientId(client_id)
+        , lzCompression(false)
+        , eventCount(0)
+        , payloadSize(0)
+    {}
+
+    // the whole batch is compressed as soon as one of its stories asked for compression
+    void add_event(LogEvent const &event, bool lz_compression = false);
+
+    ClientId const &getClientId() const
+    { return clientId; }
+
+    uint32_t event_count() const
+    { return eventCount; }
+
+    std::size_t story_count() const
+    { return storyBatches.size(); }
+
+    bool empty() const
+    { return (eventCount == 0); }
+
+    std::size_t payload_size() const
+    { return payloadSize; }
+
+    void encode(std::string &encoded_batch) const;
+
+    void clear();
+
+private:
+    ClientId clientId;
+    bool lzCompression;
+    uint32_t eventCount;
+    std::size_t payloadSize;
+    std::vector <EventBatchEncoder> storyBatches;
+    std::unordered_map <StoryId, std::size_t> storyBatchIndex;
+};
+
+// appends the decoded events to events ; CL_ERR_INVALID_ARG if the buffer is not a well formed batch
+int decode_multi_story_batch(char const *buffer, std::size_t size, std::vector <LogEvent> &events);
+
+bool is_encoded_multi_story_batch(char const *buffer, std::size_t size);
+
+bool is_encoded_event_batch(char const *buffer, std::size_t size);
+
+void encode_story_chunk(StoryChunk const &story_chunk, std::string &encoded_chunk, bool lz_compression = false);
+
+// replaces the content of story_chunk ; CL_ERR_INVALID_ARG if the buffer is not a well formed chunk
+int decode_story_chunk(char const *buffer, std::size_t size, StoryChunk &story_chunk);
+
+bool is_encoded_story_chunk(char const *buffer, std::size_t size);
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef KEEPER_ACK_TRACKER_H
+#define KEEPER_ACK_TRACKER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+#include "chronolog_errcode.h"
+
+namespace chronolog
+{
+
+// Sequence numbers of the events submitted to one ChronoKeeper and the watermark below which all of them
+// have completed, whether the keeper acknowledged them or the send failed.
+// The sends complete out of order (concurrent RPCs, direct batches next to the keeper batcher), the ranges
+// that complete ahead of the watermark are parked until the gap before them is closed.
+// Failures are counted in errorSeq : a flush reports an error if the count moved since the previous flush
+// of the same caller, so that every failure is reported at least once to every caller that flushes.
+
+class KeeperAckTracker
+{
+public:
+    KeeperAckTracker()
+        : lastAssigned(0)
+        , ackedSeq(0)
+        , errorSeq(0)
+    {}
+
+    // reserves count consecutive sequence numbers, returns the first one
+    uint64_t assign(uint64_t count = 1)
+    {
+        std::lock_guard <std::mutex> lock(trackerMutex);
+        uint64_t first_seq = lastAssigned + 1;
+        lastAssigned += count;
+        return first_seq;
+    }
+
+    void complete(uint64_t first_seq, uint64_t count, bool acknowledged)
+    {
+        if(count == 0)
+        { return; }
+        {
+            std::lock_guard <std::mutex> lock(trackerMutex);
+            if(!acknowledged)
+            { errorSeq += count; }
+            uint64_t last_seq = first_seq + count - 1;
+            if(first_seq != ackedSeq + 1)
+            {
+                completedAhead.emplace(first_seq, last_seq);
+                return;
+            }
+            ackedSeq = last_seq;
+            for(auto range_iter = completedAhead.begin();
+                range_iter != completedAhead.end() && (*range_iter).first == ackedSeq + 1;
+                range_iter = completedAhead.erase(range_iter))
+            { ackedSeq = (*range_iter).second; }
+        }
+        ackCondition.notify_all();
+    }
+
+    uint64_t last_assigned() const
+    {
+        std::lock_guard <std::mutex> lock(trackerMutex);
+        return lastAssigned;
+    }
+
+    uint64_t acknowledged() const
+    {
+        std::lock_guard <std::mutex> lock(trackerMutex);
+        return ackedSeq;
+    }
+
+    uint64_t error_seq() const
+    {
+        std::lock_guard <std::mutex> lock(trackerMutex);
+        return errorSeq;
+    }
+
+    // waits until all the sequences up to seq have completed, CL_ERR_TIMEOUT if the deadline passes first
+    int wait(uint64_t seq, std::chrono::steady_clock::time_point const &deadline)
+    {
+        std::unique_lock <std::mutex> lock(trackerMutex);
+        if(deadline == std::chrono::steady_clock::time_point::max())
+        {
+            ackCondition.wait(lock, [this, seq]()
+            { return (ackedSeq >= seq); });
+            return CL_SUCCESS;
+        }
+        return (ackCondition.wait_until(lock, deadline, [this, seq]()
+        { return (ackedSeq >= seq); }) ? CL_SUCCESS : CL_ERR_TIMEOUT);
+    }
+
+private:
+    KeeperAckTracker(KeeperAckTracker const &) = delete;
+    KeeperAckTracker &operator=(KeeperAckTracker const &) = delete;
+
+    mutable std::mutex trackerMutex;
+    std::condition_variable ackCondition;
+    uint64_t lastAssigned;
+    uint64_t ackedSeq;
+    uint64_t errorSeq;
+    std::map <uint64_t, uint64_t> completedAhead;   // first -> last sequence of the ranges completed ahead
+};
+
+}
+
+#endif
@@ -0,0 +1,298 @@
+#include "chronolog_errcode.h"
+#include "chrono_monitor.h"
+#include "KeeperEventBatcher.h"
+#include "KeeperRecordingClient.h"
+
+namespace chl = chronolog;
+
+namespace
+{
+char const *const PRIORITY_NAMES[chl::PRIORITY_LANE_COUNT] = {"high", "normal", "low"};
+}
+
+chl::KeeperEventBatcher::KeeperEventBatcher(chl::KeeperRecordingClient &keeper_client, chl::ClientId const &client_id
+                                            , chl::ClientRecordingConf const &recording_conf
+                                            , std::string const &metrics_labels, chl::MemoryBudget *memory_budget)
+        : keeperClient(keeper_client)
+        , recordingConf(recording_conf)
+        , batchController(recording_conf)
+        , sendingBatch(client_id)
+        , sendingBytes(0)
+        , flushRequests(0)
+        , completedFlushes(0)
+        , stopping(false)
+        , memoryBudget(memory_budget)
+        , reclaimerId(0)
+        , pendingEvents(chl::chrono_metrics::getInstance().gauge("chronolog_keeper_batch_pending_events", metrics_labels))
+        , batchEvents(chl::chrono_metrics::getInstance().histogram("chronolog_keeper_batch_events", metrics_labels))
+        , targetBatchEvents(chl::chrono_metrics::getInstance().gauge("chronolog_keeper_batch_target_events"
+                                                                     , metrics_labels))
+        , lingerTime(chl::chrono_metrics::getInstance().gauge("chronolog_keeper_batch_linger_us", metrics_labels))
+        , arrivalRate(chl::chrono_metrics::getInstance().gauge("chronolog_keeper_batch_arrival_rate", metrics_labels))
+        , droppedEvents(chl::chrono_metrics::getInstance().counter("chronolog_keeper_batch_dropped_events_total"
+                                                                   , metrics_labels))
+        , shedEvents(chl::chrono_metrics::getInstance().counter("chronolog_keeper_batch_shed_events_total"
+                                                                , metrics_labels))
+{
+    uint32_t lane_weights[PRIORITY_LANE_COUNT] = {recordingConf.high_priority_weight()
+                                                  , recordingConf.normal_priority_weight()
+                                                  , recordingConf.low_priority_weight()};
+    lanes.reserve(PRIORITY_LANE_COUNT);
+    for(std::size_t i = 0; i < PRIORITY_LANE_COUNT; ++i)
+    {
+        std::string lane_labels = metrics_labels + ",priority=\"" + PRIORITY_NAMES[i] + "\"";
+        lanes.emplace_back(client_id, lane_weights[i]
+                           , chl::chrono_metrics::getInstance().histogram("chronolog_keeper_batch_event_delay_ns"
+                                                                          , lane_labels));
+    }
+
+    targetBatchEvents.set(batchController.batch_events());
+    lingerTime.set(batchController.linger_us());
+    flusherThread = std::thread(&KeeperEventBatcher::run_flusher, this);
+    if(memoryBudget != nullptr)
+    { reclaimerId = memoryBudget->add_reclaimer([this]() { request_flush(); }); }
+    LOG_DEBUG("[KeeperEventBatcher] Started, max_batch_events {} max_batch_bytes {} max_batch_delay_us {} adaptive {}"
+              " lane weights {}/{}/{}", recordingConf.max_batch_events(), recordingConf.max_batch_bytes()
+              , recordingConf.max_batch_delay_us(), recordingConf.adaptive_batching(), lane_weights[PRIORITY_HIGH]
+              , lane_weights[PRIORITY_NORMAL], lane_weights[PRIORITY_LOW]);
+}
+
+chl::KeeperEventBatcher::~KeeperEventBatcher()
+{
+    if(memoryBudget != nullptr)
+    { memoryBudget->remove_reclaimer(reclaimerId); }
+    {
+        std::lock_guard <std::mutex> lock(batchMutex);
+        stopping = true;
+    }
+    flusherCondition.notify_all();
+    writerCondition.notify_all();
+    if(flusherThread.joinable())
+    { flusherThread.join(); }
+    LOG_DEBUG("[KeeperEventBatcher] Stopped");
+}
+
+int chl::KeeperEventBatcher::enqueue_event(chl::LogEvent const &event, bool lz_compression
+                                           , chl::EventPriority priority)
+{
+    // charged before the batch mutex is taken, the memory reclaimers take it
+    std::size_t event_bytes = event.getRecord().size() + STAGED_EVENT_OVERHEAD;
+    if(memoryBudget != nullptr)
+    {
+        if(priority == PRIORITY_LOW && !memoryBudget->try_acquire(event_bytes, chl::MEMORY_STAGING))
+        {
+            shedEvents.add(1);
+            return chl::CL_ERR_EVENT_SHED;
+        }
+        if(priority != PRIORITY_LOW && !memoryBudget->acquire(event_bytes, chl::MEMORY_STAGING))
+        { return chl::CL_ERR_NO_MEMORY; }
+    }
+
+    std::unique_lock <std::mutex> lock(batchMutex);
+    BatchLane &lane = lanes[priority < PRIORITY_LANE_COUNT ? priority : PRIORITY_NORMAL];
+    if(priority == PRIORITY_LOW)
+    {
+        // low priority traffic is shed first : it never waits behind a backlog
+        if(!stopping && (batch_full(lane) || batch_full(lanes[PRIORITY_HIGH]) || batch_full(lanes[PRIORITY_NORMAL])))
+        {
+            lock.unlock();
+            release_memory(event_bytes);
+            shedEvents.add(1);
+            return chl::CL_ERR_EVENT_SHED;
+        }
+    }
+    else
+    {
+        // backpressure : a full batch waits here while the previous one is being sent
+        writerCondition.wait(lock, [this, &lane]()
+        { return (stopping || !batch_full(lane)); });
+    }
+    if(stopping)
+    {
+        lock.unlock();
+        release_memory(event_bytes);
+        return chl::CL_ERR_UNKNOWN;
+    }
+
+    if(lane.pendingBatch.empty())
+    { lane.pendingSince = std::chrono::steady_clock::now(); }
+    lane.pendingBatch.add_event(event, lz_compression);
+    lane.pendingBytes += event_bytes;
+    pendingEvents.add(1);
+    uint64_t seq = keeperClient.ack_tracker().assign(1);
+    if(!lane.pendingSeqs.empty() && lane.pendingSeqs.back().first + lane.pendingSeqs.back().second == seq)
+    { lane.pendingSeqs.back().second++; }
+    else
+    { lane.pendingSeqs.emplace_back(seq, 1); }
+
+    // the flusher starts its batch delay on the first event and sends early when the batch is full
+    if(lane.pendingBatch.event_count() == 1 || batch_full(lane))
+    { flusherCondition.notify_one(); }
+    return chl::CL_SUCCESS;
+}
+
+void chl::KeeperEventBatcher::request_flush()
+{
+    {
+        std::lock_guard <std::mutex> lock(batchMutex);
+        ++flushRequests;
+    }
+    flusherCondition.notify_one();
+}
+
+uint64_t chl::KeeperEventBatcher::discard_pending()
+{
+    uint64_t discarded_events = 0;
+    std::size_t discarded_bytes = 0;
+    std::vector <std::pair <uint64_t, uint64_t>> discarded_seqs;
+    {
+        std::lock_guard <std::mutex> lock(batchMutex);
+        for(BatchLane &lane: lanes)
+        {
+            discarded_events += lane.pendingBatch.event_count();
+            discarded_bytes += lane.pendingBytes;
+            discarded_seqs.insert(discarded_seqs.end(), lane.pendingSeqs.begin(), lane.pendingSeqs.end());
+            lane.pendingBatch.clear();
+            lane.pendingSeqs.clear();
+            lane.pendingBytes = 0;
+        }
+        pendingEvents.sub(static_cast<int64_t>(discarded_events));
+    }
+    writerCondition.notify_all();
+    flusherCondition.notify_one();
+
+    for(auto const &seq_range: discarded_seqs)
+    { keeperClient.ack_tracker().complete(seq_range.first, seq_range.second, false); }
+    release_memory(discarded_bytes);
+    droppedEvents.add(discarded_events);
+    if(discarded_events > 0)
+    { LOG_WARNING("[KeeperEventBatcher] Discarded {} pending events", discarded_events); }
+    return discarded_events;
+}
+
+bool chl::KeeperEventBatcher::lane_ready(std::size_t lane_index
+                                         , std::chrono::steady_clock::time_point const &now) const
+{
+    BatchLane const &lane = lanes[lane_index];
+    if(lane.pendingBatch.empty())
+    { return false; }
+    return (lane_index == PRIORITY_HIGH || stopping || flushRequests > completedFlushes || batch_full(lane)
+            || batchController.send_time(lane.pendingSince) <= now);
+}
+
+bool chl::KeeperEventBatcher::any_lane_ready(std::chrono::steady_clock::time_point const &now) const
+{
+    for(std::size_t i = 0; i < PRIORITY_LANE_COUNT; ++i)
+    {
+        if(lane_ready(i, now))
+        { return true; }
+    }
+    return false;
+}
+
+std::size_t chl::KeeperEventBatcher::choose_lane(std::chrono::steady_clock::time_point const &now)
+{
+    std::size_t chosen = PRIORITY_LANE_COUNT;
+    int64_t total_weight = 0;
+    for(std::size_t i = 0; i < PRIORITY_LANE_COUNT; ++i)
+    {
+        if(!lane_ready(i, now))
+        { continue; }
+        lanes[i].credit += lanes[i].weight;
+        total_weight += lanes[i].weight;
+        if(chosen == PRIORITY_LANE_COUNT || lanes[i].credit > lanes[chosen].credit)
+        { chosen = i; }
+    }
+    if(chosen != PRIORITY_LANE_COUNT)
+    { lanes[chosen].credit -= total_weight; }
+    return chosen;
+}
+
+bool chl::KeeperEventBatcher::lanes_empty() const
+{
+    for(BatchLane const &lane: lanes)
+    {
+        if(!lane.pendingBatch.empty())
+        { return false; }
+    }
+    return true;
+}
+
+void chl::KeeperEventBatcher::run_flusher()
+{
+    std::unique_lock <std::mutex> lock(batchMutex);
+    while(true)
+    {
+        flusherCondition.wait(lock, [this]()
+        { return (stopping || !lanes_empty() || flushRequests > completedFlushes); });
+
+        if(lanes_empty())
+        {
+            if(stopping)
+            { break; }
+            // nothing left to send for the flush requests
+            completedFlushes = flushRequests;
+            continue;
+        }
+
+        std::size_t lane_index = choose_lane(std::chrono::steady_clock::now());
+        if(lane_index == PRIORITY_LANE_COUNT)
+        {
+            // linger for more events until a lane is full or the delay of its first event expires
+            std::chrono::steady_clock::time_point send_time = std::chrono::steady_clock::time_point::max();
+            for(BatchLane const &lane: lanes)
+            {
+                if(!lane.pendingBatch.empty())
+                { send_time = std::min(send_time, batchController.send_time(lane.pendingSince)); }
+            }
+            flusherCondition.wait_until(lock, send_time, [this]()
+            { return any_lane_ready(std::chrono::steady_clock::now()); });
+            continue;
+        }
+
+        BatchLane &lane = lanes[lane_index];
+        uint64_t flush_request = flushRequests;
+        std::chrono::steady_clock::time_point batch_since = lane.pendingSince;
+        std::swap(lane.pendingBatch, sendingBatch);
+        std::swap(lane.pendingSeqs, sendingSeqs);
+        sendingBytes = lane.pendingBytes;
+        lane.pendingBytes = 0;
+        // the flush requests are served once the lanes they found pending were all sent
+        bool flush_served = lanes_empty();
+        pendingEvents.sub(sendingBatch.event_count());
+        writerCondition.notify_all();
+        lock.unlock();
+
+        uint32_t sent_events = sendingBatch.event_count();
+        batchEvents.record(sent_events);
+        std::chrono::steady_clock::time_point send_start = std::chrono::steady_clock::now();
+        int return_code = keeperClient.send_multi_story_batch(sendingBatch);
+        std::chrono::steady_clock::time_point send_end = std::chrono::steady_clock::now();
+        if(return_code != chl::CL_SUCCESS)
+        {
+            droppedEvents.add(sendingBatch.event_count());
+            LOG_ERROR("[KeeperEventBatcher] Failed to send a {} priority batch of {} events from {} stories, error {}"
+                      , PRIORITY_NAMES[lane_index], sendingBatch.event_count(), sendingBatch.story_count()
+                      , return_code);
+        }
+        for(auto const &seq_range: sendingSeqs)
+        { keeperClient.ack_tracker().complete(seq_range.first, seq_range.second, return_code == chl::CL_SUCCESS); }
+        sendingBatch.clear();
+        sendingSeqs.clear();
+        release_memory(sendingBytes);
+
+        lock.lock();
+        uint64_t event_delay_ns = std::chrono::duration_cast <std::chrono::nanoseconds>(send_end - batch_since).count();
+        lane.eventDelay->record(event_delay_ns);
+        batchController.batch_sent(sent_events, event_delay_ns / 1000
+                                   , std::chrono::duration_cast <std::chrono::microseconds>(
+                                           send_end - send_start).count(), send_start);
+        targetBatchEvents.set(batchController.batch_events());
+        lingerTime.set(batchController.linger_us());
+        arrivalRate.set(static_cast<int64_t>(batchController.arrival_rate()));
+        if(flush_served)
+        { completedFlushes = flush_request; }
+        // the batch target may have grown past the size the writers are waiting on
+        writerCondition.notify_all();
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef KEEPER_EVENT_BATCHER_H
+#define KEEPER_EVENT_BATCHER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chronolog_types.h"
+#include "ClientConfiguration.h"
+#include "EventBatch.h"
+#include "AdaptiveBatchController.h"
+#include "chrono_metrics.h"
+#include "MemoryBudget.h"
+
+namespace chronolog
+{
+
+class KeeperRecordingClient;
+
+// story acquisition attribute : "high", "normal" (default) or "low" priority of the story events
+const char STORY_ATTR_PRIORITY[] = "priority";
+
+enum EventPriority
+{
+    PRIORITY_HIGH = 0, PRIORITY_NORMAL = 1, PRIORITY_LOW = 2
+};
+
+constexpr std::size_t PRIORITY_LANE_COUNT = 3;
+
+inline EventPriority story_priority(std::map <std::string, std::string> const &story_attrs)
+{
+    auto attr_iter = story_attrs.find(STORY_ATTR_PRIORITY);
+    if(attr_iter == story_attrs.end())
+    { return PRIORITY_NORMAL; }
+    if((*attr_iter).second == "high")
+    { return PRIORITY_HIGH; }
+    return ((*attr_iter).second == "low" ? PRIORITY_LOW : PRIORITY_NORMAL);
+}
+
+// Coalesces the events of all the stories recorded on one ChronoKeeper into multi-story batches
+// and sends them from its own flusher thread, so that the number of RPCs depends on the event
+// rate towards the keeper and not on the number of stories.
+// A batch is sent once it is full or its linger time after its first event, both decided by the
+// AdaptiveBatchController ; the writers only block when a full batch is waiting behind the one being sent.
+// Every priority has its own lane of pending batches :
+// - a high priority batch is ready as soon as it holds an event, it does not linger;
+// - when several lanes are ready the flusher picks them by smooth weighted round robin on the lane weights,
+//   so the high lane gets most of the sends without starving the others;
+// - low priority events are shed instead of waiting when their batch is full or another lane is backlogged.
+// The staged events are charged to the client memory budget until their batch is sent, and the batcher
+// sends all its lanes early when the budget asks for memory to be reclaimed.
+
+class KeeperEventBatcher
+{
+public:
+    KeeperEventBatcher(KeeperRecordingClient &keeper_client, ClientId const &client_id
+                       , ClientRecordingConf const &recording_conf, std::string const &metrics_labels
+                       , MemoryBudget *memory_budget = nullptr);
+
+    ~KeeperEventBatcher();
+
+    // CL_ERR_EVENT_SHED if a low priority event was dropped under overload,
+    // CL_ERR_NO_MEMORY if the memory budget had no room for the event in time
+    int enqueue_event(LogEvent const &event, bool lz_compression, EventPriority priority = PRIORITY_NORMAL);
+
+    // sends whatever is pending without waiting for the linger time,
+    // the completion is tracked by the KeeperAckTracker of the keeper client
+    void request_flush();
+
+    // drops the events still pending in the lanes, their sequences complete as failed ;
+    // returns the number of events dropped, the batch being sent is not affected
+    uint64_t discard_pending();
+
+private:
+    KeeperEventBatcher(KeeperEventBatcher const &) = delete;
+    KeeperEventBatcher &operator=(KeeperEventBatcher const &) = delete;
+
+    struct BatchLane
+    {
+        BatchLane(ClientId const &client_id, uint32_t lane_weight, LatencyHistogram &event_delay)
+            : pendingBatch(client_id)
+            , pendingBytes(0)
+            , weight(std::max <uint32_t>(1, lane_weight))
+            , credit(0)
+            , eventDelay(&event_delay)
+        {}
+
+        MultiStoryBatchEncoder pendingBatch;
+        std::vector <std::pair <uint64_t, uint64_t>> pendingSeqs;   // first sequence, count
+        std::chrono::steady_clock::time_point pendingSince;
+        std::size_t pendingBytes;   // charged to the memory budget
+        int64_t weight;
+        int64_t credit;   // smooth weighted round robin state
+        LatencyHistogram *eventDelay;
+    };
+
+    bool batch_full(BatchLane const &lane) const
+    {
+        return (lane.pendingBatch.event_count() >= batchController.batch_events()
+                || lane.pendingBatch.payload_size() >= recordingConf.max_batch_bytes());
+    }
+
+    bool lane_ready(std::size_t lane_index, std::chrono::steady_clock::time_point const &now) const;
+
+    bool any_lane_ready(std::chrono::steady_clock::time_point const &now) const;
+
+    // the ready lane to send next, PRIORITY_LANE_COUNT if none is ready
+    std::size_t choose_lane(std::chrono::steady_clock::time_point const &now);
+
+    bool lanes_empty() const;
+
+    void release_memory(std::size_t bytes)
+    {
+        if(memoryBudget != nullptr)
+        { memoryBudget->release(bytes, MEMORY_STAGING); }
+    }
+
+    // encoded event time and index of a staged event, on top of its record
+    static constexpr std::size_t STAGED_EVENT_OVERHEAD = 8;
+
+    void run_flusher();
+
+    KeeperRecordingClient &keeperClient;
+    ClientRecordingConf recordingConf;
+    AdaptiveBatchController batchController;
+
+    std::mutex batchMutex;
+    std::condition_variable flusherCondition;
+    std::condition_variable writerCondition;
+    std::vector <BatchLane> lanes;   // indexed by EventPriority
+    MultiStoryBatchEncoder sendingBatch;
+    std::vector <std::pair <uint64_t, uint64_t>> sendingSeqs;
+    std::size_t sendingBytes;
+    uint64_t flushRequests;
+    uint64_t completedFlushes;
+    bool stopping;
+    MemoryBudget *memoryBudget;   // nullptr if the memory is not accounted
+    uint64_t reclaimerId;
+
+    Gauge &pendingEvents;
+    LatencyHistogram &batchEvents;
+    Gauge &targetBatchEvents;
+    Gauge &lingerTime;
+    Gauge &arrivalRate;
+    ShardedCounter &droppedEvents;
+    ShardedCounter &shedEvents;
+
+    std::thread flusherThread;
+};
+
+}
+
+#endif
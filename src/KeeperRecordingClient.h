@@ -1,6 +1,7 @@
 #ifndef KEEPER_RECORDING_CLIENT_H
 #define KEEPER_RECORDING_CLIENT_H
 
+#include <atomic>
 #include <iostream>
 #include <thallium.hpp>
 #include <thallium/serialization/stl/string.hpp>
@@ -8,6 +9,12 @@
 #include "chronolog_types.h"
 #include "KeeperIdCard.h"
 #include "chronolog_errcode.h"
+#include "chrono_metrics.h"
+#include "EventBatch.h"
+#include "ClientConfiguration.h"
+#include "KeeperEventBatcher.h"
+#include "KeeperAckTracker.h"
+#include "TimedRpc.h"
 
 namespace tl = thallium;
 
@@ -21,11 +28,12 @@ class KeeperRecordingClient
 
 public:
     static KeeperRecordingClient*
-    CreateKeeperRecordingClient(tl::engine &tl_engine, KeeperIdCard const &keeper_id_card)
+    CreateKeeperRecordingClient(tl::engine &tl_engine, KeeperIdCard const &keeper_id_card, uint32_t rpc_timeout_ms = 0
+                                , std::string const &instance_labels = std::string())
     {
         try
         {
-            return new KeeperRecordingClient(tl_engine, keeper_id_card);
+            return new KeeperRecordingClient(tl_engine, keeper_id_card, rpc_timeout_ms, instance_labels);
         }
         catch(tl::exception const & ex)
         {
@@ -36,40 +44,242 @@ public:
 
     int send_event_msg(LogEvent const &eventMsg)
     {
+        uint64_t seq = ackTracker.assign(1);
+        inFlightSends.add(1);
+        uint64_t send_start = metrics_now_ns();
         try
         {
             //std::stringstream ss;
             //ss << eventMsg;
             //LOG_TRACE("[KeeperRecordingClient] Sending event message: {}", ss.str());
-            int return_code = record_event.on(service_ph)(eventMsg);
+            int return_code = timed_call(record_event.on(service_ph), rpcTimeout, eventMsg);
             //LOG_TRACE("[KeeperRecordingClient] Sent event message: {} with return code: {}", ss.str(), return_code);
+            sendLatency.record(metrics_now_ns() - send_start);
+            inFlightSends.sub(1);
+            eventsSent.add(1);
+            bytesSent.add(LOG_EVENT_HEADER_SIZE + eventMsg.getRecord().size());
+            ackTracker.complete(seq, 1, return_code == chronolog::CL_SUCCESS);
             return return_code;
         }
         catch(thallium::exception const & ex)
         {
             LOG_ERROR("[KeeperRecordingClient] Failed to send event message to {} exception: {}", to_string(keeperIdCard), ex.what());
         }
+        inFlightSends.sub(1);
+        sendFailures.add(1);
+        ackTracker.complete(seq, 1, false);
         return (chronolog::CL_ERR_UNKNOWN);
     }
 
+    // send the events of the batch in a single record_event_batch RPC using the compact batch encoding
+    int send_event_batch(EventBatchEncoder const &eventBatch)
+    {
+        if(eventBatch.empty())
+        { return chronolog::CL_SUCCESS; }
+
+        uint64_t first_seq = ackTracker.assign(eventBatch.event_count());
+        inFlightSends.add(1);
+        uint64_t send_start = metrics_now_ns();
+        try
+        {
+            std::string encoded_batch;
+            eventBatch.encode(encoded_batch);
+            int return_code = timed_call(record_event_batch.on(service_ph), rpcTimeout, encoded_batch);
+            sendLatency.record(metrics_now_ns() - send_start);
+            inFlightSends.sub(1);
+            eventsSent.add(eventBatch.event_count());
+            bytesSent.add(encoded_batch.size());
+            ackTracker.complete(first_seq, eventBatch.event_count(), return_code == chronolog::CL_SUCCESS);
+            return return_code;
+        }
+        catch(thallium::exception const & ex)
+        {
+            LOG_ERROR("[KeeperRecordingClient] Failed to send event batch of {} events to {} exception: {}"
+                      , eventBatch.event_count(), to_string(keeperIdCard), ex.what());
+        }
+        inFlightSends.sub(1);
+        sendFailures.add(1);
+        ackTracker.complete(first_seq, eventBatch.event_count(), false);
+        return (chronolog::CL_ERR_UNKNOWN);
+    }
+
+    // issues the record_event_batch RPC without waiting for the keeper response, the caller completes it
+    // with complete_event_batch_async ; throws tl::exception if the RPC can not be issued
+    tl::async_response send_event_batch_async(std::string const &encoded_batch)
+    {
+        tl::async_response response = timed_async_call(record_event_batch.on(service_ph), rpcTimeout, encoded_batch);
+        inFlightSends.add(1);
+        return response;
+    }
+
+    // waits for the response of send_event_batch_async, send_start is the metrics_now_ns() of the send
+    int complete_event_batch_async(tl::async_response &response, uint32_t event_count, std::size_t batch_size
+                                   , uint64_t send_start)
+    {
+        int return_code = chronolog::CL_ERR_UNKNOWN;
+        try
+        {
+            return_code = response.wait();
+            sendLatency.record(metrics_now_ns() - send_start);
+            eventsSent.add(event_count);
+            bytesSent.add(batch_size);
+        }
+        catch(thallium::exception const & ex)
+        {
+            LOG_ERROR("[KeeperRecordingClient] Failed to send event batch of {} events to {} exception: {}"
+                      , event_count, to_string(keeperIdCard), ex.what());
+            sendFailures.add(1);
+        }
+        inFlightSends.sub(1);
+        return return_code;
+    }
+
+    // send the events of several stories in a single record_multi_story_batch RPC,
+    // the KeeperEventBatcher tracks the acknowledgement of the events it queued
+    int send_multi_story_batch(MultiStoryBatchEncoder const &storyBatches)
+    {
+        if(storyBatches.empty())
+        { return chronolog::CL_SUCCESS; }
+
+        inFlightSends.add(1);
+        uint64_t send_start = metrics_now_ns();
+        try
+        {
+            std::string encoded_batch;
+            storyBatches.encode(encoded_batch);
+            int return_code = timed_call(record_multi_story_batch.on(service_ph), rpcTimeout, encoded_batch);
+            sendLatency.record(metrics_now_ns() - send_start);
+            inFlightSends.sub(1);
+            eventsSent.add(storyBatches.event_count());
+            bytesSent.add(encoded_batch.size());
+            return return_code;
+        }
+        catch(thallium::exception const & ex)
+        {
+            LOG_ERROR("[KeeperRecordingClient] Failed to send multi story batch of {} events to {} exception: {}"
+                      , storyBatches.event_count(), to_string(keeperIdCard), ex.what());
+        }
+        inFlightSends.sub(1);
+        sendFailures.add(1);
+        return (chronolog::CL_ERR_UNKNOWN);
+    }
+
+    // from now on the events submitted to this keeper are coalesced into multi story batches
+    void enable_batching(ClientId const &client_id, ClientRecordingConf const &recording_conf
+                         , MemoryBudget *memory_budget = nullptr)
+    {
+        if(eventBatcher != nullptr)
+        { return; }
+        eventBatcher = new KeeperEventBatcher(*this, client_id, recording_conf, metricsLabels, memory_budget);
+    }
+
+    bool batching_enabled() const
+    { return (eventBatcher != nullptr); }
+
+    // the event is sent right away or queued in its priority lane for the next batch if batching is enabled
+    int submit_event(LogEvent const &eventMsg, bool lz_compression, EventPriority priority = PRIORITY_NORMAL)
+    {
+        if(eventBatcher != nullptr)
+        { return eventBatcher->enqueue_event(eventMsg, lz_compression, priority); }
+        return send_event_msg(eventMsg);
+    }
+
+    // waits until the events submitted up to sequence seq completed, a pending keeper batch is sent right away
+    int flush(uint64_t seq, std::chrono::steady_clock::time_point const &deadline)
+    {
+        if(eventBatcher != nullptr && ackTracker.acknowledged() < seq)
+        { eventBatcher->request_flush(); }
+        return ackTracker.wait(seq, deadline);
+    }
+
+    // sends the pending keeper batches right away without waiting for them
+    void request_flush()
+    {
+        if(eventBatcher != nullptr)
+        { eventBatcher->request_flush(); }
+    }
+
+    // drops the events still waiting in the keeper batcher, returns their number
+    uint64_t discard_pending()
+    { return (eventBatcher != nullptr ? eventBatcher->discard_pending() : 0); }
+
+    KeeperAckTracker &ack_tracker()
+    { return ackTracker; }
+
+    // send latency percentile a batch is given before it is hedged to another keeper,
+    // 0 until enough sends were observed; refreshed every HEDGE_DELAY_REFRESH sends
+    uint64_t hedge_delay_ns(double percentile)
+    {
+        uint64_t send_count = sendLatency.count();
+        if(send_count < HEDGE_DELAY_REFRESH)
+        { return 0; }
+        if(send_count >= hedgeDelayCount.load(std::memory_order_relaxed) + HEDGE_DELAY_REFRESH)
+        {
+            hedgeDelayCount.store(send_count, std::memory_order_relaxed);
+            hedgeDelay.store(sendLatency.percentile(percentile), std::memory_order_relaxed);
+        }
+        return hedgeDelay.load(std::memory_order_relaxed);
+    }
+
     KeeperIdCard const & getKeeperId() const
     { return keeperIdCard; }
 
     ~KeeperRecordingClient()
     {
+        // the batcher sends the pending events before the rpcs are deregistered
+        delete eventBatcher;
         record_event.deregister();
+        record_event_batch.deregister();
+        record_multi_story_batch.deregister();
         LOG_DEBUG("[KeeperRecordingClient] Destructor called {}", to_string(keeperIdCard));
     }
 
 private:
 
+    // storyId, eventTime, clientId, eventIndex and the record length prefix
+    static constexpr std::size_t LOG_EVENT_HEADER_SIZE = 8 + 8 + 8 + 4 + 8;
+    static constexpr uint64_t HEDGE_DELAY_REFRESH = 64;
+
     KeeperIdCard keeperIdCard;
     tl::provider_handle service_ph;  //provider_handle for remote registry service
     tl::remote_procedure record_event;
+    tl::remote_procedure record_event_batch;
+    tl::remote_procedure record_multi_story_batch;
+    std::chrono::milliseconds rpcTimeout;   // 0 for no deadline
+    KeeperAckTracker ackTracker;
+    KeeperEventBatcher *eventBatcher;
+
+    // per keeper metrics, looked up once so that the send path never touches the registry
+    std::string metricsLabels;
+    LatencyHistogram & sendLatency;
+    ShardedCounter & eventsSent;
+    ShardedCounter & bytesSent;
+    ShardedCounter & sendFailures;
+    Gauge & inFlightSends;
+    std::atomic <uint64_t> hedgeDelay{0};
+    std::atomic <uint64_t> hedgeDelayCount{0};   // send count the hedge delay was computed at
+
+    // the keeper label after the instance label of the client the keeper client belongs to
+    static std::string metrics_labels(KeeperIdCard const &keeper_id_card, std::string const &instance_labels)
+    {
+        std::string ip_string;
+        return join_metrics_labels(instance_labels, "keeper=\""
+                                   + keeper_id_card.getRecordingServiceId().get_ip_as_dotted_string(ip_string) + ":"
+                                   + std::to_string(keeper_id_card.getRecordingServiceId().getPort()) + "\"");
+    }
 
     // constructor is private to make sure thalium rpc objects are created on the heap, not stack
-    KeeperRecordingClient(tl::engine &tl_engine, KeeperIdCard const &keeper_id_card)
+    KeeperRecordingClient(tl::engine &tl_engine, KeeperIdCard const &keeper_id_card, uint32_t rpc_timeout_ms
+                          , std::string const &instance_labels)
         : keeperIdCard(keeper_id_card)
+        , rpcTimeout(rpc_timeout_ms)
+        , eventBatcher(nullptr)
+        , metricsLabels(metrics_labels(keeper_id_card, instance_labels))
+        , sendLatency(chrono_metrics::getInstance().histogram("chronolog_keeper_send_latency_ns", metricsLabels))
+        , eventsSent(chrono_metrics::getInstance().counter("chronolog_keeper_events_sent_total", metricsLabels))
+        , bytesSent(chrono_metrics::getInstance().counter("chronolog_keeper_bytes_sent_total", metricsLabels))
+        , sendFailures(chrono_metrics::getInstance().counter("chronolog_keeper_send_failures_total", metricsLabels))
+        , inFlightSends(chrono_metrics::getInstance().gauge("chronolog_keeper_send_queue_depth", metricsLabels))
     {
         LOG_DEBUG("[KeeperRecordingClient] KeeperRecordingiClient Constructor for {}",to_string(keeper_id_card));
         std::string service_addr_string;
@@ -78,6 +288,8 @@ private:
         service_ph = tl::provider_handle(tl_engine.lookup(service_addr_string), keeper_id_card.getRecordingServiceId().getProviderId());
 
         record_event = tl_engine.define("record_event");
+        record_event_batch = tl_engine.define("record_event_batch");
+        record_multi_story_batch = tl_engine.define("record_multi_story_batch");
     }
 
 
@@ -0,0 +1,205 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include "ClientConfiguration.h"
+#include "chrono_metrics.h"
+
+namespace chronolog
+{
+
+enum MemoryUse
+{
+    MEMORY_STAGING = 0,     // events waiting in the keeper batches
+    MEMORY_IN_FLIGHT = 1,   // event batches being sent by the writers
+    MEMORY_PLAYBACK = 2,    // StoryChunks received for the playback queries
+    MEMORY_USE_COUNT = 3
+};
+
+// Client wide accountant of the bytes held by the SDK buffers, shared by the recording and the playback paths.
+// Every buffer is charged before it is filled and released once it is sent or handed over to the application.
+// Crossing the reclaim threshold runs the reclaimers, which release memory early (the keeper batchers send
+// their staged events) ; at the cap acquire waits for releases until its deadline, try_acquire fails right away.
+// A single charge larger than the whole cap goes through when nothing else is held, so it can not wait forever.
+// Without a cap the usage is only counted and reported.
+
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(ClientMemoryConf const &memory_conf, std::string const &metrics_labels = std::string())
+        : maxBytes(memory_conf.max_memory_bytes())
+        , reclaimBytes(memory_conf.max_memory_bytes() / 100 * std::min <uint32_t>(100, memory_conf.reclaim_percent()))
+        , waitTime(memory_conf.memory_wait_ms())
+        , usedBytes(0)
+        , usedByUse{}
+        , waiters(0)
+        , reclaiming(false)
+        , nextReclaimerId(0)
+        , usedGauge{&chrono_metrics::getInstance().gauge("chronolog_client_memory_bytes"
+                                                         , join_metrics_labels(metrics_labels, "use=\"staging\""))
+                    , &chrono_metrics::getInstance().gauge("chronolog_client_memory_bytes"
+                                                           , join_metrics_labels(metrics_labels, "use=\"in_flight\""))
+                    , &chrono_metrics::getInstance().gauge("chronolog_client_memory_bytes"
+                                                           , join_metrics_labels(metrics_labels, "use=\"playback\""))}
+        , memoryWaits(chrono_metrics::getInstance().histogram("chronolog_client_memory_wait_ns", metrics_labels))
+        , memoryRejects(chrono_metrics::getInstance().counter("chronolog_client_memory_rejects_total", metrics_labels))
+        , reclaims(chrono_metrics::getInstance().counter("chronolog_client_memory_reclaims_total", metrics_labels))
+        , limitGauge(chrono_metrics::getInstance().gauge("chronolog_client_memory_limit_bytes", metrics_labels))
+    {
+        // added and not set : a client instance that reuses the slot of a destroyed one takes over its series
+        limitGauge.add(static_cast<int64_t>(maxBytes));
+    }
+
+    ~MemoryBudget()
+    {
+        limitGauge.sub(static_cast<int64_t>(maxBytes));
+    }
+
+    bool capped() const
+    { return (maxBytes != 0); }
+
+    uint64_t limit_bytes() const
+    { return maxBytes; }
+
+    uint64_t used_bytes() const
+    { return usedBytes.load(std::memory_order_relaxed); }
+
+    uint64_t used_bytes(MemoryUse use) const
+    { return usedByUse[use].load(std::memory_order_relaxed); }
+
+    // charges bytes to the budget, waiting up to memory_wait_ms for them at the cap
+    bool acquire(std::size_t bytes, MemoryUse use)
+    { return acquire(bytes, use, std::chrono::steady_clock::now() + waitTime); }
+
+    bool try_acquire(std::size_t bytes, MemoryUse use)
+    { return acquire(bytes, use, std::chrono::steady_clock::time_point()); }
+
+    bool acquire(std::size_t bytes, MemoryUse use, std::chrono::steady_clock::time_point const &deadline)
+    {
+        if(!charge(bytes))
+        {
+            uint64_t wait_start = metrics_now_ns();
+            std::unique_lock <std::mutex> lock(budgetMutex);
+            ++waiters;
+            bool charged = charge(bytes);
+            while(!charged)
+            {
+                lock.unlock();
+                reclaim();
+                lock.lock();
+                if((charged = charge(bytes)))
+                { break; }
+                bool timed_out = (budgetCondition.wait_until(lock, deadline) == std::cv_status::timeout);
+                charged = charge(bytes);
+                if(timed_out)
+                { break; }
+            }
+            --waiters;
+            lock.unlock();
+            memoryWaits.record(metrics_now_ns() - wait_start);
+            if(!charged)
+            {
+                memoryRejects.add(1);
+                return false;
+            }
+        }
+        usedByUse[use].fetch_add(bytes, std::memory_order_relaxed);
+        usedGauge[use]->add(static_cast<int64_t>(bytes));
+        if(capped() && used_bytes() > reclaimBytes)
+        { reclaim(); }
+        return true;
+    }
+
+    void release(std::size_t bytes, MemoryUse use)
+    {
+        if(bytes == 0)
+        { return; }
+        // sequentially consistent with the charge of a waiter, so that either sees the other
+        usedBytes.fetch_sub(bytes);
+        usedByUse[use].fetch_sub(bytes, std::memory_order_relaxed);
+        usedGauge[use]->sub(static_cast<int64_t>(bytes));
+        if(waiters.load() > 0)
+        {
+            std::lock_guard <std::mutex> lock(budgetMutex);
+            budgetCondition.notify_all();
+        }
+    }
+
+    // the reclaimer is called past the reclaim threshold, it must not acquire memory itself
+    uint64_t add_reclaimer(std::function <void()> const &reclaimer)
+    {
+        std::lock_guard <std::mutex> lock(reclaimerMutex);
+        reclaimers.emplace(++nextReclaimerId, reclaimer);
+        return nextReclaimerId;
+    }
+
+    // once it returns the reclaimer is no longer running nor called
+    void remove_reclaimer(uint64_t reclaimer_id)
+    {
+        std::lock_guard <std::mutex> lock(reclaimerMutex);
+        reclaimers.erase(reclaimer_id);
+    }
+
+private:
+    MemoryBudget(MemoryBudget const &) = delete;
+    MemoryBudget &operator=(MemoryBudget const &) = delete;
+
+    bool charge(std::size_t bytes)
+    {
+        uint64_t used = usedBytes.load();
+        do
+        {
+            if(capped() && used != 0 && used + bytes > maxBytes)
+            { return false; }
+        }
+        while(!usedBytes.compare_exchange_weak(used, used + bytes));
+        return true;
+    }
+
+    // a single thread runs the reclaimers at a time, the others go on
+    void reclaim()
+    {
+        if(reclaiming.exchange(true, std::memory_order_acquire))
+        { return; }
+        {
+            std::lock_guard <std::mutex> lock(reclaimerMutex);
+            reclaims.add(1);
+            for(auto const &reclaimer: reclaimers)
+            { reclaimer.second(); }
+        }
+        reclaiming.store(false, std::memory_order_release);
+    }
+
+    uint64_t maxBytes;
+    uint64_t reclaimBytes;
+    std::chrono::milliseconds waitTime;
+    std::atomic <uint64_t> usedBytes;
+    std::atomic <uint64_t> usedByUse[MEMORY_USE_COUNT];
+
+    std::mutex budgetMutex;
+    std::condition_variable budgetCondition;
+    std::atomic <uint32_t> waiters;
+
+    std::atomic <bool> reclaiming;
+    std::mutex reclaimerMutex;
+    uint64_t nextReclaimerId;
+    std::map <uint64_t, std::function <void()>> reclaimers;
+
+    Gauge *usedGauge[MEMORY_USE_COUNT];
+    LatencyHistogram &memoryWaits;
+    ShardedCounter &memoryRejects;
+    ShardedCounter &reclaims;
+    Gauge &limitGauge;
+};
+
+}
+
+#endif
@@ -0,0 +1,467 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <tuple>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chronolog_errcode.h"
+#include "chrono_monitor.h"
+#include "NodeAggregator.h"
+#include "StorytellerClient.h"
+#include "KeeperRecordingClient.h"
+
+namespace chl = chronolog;
+
+namespace
+{
+constexpr uint64_t SEGMENT_MAGIC = 0x43484c4e4f444531ULL;   // "CHLNODE1"
+constexpr std::chrono::milliseconds SEGMENT_INIT_WAIT(1000);
+
+inline std::size_t padded_entry_bytes(std::size_t bytes)
+{ return (bytes + 7) & ~std::size_t(7); }
+
+inline bool process_exited(int32_t pid)
+{ return (kill(pid, 0) != 0 && errno == ESRCH); }
+}
+
+chl::NodeAggregator *chl::NodeAggregator::CreateNodeAggregator(chl::StorytellerClient &storyteller
+                                                               , chl::ClientAggregationConf const &aggregation_conf)
+{
+    NodeAggregator *node_aggregator = new NodeAggregator(storyteller, aggregation_conf);
+    if(!node_aggregator->map_segment() || !node_aggregator->claim_slot())
+    {
+        delete node_aggregator;
+        return nullptr;
+    }
+    node_aggregator->electionThread = std::thread(&NodeAggregator::run_election, node_aggregator);
+    return node_aggregator;
+}
+
+chl::NodeAggregator::NodeAggregator(chl::StorytellerClient &storyteller
+                                    , chl::ClientAggregationConf const &aggregation_conf)
+        : theStoryteller(storyteller)
+        , aggregationConf(aggregation_conf)
+        , segmentFd(-1)
+        , segment(nullptr)
+        , segmentBytes(0)
+        , slotCount(0)
+        , slotStride(0)
+        , ringBytes(0)
+        , ownSlot(nullptr)
+        , flushedFailures(0)
+        , forwarding(false)
+        , stopping(false)
+        , forwarderGauge(chl::chrono_metrics::getInstance().gauge("chronolog_aggregator_forwarder"
+                                                           , storyteller.metrics_labels()))
+        , forwardedEvents(chl::chrono_metrics::getInstance().counter("chronolog_aggregator_forwarded_events_total"
+                                                           , storyteller.metrics_labels()))
+        , failedEvents(chl::chrono_metrics::getInstance().counter("chronolog_aggregator_failed_events_total"
+                                                           , storyteller.metrics_labels()))
+        , ringFullEvents(chl::chrono_metrics::getInstance().counter("chronolog_aggregator_ring_full_events_total"
+                                                           , storyteller.metrics_labels()))
+        , forwardBatchEvents(chl::chrono_metrics::getInstance().histogram("chronolog_aggregator_batch_events"
+                                                           , storyteller.metrics_labels()))
+{}
+
+chl::NodeAggregator::~NodeAggregator()
+{
+    {
+        std::lock_guard <std::mutex> lock(electionMutex);
+        stopping = true;
+    }
+    electionCondition.notify_all();
+    if(electionThread.joinable())
+    { electionThread.join(); }
+
+    // the forwarder frees the slot once it drained the events left in the ring
+    if(ownSlot != nullptr)
+    { ownSlot->closing.store(1, std::memory_order_release); }
+    if(segment != nullptr)
+    { munmap(segment, segmentBytes); }
+    // closing the segment releases the forwarder lock, the segment itself stays for the other processes
+    if(segmentFd >= 0)
+    { close(segmentFd); }
+    LOG_DEBUG("[NodeAggregator] Stopped");
+}
+
+bool chl::NodeAggregator::map_segment()
+{
+    std::string const &segment_name = aggregationConf.segment_name();
+    bool created = true;
+    segmentFd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(segmentFd < 0 && errno == EEXIST)
+    {
+        created = false;
+        segmentFd = shm_open(segment_name.c_str(), O_RDWR, 0600);
+    }
+    if(segmentFd < 0)
+    {
+        LOG_ERROR("[NodeAggregator] Failed to open shared memory segment {} : {}", segment_name, std::strerror(errno));
+        return false;
+    }
+
+    if(created)
+    {
+        slotCount = std::max <uint32_t>(1, aggregationConf.process_slots());
+        ringBytes = std::max <uint64_t>(4096, (aggregationConf.ring_bytes() + 63) & ~uint64_t(63));
+        slotStride = static_cast<uint32_t>(sizeof(RingSlot) + ringBytes);
+        segmentBytes = sizeof(SegmentHeader) + static_cast<std::size_t>(slotCount) * slotStride;
+        if(ftruncate(segmentFd, static_cast<off_t>(segmentBytes)) != 0)
+        {
+            LOG_ERROR("[NodeAggregator] Failed to size shared memory segment {} : {}", segment_name
+                      , std::strerror(errno));
+            shm_unlink(segment_name.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        // the process that created the segment sizes it and sets the magic last
+        std::chrono::steady_clock::time_point init_deadline = std::chrono::steady_clock::now() + SEGMENT_INIT_WAIT;
+        struct stat segment_stat;
+        while(fstat(segmentFd, &segment_stat) == 0
+              && static_cast<std::size_t>(segment_stat.st_size) < sizeof(SegmentHeader)
+              && std::chrono::steady_clock::now() < init_deadline)
+        { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        void *header_map = mmap(nullptr, sizeof(SegmentHeader), PROT_READ, MAP_SHARED, segmentFd, 0);
+        if(header_map == MAP_FAILED)
+        {
+            LOG_ERROR("[NodeAggregator] Failed to map shared memory segment {} : {}", segment_name
+                      , std::strerror(errno));
+            return false;
+        }
+        SegmentHeader *header = static_cast<SegmentHeader*>(header_map);
+        while(header->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC
+              && std::chrono::steady_clock::now() < init_deadline)
+        { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        bool initialized = (header->magic.load(std::memory_order_acquire) == SEGMENT_MAGIC);
+        slotCount = header->slotCount;
+        slotStride = header->slotStride;
+        ringBytes = header->ringBytes;
+        munmap(header_map, sizeof(SegmentHeader));
+        if(!initialized)
+        {
+            LOG_ERROR("[NodeAggregator] Shared memory segment {} was not initialized in time", segment_name);
+            return false;
+        }
+        segmentBytes = sizeof(SegmentHeader) + static_cast<std::size_t>(slotCount) * slotStride;
+    }
+
+    void *segment_map = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFd, 0);
+    if(segment_map == MAP_FAILED)
+    {
+        LOG_ERROR("[NodeAggregator] Failed to map shared memory segment {} : {}", segment_name, std::strerror(errno));
+        return false;
+    }
+    segment = static_cast<char*>(segment_map);
+
+    if(created)
+    {
+        SegmentHeader *header = new(segment) SegmentHeader();
+        for(uint32_t i = 0; i < slotCount; ++i)
+        { new(slot_at(i)) RingSlot(); }
+        header->slotCount = slotCount;
+        header->slotStride = slotStride;
+        header->ringBytes = ringBytes;
+        header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    }
+    LOG_INFO("[NodeAggregator] {} shared memory segment {} : {} slots of {} bytes", (created ? "Created" : "Opened")
+             , segment_name, slotCount, ringBytes);
+    return true;
+}
+
+bool chl::NodeAggregator::claim_slot()
+{
+    int32_t pid = getpid();
+    for(uint32_t i = 0; i < slotCount; ++i)
+    {
+        RingSlot *slot = slot_at(i);
+        int32_t owner = slot->ownerPid.load(std::memory_order_acquire);
+        // the slot of a process that exited is taken over once the forwarder drained it
+        if(owner != 0 && !(process_exited(owner) && slot->tail.load() == slot->head.load()))
+        { continue; }
+        if(slot->ownerPid.compare_exchange_strong(owner, pid))
+        {
+            slot->closing.store(0, std::memory_order_release);
+            flushedFailures = slot->failedEvents.load();
+            ownSlot = slot;
+            LOG_INFO("[NodeAggregator] Process {} writes to ring {} of {}", pid, i, aggregationConf.segment_name());
+            return true;
+        }
+    }
+    LOG_ERROR("[NodeAggregator] All the {} rings of {} are taken", slotCount, aggregationConf.segment_name());
+    return false;
+}
+
+int chl::NodeAggregator::submit_event(chl::KeeperIdCard const &keeper_id_card, chl::LogEvent const &event
+                                      , bool lz_compression, chl::EventPriority priority)
+{
+    std::string const &protocol = keeper_id_card.getRecordingServiceId().getProtocol();
+    std::string const &record = event.getRecord();
+    uint64_t entry_bytes = padded_entry_bytes(sizeof(RingEntry) + protocol.size() + record.size());
+    // an event larger than half the ring would hold the ring up, it goes directly
+    if(entry_bytes > ringBytes / 2 || protocol.size() > UINT16_MAX)
+    { return chl::CL_ERR_NO_MEMORY; }
+
+    std::lock_guard <std::mutex> lock(writerMutex);
+    uint64_t head = ownSlot->head.load(std::memory_order_relaxed);
+    uint64_t offset = head % ringBytes;
+    uint64_t padding = (ringBytes - offset < entry_bytes ? ringBytes - offset : 0);
+    if(head + padding + entry_bytes - ownSlot->tail.load(std::memory_order_acquire) > ringBytes)
+    {
+        std::chrono::steady_clock::time_point wait_deadline =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(aggregationConf.ring_wait_ms());
+        do
+        {
+            if(std::chrono::steady_clock::now() >= wait_deadline)
+            {
+                ringFullEvents.add(1);
+                return chl::CL_ERR_NO_MEMORY;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+        while(head + padding + entry_bytes - ownSlot->tail.load(std::memory_order_acquire) > ringBytes);
+    }
+
+    char *ring = ring_of(ownSlot);
+    if(padding > 0)
+    {
+        // too short for a padding entry, the forwarder skips it the same way
+        if(padding >= sizeof(RingEntry))
+        {
+            RingEntry padding_entry{};
+            padding_entry.entryBytes = static_cast<uint32_t>(padding);
+            padding_entry.entryType = RING_ENTRY_PADDING;
+            std::memcpy(ring + offset, &padding_entry, sizeof(RingEntry));
+        }
+        head += padding;
+        offset = 0;
+    }
+
+    ServiceId const &service_id = keeper_id_card.getRecordingServiceId();
+    RingEntry entry{};
+    entry.entryBytes = static_cast<uint32_t>(entry_bytes);
+    entry.recordBytes = static_cast<uint32_t>(record.size());
+    entry.protocolBytes = static_cast<uint16_t>(protocol.size());
+    entry.entryType = RING_ENTRY_EVENT;
+    entry.priority = static_cast<uint8_t>(priority);
+    entry.lzCompression = (lz_compression ? 1 : 0);
+    entry.groupId = keeper_id_card.getGroupId();
+    entry.ipAddr = service_id.getIPaddr();
+    entry.port = service_id.getPort();
+    entry.providerId = service_id.getProviderId();
+    entry.eventIndex = event.index();
+    entry.storyId = event.getStoryId();
+    entry.eventTime = event.time();
+    entry.clientId = event.getClientId();
+    std::memcpy(ring + offset, &entry, sizeof(RingEntry));
+    std::memcpy(ring + offset + sizeof(RingEntry), protocol.data(), protocol.size());
+    std::memcpy(ring + offset + sizeof(RingEntry) + protocol.size(), record.data(), record.size());
+
+    ownSlot->writtenEvents.fetch_add(1, std::memory_order_relaxed);
+    ownSlot->head.store(head + entry_bytes, std::memory_order_release);
+    return chl::CL_SUCCESS;
+}
+
+int chl::NodeAggregator::flush(std::chrono::steady_clock::time_point const &deadline)
+{
+    uint64_t written_events = ownSlot->writtenEvents.load();
+    while(ownSlot->completedEvents.load() < written_events)
+    {
+        if(std::chrono::steady_clock::now() >= deadline)
+        { return chl::CL_ERR_TIMEOUT; }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    uint64_t failures = ownSlot->failedEvents.load();
+    std::lock_guard <std::mutex> lock(writerMutex);
+    if(failures == flushedFailures)
+    { return chl::CL_SUCCESS; }
+    LOG_WARNING("[NodeAggregator] {} events forwarded for this process were not acknowledged since the previous flush"
+                , failures - flushedFailures);
+    flushedFailures = failures;
+    return chl::CL_ERR_NOT_ACKNOWLEDGED;
+}
+
+uint64_t chl::NodeAggregator::unforwarded_events() const
+{
+    uint64_t completed_events = ownSlot->completedEvents.load();
+    uint64_t written_events = ownSlot->writtenEvents.load();
+    return (written_events > completed_events ? written_events - completed_events : 0);
+}
+
+void chl::NodeAggregator::run_election()
+{
+    std::unique_lock <std::mutex> lock(electionMutex);
+    while(!stopping)
+    {
+        if(!forwarding.load(std::memory_order_relaxed))
+        {
+            // the lock goes with the segment descriptor, it is released when the forwarder process exits
+            if(flock(segmentFd, LOCK_EX | LOCK_NB) == 0)
+            {
+                forwarding.store(true);
+                forwarderGauge.set(1);
+                LOG_INFO("[NodeAggregator] Process {} is the forwarder of {}", getpid()
+                         , aggregationConf.segment_name());
+                continue;
+            }
+            electionCondition.wait_for(lock, std::chrono::milliseconds(aggregationConf.election_interval_ms())
+                                       , [this]()
+            { return stopping; });
+            continue;
+        }
+
+        lock.unlock();
+        uint64_t forwarded_events = forward_round();
+        lock.lock();
+        if(forwarded_events == 0)
+        {
+            electionCondition.wait_for(lock, std::chrono::microseconds(aggregationConf.forward_poll_us())
+                                       , [this]()
+            { return stopping; });
+        }
+    }
+
+    if(forwarding.load(std::memory_order_relaxed))
+    {
+        // what the rings hold now goes out before another process takes over
+        lock.unlock();
+        forward_round();
+        flock(segmentFd, LOCK_UN);
+        forwarding.store(false);
+        forwarderGauge.set(0);
+        LOG_INFO("[NodeAggregator] Process {} handed over the forwarder role", getpid());
+    }
+}
+
+uint64_t chl::NodeAggregator::forward_round()
+{
+    // the events of a round grouped by keeper and by writer client, the multi story batches carry a single client
+    std::map <std::tuple <uint32_t, uint16_t, uint16_t, chl::ClientId>
+              , std::pair <chl::KeeperIdCard, std::vector <ForwardedEvent>>> keeper_events;
+    std::vector <uint32_t> closed_slots;
+    uint64_t round_events = 0;
+
+    for(uint32_t slot_index = 0; slot_index < slotCount; ++slot_index)
+    {
+        RingSlot *slot = slot_at(slot_index);
+        int32_t owner = slot->ownerPid.load(std::memory_order_acquire);
+        if(owner == 0)
+        { continue; }
+        uint64_t tail = slot->tail.load(std::memory_order_relaxed);
+        uint64_t head = slot->head.load(std::memory_order_acquire);
+        char const *ring = ring_of(slot);
+        while(tail < head)
+        {
+            uint64_t offset = tail % ringBytes;
+            if(ringBytes - offset < sizeof(RingEntry))
+            {
+                tail += ringBytes - offset;
+                continue;
+            }
+            RingEntry entry;
+            std::memcpy(&entry, ring + offset, sizeof(RingEntry));
+            // the ring is shared memory any process of the node writes to, a corrupt entry abandons the ring
+            if(entry.entryBytes < sizeof(RingEntry) || entry.entryBytes > ringBytes - offset
+               || (entry.entryType != RING_ENTRY_PADDING
+                   && sizeof(RingEntry) + entry.protocolBytes + uint64_t(entry.recordBytes) > entry.entryBytes))
+            {
+                LOG_ERROR("[NodeAggregator] Corrupt entry of {} bytes in ring slot {} of process {}, {} bytes of"
+                          " events are dropped", entry.entryBytes, slot_index, owner, head - tail);
+                tail = head;
+                break;
+            }
+            if(entry.entryType != RING_ENTRY_PADDING)
+            {
+                char const *entry_data = ring + offset + sizeof(RingEntry);
+                auto keeper_batch_iter = keeper_events.try_emplace(
+                        std::make_tuple(entry.ipAddr, entry.port, entry.providerId, entry.clientId)
+                        , chl::KeeperIdCard(entry.groupId
+                                            , chl::ServiceId(std::string(entry_data, entry.protocolBytes)
+                                                             , entry.ipAddr, entry.port, entry.providerId))
+                        , std::vector <ForwardedEvent>()).first;
+                auto &keeper_batch = (*keeper_batch_iter).second;
+                keeper_batch.second.push_back(ForwardedEvent{
+                        chl::LogEvent(entry.storyId, entry.eventTime, entry.clientId, entry.eventIndex
+                                      , std::string(entry_data + entry.protocolBytes, entry.recordBytes))
+                        , entry.lzCompression != 0, entry.priority, slot_index});
+                ++round_events;
+            }
+            tail += entry.entryBytes;
+        }
+        // the events are copied out, the writer gets the ring space back right away
+        slot->tail.store(tail, std::memory_order_release);
+
+        if(slot->closing.load(std::memory_order_acquire) != 0 || (owner != getpid() && process_exited(owner)))
+        { closed_slots.push_back(slot_index); }
+    }
+
+    for(auto &keeper_batch: keeper_events)
+    {
+        send_keeper_events(keeper_batch.second.first, std::get <3>(keeper_batch.first), keeper_batch.second.second);
+    }
+
+    // the slot of a process that is gone is free again once its events were forwarded
+    for(uint32_t slot_index: closed_slots)
+    {
+        RingSlot *slot = slot_at(slot_index);
+        int32_t owner = slot->ownerPid.load(std::memory_order_acquire);
+        if(slot->tail.load() == slot->head.load() && owner != 0)
+        { slot->ownerPid.compare_exchange_strong(owner, 0); }
+    }
+    return round_events;
+}
+
+void chl::NodeAggregator::send_keeper_events(chl::KeeperIdCard const &keeper_id_card, chl::ClientId client_id
+                                             , std::vector <ForwardedEvent> &events)
+{
+    // the high priority stories go first, the order within a story is kept
+    std::stable_sort(events.begin(), events.end(), [](ForwardedEvent const &first, ForwardedEvent const &second)
+    { return first.priority < second.priority; });
+
+    chl::KeeperRecordingClient *keeper_client = theStoryteller.getKeeperRecordingClient(keeper_id_card);
+    chl::ClientRecordingConf const &recording_conf = theStoryteller.recording_conf();
+    chl::MultiStoryBatchEncoder batch(client_id);
+    std::map <uint32_t, uint64_t> slot_events;
+    std::size_t next_event = 0;
+    while(next_event < events.size())
+    {
+        batch.clear();
+        slot_events.clear();
+        while(next_event < events.size() && batch.event_count() < recording_conf.max_batch_events()
+              && batch.payload_size() < recording_conf.max_batch_bytes())
+        {
+            batch.add_event(events[next_event].event, events[next_event].lzCompression);
+            ++slot_events[events[next_event].slotIndex];
+            ++next_event;
+        }
+
+        int return_code = (keeper_client != nullptr ? keeper_client->send_multi_story_batch(batch)
+                                                    : chl::CL_ERR_UNKNOWN);
+        forwardBatchEvents.record(batch.event_count());
+        if(return_code == chl::CL_SUCCESS)
+        { forwardedEvents.add(batch.event_count()); }
+        else
+        {
+            failedEvents.add(batch.event_count());
+            LOG_ERROR("[NodeAggregator] Failed to forward a batch of {} events to {}, error {}", batch.event_count()
+                      , to_string(keeper_id_card), return_code);
+        }
+        // the failures are published before the completions the writers flush on
+        for(auto const &slot_count: slot_events)
+        {
+            RingSlot *slot = slot_at(slot_count.first);
+            if(return_code != chl::CL_SUCCESS)
+            { slot->failedEvents.fetch_add(slot_count.second); }
+            slot->completedEvents.fetch_add(slot_count.second);
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#ifndef NODE_AGGREGATOR_H
+#define NODE_AGGREGATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chronolog_types.h"
+#include "ClientConfiguration.h"
+#include "KeeperIdCard.h"
+#include "KeeperEventBatcher.h"
+#include "chrono_metrics.h"
+
+namespace chronolog
+{
+
+class StorytellerClient;
+
+// Node-local aggregation of the recording path, for the many client processes of a node (MPI ranks) :
+// every process gets a ring in a POSIX shared memory segment and writes the events of its stories there,
+// together with the keeper it chose for them ; a single forwarder drains all the rings and sends the events
+// to the keepers in multi story batches, so the keepers talk to one process per node and get larger batches.
+// The forwarder is elected with an exclusive flock on the segment : the process holding it forwards,
+// the others retry every election_interval_ms and one of them takes over when the forwarder exits,
+// the events written meanwhile stay in the rings.
+// The forwarder publishes per ring the events it saw acknowledged or failed, the writers flush on them.
+// An event that finds its ring full for ring_wait_ms is sent directly by the writer instead.
+//
+// segment : header | slot 0 | ring 0 | slot 1 | ring 1 ...
+// ring entry : RingEntry | keeper protocol | record, padded to 8 bytes ; the head and tail offsets only grow
+
+class NodeAggregator
+{
+public:
+    // nullptr if the segment can not be mapped or all its slots are taken, the client then sends directly
+    static NodeAggregator *CreateNodeAggregator(StorytellerClient &storyteller
+                                                , ClientAggregationConf const &aggregation_conf);
+
+    ~NodeAggregator();
+
+    // CL_SUCCESS once the event is in the ring, CL_ERR_NO_MEMORY if the ring stayed full for ring_wait_ms
+    int submit_event(KeeperIdCard const &keeper_id_card, LogEvent const &event, bool lz_compression
+                     , EventPriority priority);
+
+    // waits until the forwarder completed the events written to the ring of this process before the call,
+    // CL_ERR_TIMEOUT if the deadline passes first, CL_ERR_NOT_ACKNOWLEDGED if some failed since the last flush
+    int flush(std::chrono::steady_clock::time_point const &deadline);
+
+    // events written to the ring of this process that the forwarder did not complete yet
+    uint64_t unforwarded_events() const;
+
+    bool is_forwarder() const
+    { return forwarding.load(std::memory_order_relaxed); }
+
+private:
+    NodeAggregator(StorytellerClient &storyteller, ClientAggregationConf const &aggregation_conf);
+
+    NodeAggregator(NodeAggregator const &) = delete;
+    NodeAggregator &operator=(NodeAggregator const &) = delete;
+
+    struct alignas(64) SegmentHeader
+    {
+        std::atomic <uint64_t> magic;   // set last by the process that created the segment
+        uint32_t slotCount;
+        uint32_t slotStride;
+        uint64_t ringBytes;
+    };
+
+    struct alignas(64) RingSlot
+    {
+        std::atomic <int32_t> ownerPid;   // 0 for a free slot
+        std::atomic <uint32_t> closing;   // set by the owner on exit, the forwarder frees the drained slot
+        alignas(64) std::atomic <uint64_t> head;   // written by the owner
+        std::atomic <uint64_t> writtenEvents;
+        alignas(64) std::atomic <uint64_t> tail;   // written by the forwarder
+        std::atomic <uint64_t> completedEvents;
+        std::atomic <uint64_t> failedEvents;
+    };
+
+    struct RingEntry
+    {
+        uint32_t entryBytes;   // the whole padded entry
+        uint32_t recordBytes;
+        uint16_t protocolBytes;
+        uint8_t entryType;
+        uint8_t priority;
+        uint8_t lzCompression;
+        uint8_t unused[3];
+        uint32_t groupId;
+        uint32_t ipAddr;
+        uint16_t port;
+        uint16_t providerId;
+        uint32_t eventIndex;
+        uint64_t storyId;
+        uint64_t eventTime;
+        uint64_t clientId;
+    };
+
+    enum RingEntryType
+    {
+        RING_ENTRY_EVENT = 1,
+        RING_ENTRY_PADDING = 2   // fills the end of the ring, the next entry starts at offset 0
+    };
+
+    // an event taken out of a ring by the forwarder, with the ring it completes on
+    struct ForwardedEvent
+    {
+        LogEvent event;
+        bool lzCompression;
+        uint8_t priority;
+        uint32_t slotIndex;
+    };
+
+    bool map_segment();
+
+    bool claim_slot();
+
+    RingSlot *slot_at(uint32_t slot_index) const
+    {
+        return reinterpret_cast<RingSlot*>(segment + sizeof(SegmentHeader)
+                                           + static_cast<std::size_t>(slot_index) * slotStride);
+    }
+
+    char *ring_of(RingSlot *slot) const
+    { return reinterpret_cast<char*>(slot) + sizeof(RingSlot); }
+
+    void run_election();
+
+    // drains the rings once, returns the number of events forwarded
+    uint64_t forward_round();
+
+    void send_keeper_events(KeeperIdCard const &keeper_id_card, ClientId client_id
+                            , std::vector <ForwardedEvent> &events);
+
+    StorytellerClient &theStoryteller;
+    ClientAggregationConf aggregationConf;
+    int segmentFd;
+    char *segment;
+    std::size_t segmentBytes;
+    uint32_t slotCount;
+    uint32_t slotStride;
+    uint64_t ringBytes;
+
+    RingSlot *ownSlot;
+    std::mutex writerMutex;   // the ring has a single producer, the writer threads of the process take turns
+    uint64_t flushedFailures;
+
+    std::atomic <bool> forwarding;
+    bool stopping;
+    std::mutex electionMutex;
+    std::condition_variable electionCondition;
+    std::thread electionThread;
+
+    Gauge &forwarderGauge;
+    ShardedCounter &forwardedEvents;
+    ShardedCounter &failedEvents;
+    ShardedCounter &ringFullEvents;
+    LatencyHistogram &forwardBatchEvents;
+};
+
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "ServiceId.h"
 #include "PlaybackQueryRpcClient.h"
 #include "ClientQueryService.h"
+#include "TimedRpc.h"
 
 
 namespace tl = thallium;
@@ -17,9 +18,10 @@ namespace chl = chronolog;
 
  // constructor is private to make sure thalium rpc objects are created on the heap, not stack
 chl::PlaybackQueryRpcClient::PlaybackQueryRpcClient(chl::ClientQueryService & clientQueryService
-                , chl::ServiceId const& playback_service_id)
+                , chl::ServiceId const& playback_service_id, uint32_t rpc_timeout_ms)
     : theClientQueryService(clientQueryService)
     , playback_service_id(playback_service_id)
+    , rpcTimeout(rpc_timeout_ms)
 {
     std::string service_addr_string;
     playback_service_id.get_service_as_string(service_addr_string);
@@ -42,7 +44,7 @@ int chl::PlaybackQueryRpcClient::is_playback_service_available()
 
     try
     {
-        return ( playback_service_available.on(playback_service_handle)() );
+        return ( chl::timed_call(playback_service_available.on(playback_service_handle), rpcTimeout) );
     }
     catch (tl::exception const &ex)
     {
@@ -52,18 +54,21 @@ int chl::PlaybackQueryRpcClient::is_playback_service_available()
     return chl::CL_ERR_UNKNOWN;
 }
     
-int chl::PlaybackQueryRpcClient::send_story_playback_request(chl::ChronicleName const &chronicle_name, chl::StoryName const &story_name, uint64_t start_time, uint64_t end_time)
+int chl::PlaybackQueryRpcClient::send_story_playback_request(chl::ChronicleName const &chronicle_name, chl::StoryName const &story_name, uint64_t start_time, uint64_t end_time
+                , uint32_t & query_id)
 {
     int return_code = chl::CL_ERR_UNKNOWN;
 
-    uint32_t query_id = theClientQueryService.start_new_query( chronicle_name,story_name,start_time,end_time);
+    query_id = theClientQueryService.start_new_query( chronicle_name,story_name,start_time,end_time);
     
     try
     {
         LOG_DEBUG("[PlaybackQueryRpcClient] {} ; send_story_playback_request for Story {}{}", chl::to_string(playback_service_id), chronicle_name,story_name);
-        story_playback_request.on(playback_service_handle)( theClientQueryService.get_service_id(), query_id, chronicle_name,story_name,start_time,end_time);
+        // the Player pushes all the response StoryChunks to our ClientQueryService before it responds to the request
+        return_code = chl::timed_call(story_playback_request.on(playback_service_handle), rpcTimeout
+                        , theClientQueryService.get_service_id(), query_id, chronicle_name, story_name, start_time, end_time);
 
-        return chl::CL_SUCCESS;
+        return return_code;
 
     } 
     catch (tl::exception const& ex)
@@ -74,4 +79,25 @@ int chl::PlaybackQueryRpcClient::send_story_playback_request(chl::ChronicleName
     return return_code;
 }
 
+tl::async_response chl::PlaybackQueryRpcClient::send_story_playback_request_async(chl::ChronicleName const &chronicle_name
+                , chl::StoryName const &story_name, uint64_t start_time, uint64_t end_time, uint32_t query_id)
+{
+    LOG_DEBUG("[PlaybackQueryRpcClient] {} ; send_story_playback_request_async for Story {}{} query {}"
+                , chl::to_string(playback_service_id), chronicle_name, story_name, query_id);
+    return chl::timed_async_call(story_playback_request.on(playback_service_handle), rpcTimeout
+                , theClientQueryService.get_service_id(), query_id, chronicle_name, story_name, start_time, end_time);
+}
 
+int chl::PlaybackQueryRpcClient::complete_story_playback_request(tl::async_response & response)
+{
+    try
+    {
+        int return_code = response.wait();
+        return return_code;
+    }
+    catch (tl::exception const& ex)
+    {
+        LOG_ERROR("[PlaybackQueryRpcClient] {} ; send_story_playback_request exception {}", chl::to_string(playback_service_id), ex.what());
+    }
+    return chl::CL_ERR_UNKNOWN;
+}
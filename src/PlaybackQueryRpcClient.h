@@ -1,6 +1,7 @@
 #ifndef PLAYBACK_QUERY_RPC_CLIENT_H
 #define PLAYBACK_QUERY_RPC_CLIENT_H
 
+#include <chrono>
 #include <thallium.hpp>
 
 #include "ServiceId.h"
@@ -20,11 +21,12 @@ public:
 
     // Service should be created on the heap not the stack thus the constructor is private...
     static PlaybackQueryRpcClient*
-    CreatePlaybackQueryRpcClient( ClientQueryService & localQueryService, ServiceId const& playback_service_id)
+    CreatePlaybackQueryRpcClient( ClientQueryService & localQueryService, ServiceId const& playback_service_id
+                                , uint32_t rpc_timeout_ms = 0)
     {
         try
         {
-            return new PlaybackQueryRpcClient( localQueryService, playback_service_id);
+            return new PlaybackQueryRpcClient( localQueryService, playback_service_id, rpc_timeout_ms);
         }
         catch(tl::exception const &ex)
         {
@@ -38,7 +40,21 @@ public:
 
     int is_playback_service_available();
 
-    int send_story_playback_request(ChronicleName const & chronicle_name, StoryName const & story_name, uint64_t start_time, uint64_t end_time);
+    // query_id is set to the id the query was registered under with the ClientQueryService,
+    // the caller collects the response with ClientQueryService::collect_query_response()
+    int send_story_playback_request(ChronicleName const & chronicle_name, StoryName const & story_name, uint64_t start_time, uint64_t end_time
+                , uint32_t & query_id);
+
+    // issues the story_playback_request of a query already started with the ClientQueryService
+    // without waiting for the Player response ; throws tl::exception if the RPC can not be issued
+    tl::async_response send_story_playback_request_async(ChronicleName const & chronicle_name
+                , StoryName const & story_name, uint64_t start_time, uint64_t end_time, uint32_t query_id);
+
+    // waits for the response of send_story_playback_request_async
+    int complete_story_playback_request(tl::async_response & response);
+
+    ServiceId const& get_service_id() const
+    { return playback_service_id; }
 
 private:
 
@@ -51,9 +67,10 @@ private:
     tl::provider_handle playback_service_handle;  // tl::provider_handle for remote PlaybackService
     tl::remote_procedure playback_service_available;
     tl::remote_procedure story_playback_request;
+    std::chrono::milliseconds rpcTimeout;   // 0 for no deadline
 
     // constructor is private to make sure thalium rpc objects are created on the heap, not stack
-    PlaybackQueryRpcClient(ClientQueryService &, ServiceId const& playback_service_id);
+    PlaybackQueryRpcClient(ClientQueryService &, ServiceId const& playback_service_id, uint32_t rpc_timeout_ms);
 
 };
 
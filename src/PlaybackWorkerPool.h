@@ -0,0 +1,92 @@
+#ifndef PLAYBACK_WORKER_POOL_H
+#define PLAYBACK_WORKER_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chronolog
+{
+
+// Fixed set of threads the sub-queries of the collective playbacks of a client run on, started with the
+// first playback : run() queues the tasks of a call and returns once they are all done, the tasks of
+// concurrent calls share the workers, so the threads of the client do not grow with the sub-queries.
+
+class PlaybackWorkerPool
+{
+public:
+    explicit PlaybackWorkerPool(uint32_t worker_count)
+        : workerCount(std::max <uint32_t>(1, worker_count))
+        , stopping(false)
+    {}
+
+    ~PlaybackWorkerPool()
+    {
+        {
+            std::lock_guard <std::mutex> lock(poolMutex);
+            stopping = true;
+        }
+        taskCondition.notify_all();
+        for(auto &worker: workers)
+        { worker.join(); }
+    }
+
+    void run(std::vector <std::function <void()>> const &tasks)
+    {
+        std::size_t remaining_tasks = tasks.size();
+        std::unique_lock <std::mutex> lock(poolMutex);
+        while(workers.size() < workerCount)
+        { workers.emplace_back(&PlaybackWorkerPool::run_worker, this); }
+        for(auto const &task: tasks)
+        {
+            pendingTasks.emplace_back([&task, &remaining_tasks, this]()
+                                      {
+                                          task();
+                                          std::lock_guard <std::mutex> done_lock(poolMutex);
+                                          if(--remaining_tasks == 0)
+                                          { doneCondition.notify_all(); }
+                                      });
+        }
+        taskCondition.notify_all();
+        doneCondition.wait(lock, [&remaining_tasks]()
+        { return remaining_tasks == 0; });
+    }
+
+    PlaybackWorkerPool(PlaybackWorkerPool const &) = delete;
+    PlaybackWorkerPool &operator=(PlaybackWorkerPool const &) = delete;
+
+private:
+    void run_worker()
+    {
+        std::unique_lock <std::mutex> lock(poolMutex);
+        while(true)
+        {
+            taskCondition.wait(lock, [this]()
+            { return stopping || !pendingTasks.empty(); });
+            if(pendingTasks.empty())
+            { return; }
+            std::function <void()> task = std::move(pendingTasks.front());
+            pendingTasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    uint32_t workerCount;
+    std::mutex poolMutex;
+    std::condition_variable taskCondition;
+    std::condition_variable doneCondition;
+    std::deque <std::function <void()>> pendingTasks;
+    bool stopping;
+    std::vector <std::thread> workers;
+};
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "ClientConfiguration.h"
+#include "chrono_metrics.h"
+
+namespace chronolog
+{
+
+// story acquisition attributes limiting the rate the story is logged at, 0 or absent for no limit
+const char STORY_ATTR_MAX_EVENTS_PER_SEC[] = "max_events_per_sec";
+const char STORY_ATTR_MAX_BYTES_PER_SEC[] = "max_bytes_per_sec";
+
+// Lock-free token bucket kept as the theoretical arrival time of the next token (GCRA) : taking tokens moves
+// it forward by their cost with a single compare-and-swap, a full bucket is a theoretical arrival time at
+// or before now, and the bucket holds at most burst_ns worth of tokens.
+// A request larger than the whole bucket is let through when the bucket is full and leaves it in debt.
+
+class TokenBucket
+{
+public:
+    // rate 0 is unlimited
+    TokenBucket(double tokens_per_sec, uint32_t burst_ms)
+        : nsPerToken(tokens_per_sec > 0 ? 1e9 / tokens_per_sec : 0)
+        , burstNs(static_cast<uint64_t>(burst_ms) * 1000000)
+        , theoreticalArrival(0)
+    {}
+
+    bool unlimited() const
+    { return (nsPerToken == 0); }
+
+    // takes count tokens and returns 0, or returns how long to wait for them without taking any
+    uint64_t try_acquire(uint64_t count, uint64_t now_ns)
+    {
+        if(unlimited())
+        { return 0; }
+        uint64_t cost = token_cost(count);
+        uint64_t arrival = theoreticalArrival.load(std::memory_order_relaxed);
+        while(true)
+        {
+            uint64_t start = std::max(arrival, now_ns);
+            if(start > now_ns && start + cost > now_ns + burstNs)
+            { return (cost > burstNs ? start - now_ns : start + cost - now_ns - burstNs); }
+            if(theoreticalArrival.compare_exchange_weak(arrival, start + cost, std::memory_order_relaxed))
+            { return 0; }
+        }
+    }
+
+    // gives back tokens taken by try_acquire
+    void refund(uint64_t count)
+    {
+        if(!unlimited())
+        { theoreticalArrival.fetch_sub(token_cost(count), std::memory_order_relaxed); }
+    }
+
+private:
+    uint64_t token_cost(uint64_t count) const
+    { return static_cast<uint64_t>(count * nsPerToken); }
+
+    double nsPerToken;
+    uint64_t burstNs;
+    std::atomic <uint64_t> theoreticalArrival;
+};
+
+// events per second and bytes per second limits of a story or of the whole client
+class RateLimiter
+{
+public:
+    RateLimiter(double events_per_sec, double bytes_per_sec, uint32_t burst_ms)
+        : eventBucket(events_per_sec, burst_ms)
+        , byteBucket(bytes_per_sec, burst_ms)
+    {}
+
+    // nullptr when neither limit is set, so that the unlimited stories skip the limiter altogether
+    static RateLimiter *CreateRateLimiter(double events_per_sec, double bytes_per_sec, uint32_t burst_ms)
+    {
+        if(events_per_sec <= 0 && bytes_per_sec <= 0)
+        { return nullptr; }
+        return new RateLimiter(events_per_sec, bytes_per_sec, burst_ms);
+    }
+
+    static RateLimiter *CreateStoryRateLimiter(std::map <std::string, std::string> const &story_attrs
+                                               , uint32_t burst_ms)
+    {
+        return CreateRateLimiter(story_rate_attr(story_attrs, STORY_ATTR_MAX_EVENTS_PER_SEC)
+                                 , story_rate_attr(story_attrs, STORY_ATTR_MAX_BYTES_PER_SEC), burst_ms);
+    }
+
+    uint64_t try_acquire(uint64_t events, uint64_t bytes, uint64_t now_ns)
+    {
+        uint64_t wait_ns = eventBucket.try_acquire(events, now_ns);
+        if(wait_ns > 0)
+        { return wait_ns; }
+        wait_ns = byteBucket.try_acquire(bytes, now_ns);
+        if(wait_ns > 0)
+        { eventBucket.refund(events); }
+        return wait_ns;
+    }
+
+    void refund(uint64_t events, uint64_t bytes)
+    {
+        eventBucket.refund(events);
+        byteBucket.refund(bytes);
+    }
+
+private:
+    RateLimiter(RateLimiter const &) = delete;
+    RateLimiter &operator=(RateLimiter const &) = delete;
+
+    static double story_rate_attr(std::map <std::string, std::string> const &story_attrs, char const *attr_name)
+    {
+        auto attr_iter = story_attrs.find(attr_name);
+        return (attr_iter == story_attrs.end() ? 0 : std::strtod((*attr_iter).second.c_str(), nullptr));
+    }
+
+    TokenBucket eventBucket;
+    TokenBucket byteBucket;
+};
+
+// What a writer over its story limit or over the client budget gets, the same for all the stories of the client :
+// - RATE_LIMIT_BLOCK : waits for the tokens, up to rate_limit_block_ms, and the events are dropped past it;
+// - RATE_LIMIT_DROP : the events are dropped right away;
+// - RATE_LIMIT_SAMPLE : one in rate_limit_sample_every of the events over the limit is still recorded,
+//   without being charged, so that a flooding story stays represented; the others are dropped.
+
+class RateLimitPolicy
+{
+public:
+    explicit RateLimitPolicy(ClientRecordingConf const &recording_conf
+                             , std::string const &metrics_labels = std::string())
+        : limitMode(recording_conf.rate_limit_mode())
+        , blockNs(static_cast<uint64_t>(recording_conf.rate_limit_block_ms()) * 1000000)
+        , sampleEvery(std::max <uint32_t>(1, recording_conf.rate_limit_sample_every()))
+        , overLimitEvents(0)
+        , droppedEvents(chrono_metrics::getInstance().counter("chronolog_rate_limit_dropped_events_total"
+                                                              , metrics_labels))
+        , sampledEvents(chrono_metrics::getInstance().counter("chronolog_rate_limit_sampled_events_total"
+                                                              , metrics_labels))
+        , blockedTime(chrono_metrics::getInstance().histogram("chronolog_rate_limit_block_ns", metrics_labels))
+    {}
+
+    // true if the events may be recorded ; both limiters may be nullptr
+    bool admit(RateLimiter *story_limiter, RateLimiter *client_limiter, uint64_t events, uint64_t bytes)
+    {
+        uint64_t first_try = 0;
+        while(true)
+        {
+            uint64_t now_ns = metrics_now_ns();
+            uint64_t wait_ns = (story_limiter != nullptr ? story_limiter->try_acquire(events, bytes, now_ns) : 0);
+            if(wait_ns == 0 && client_limiter != nullptr)
+            {
+                wait_ns = client_limiter->try_acquire(events, bytes, now_ns);
+                if(wait_ns > 0 && story_limiter != nullptr)
+                { story_limiter->refund(events, bytes); }
+            }
+            if(wait_ns == 0)
+            {
+                if(first_try != 0)
+                { blockedTime.record(now_ns - first_try); }
+                return true;
+            }
+
+            if(limitMode == RATE_LIMIT_BLOCK)
+            {
+                if(first_try == 0)
+                { first_try = now_ns; }
+                if(now_ns + wait_ns <= first_try + blockNs)
+                {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+                    continue;
+                }
+                blockedTime.record(now_ns - first_try);
+            }
+            else if(limitMode == RATE_LIMIT_SAMPLE
+                    && overLimitEvents.fetch_add(events, std::memory_order_relaxed) % sampleEvery < events)
+            {
+                sampledEvents.add(events);
+                return true;
+            }
+            droppedEvents.add(events);
+            return false;
+        }
+    }
+
+private:
+    RateLimitPolicy(RateLimitPolicy const &) = delete;
+    RateLimitPolicy &operator=(RateLimitPolicy const &) = delete;
+
+    RateLimitMode limitMode;
+    uint64_t blockNs;
+    uint32_t sampleEvery;
+    std::atomic <uint64_t> overLimitEvents;
+    ShardedCounter &droppedEvents;
+    ShardedCounter &sampledEvents;
+    LatencyHistogram &blockedTime;
+};
+
+}
+
+#endif
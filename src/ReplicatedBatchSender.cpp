@@ -0,0 +1,266 @@
+#include <cstdlib>
+
+#include "chronolog_errcode.h"
+#include "chrono_monitor.h"
+#include "ReplicatedBatchSender.h"
+#include "KeeperRecordingClient.h"
+
+namespace chl = chronolog;
+
+void chl::story_replication(std::map <std::string, std::string> const &story_attrs, std::size_t keeper_count
+                            , uint32_t &replicas, uint32_t &write_quorum)
+{
+    replicas = 1;
+    write_quorum = 1;
+    auto attr_iter = story_attrs.find(chl::STORY_ATTR_REPLICATION);
+    if(attr_iter == story_attrs.end())
+    { return; }
+
+    long requested_replicas = std::strtol((*attr_iter).second.c_str(), nullptr, 10);
+    if(requested_replicas <= 1 || keeper_count <= 1)
+    { return; }
+    if(static_cast<std::size_t>(requested_replicas) > keeper_count)
+    {
+        LOG_WARNING("[ReplicatedBatchSender] Story has {} keepers, replication {} is reduced to {}", keeper_count
+                    , requested_replicas, keeper_count);
+        requested_replicas = static_cast<long>(keeper_count);
+    }
+    replicas = static_cast<uint32_t>(requested_replicas);
+    write_quorum = replicas / 2 + 1;
+
+    attr_iter = story_attrs.find(chl::STORY_ATTR_WRITE_QUORUM);
+    if(attr_iter != story_attrs.end())
+    {
+        long requested_quorum = std::strtol((*attr_iter).second.c_str(), nullptr, 10);
+        if(requested_quorum >= 1 && requested_quorum <= static_cast<long>(replicas))
+        { write_quorum = static_cast<uint32_t>(requested_quorum); }
+        else
+        { LOG_WARNING("[ReplicatedBatchSender] Invalid write_quorum {}, using {}", (*attr_iter).second, write_quorum); }
+    }
+}
+
+/////////////////
+
+chl::ReplicatedBatchSender::ReplicatedBatchSender(uint32_t rpc_timeout_ms, std::string const &metrics_labels)
+        : stragglerCount(0)
+        , stopping(false)
+        , rpcTimeoutMs(rpc_timeout_ms)
+        , quorumLatency(chl::chrono_metrics::getInstance().histogram("chronolog_replica_quorum_latency_ns"
+                                                           , metrics_labels))
+        , replicaFailures(chl::chrono_metrics::getInstance().counter("chronolog_replica_send_failures_total"
+                                                           , metrics_labels))
+        , quorumFailures(chl::chrono_metrics::getInstance().counter("chronolog_replica_quorum_failures_total"
+                                                           , metrics_labels))
+        , hedgedSends(chl::chrono_metrics::getInstance().counter("chronolog_record_hedged_sends_total"
+                                                           , metrics_labels))
+        , pendingStragglers(chl::chrono_metrics::getInstance().gauge("chronolog_replica_stragglers"
+                                                           , metrics_labels))
+{
+    completerThread = std::thread(&ReplicatedBatchSender::run_replica_completer, this);
+}
+
+chl::ReplicatedBatchSender::~ReplicatedBatchSender()
+{
+    {
+        std::lock_guard <std::mutex> lock(stragglerMutex);
+        stopping = true;
+    }
+    stragglerCondition.notify_all();
+    if(completerThread.joinable())
+    { completerThread.join(); }
+}
+
+int chl::ReplicatedBatchSender::send_event_batch(std::vector <chl::KeeperRecordingClient*> const &keepers
+                                                 , std::size_t replicas, uint32_t write_quorum
+                                                 , std::string const &encoded_batch, uint32_t event_count
+                                                 , uint64_t hedge_delay_ns)
+{
+    uint64_t quorum_start = chl::metrics_now_ns();
+    auto quorum_state = std::make_shared <QuorumState>();
+
+    // all the replica RPCs are on the wire before the first response is looked at
+    std::vector <std::pair <chl::KeeperRecordingClient*, uint64_t>> failed_replicas;   // keeper, first sequence
+    std::size_t next_keeper = 0;
+    for(; next_keeper < replicas && next_keeper < keepers.size(); ++next_keeper)
+    { issue_replica(keepers[next_keeper], encoded_batch, event_count, quorum_state, failed_replicas); }
+    auto hedge_time = std::chrono::steady_clock::now() + std::chrono::nanoseconds(hedge_delay_ns);
+
+    std::unique_lock <std::mutex> quorum_lock(quorum_state->quorumMutex);
+    while(quorum_state->ackedReplicas < write_quorum)
+    {
+        bool replace = (quorum_state->ackedReplicas + quorum_state->waitingReplicas < write_quorum);
+        if(next_keeper < keepers.size() && (replace || std::chrono::steady_clock::now() >= hedge_time))
+        {
+            // only the sends issued by the hedge timer are hedges, the others replace failed replicas
+            if(!replace)
+            { hedgedSends.add(1); }
+            quorum_lock.unlock();
+            issue_replica(keepers[next_keeper], encoded_batch, event_count, quorum_state, failed_replicas);
+            ++next_keeper;
+            hedge_time = std::chrono::steady_clock::now() + std::chrono::nanoseconds(hedge_delay_ns);
+            quorum_lock.lock();
+            continue;
+        }
+        if(replace)
+        { break; }
+
+        // blocks until the next response, or until the hedge time if a hedge keeper is left
+        if(next_keeper < keepers.size())
+        { quorum_state->quorumCondition.wait_until(quorum_lock, hedge_time); }
+        else
+        { quorum_state->quorumCondition.wait(quorum_lock); }
+    }
+
+    bool batch_acknowledged = (quorum_state->ackedReplicas >= write_quorum);
+    uint32_t acked_replicas = quorum_state->ackedReplicas;
+    std::size_t waiting_replicas = quorum_state->waitingReplicas;
+    quorum_state->decided = true;
+    quorum_state->batchAcknowledged = batch_acknowledged;
+    std::vector <std::pair <chl::KeeperRecordingClient*, uint64_t>> decided_replicas;
+    decided_replicas.swap(quorum_state->respondedReplicas);
+    // the replicas still waited for complete their sequences with the quorum outcome when they respond
+    if(waiting_replicas > 0)
+    { pendingStragglers.add(waiting_replicas); }
+    quorum_lock.unlock();
+
+    decided_replicas.insert(decided_replicas.end(), failed_replicas.begin(), failed_replicas.end());
+    for(auto const &decided_replica: decided_replicas)
+    { decided_replica.first->ack_tracker().complete(decided_replica.second, event_count, batch_acknowledged); }
+
+    if(!batch_acknowledged)
+    {
+        quorumFailures.add(1);
+        LOG_ERROR("[ReplicatedBatchSender] Batch of {} events acknowledged by {} of {} keepers, write quorum {}"
+                  , event_count, acked_replicas, next_keeper, write_quorum);
+        return chl::CL_ERR_NOT_ACKNOWLEDGED;
+    }
+    quorumLatency.record(chl::metrics_now_ns() - quorum_start);
+    return chl::CL_SUCCESS;
+}
+
+bool chl::ReplicatedBatchSender::issue_replica(chl::KeeperRecordingClient *keeper_client
+                                               , std::string const &encoded_batch, uint32_t event_count
+                                               , std::shared_ptr <QuorumState> const &quorum_state
+                                               , std::vector <std::pair <chl::KeeperRecordingClient*, uint64_t>>
+                                                       &failed_replicas)
+{
+    uint64_t first_seq = keeper_client->ack_tracker().assign(event_count);
+    try
+    {
+        tl::async_response rpc_response = keeper_client->send_event_batch_async(encoded_batch);
+        {
+            std::lock_guard <std::mutex> quorum_lock(quorum_state->quorumMutex);
+            ++quorum_state->waitingReplicas;
+        }
+        std::lock_guard <std::mutex> lock(stragglerMutex);
+        pendingSends.emplace_back(keeper_client, first_seq, event_count, encoded_batch.size()
+                                  , std::move(rpc_response), quorum_state);
+        ++stragglerCount;
+        stragglerCondition.notify_all();
+        return true;
+    }
+    catch(tl::exception const &ex)
+    {
+        LOG_ERROR("[ReplicatedBatchSender] Failed to send event batch replica to {} exception: {}"
+                  , to_string(keeper_client->getKeeperId()), ex.what());
+    }
+    replicaFailures.add(1);
+    failed_replicas.emplace_back(keeper_client, first_seq);
+    return false;
+}
+
+int chl::ReplicatedBatchSender::wait_replica(ReplicaSend &replica_send)
+{
+    int return_code = replica_send.keeperClient->complete_event_batch_async(replica_send.rpcResponse
+                                                                            , replica_send.eventCount
+                                                                            , replica_send.batchSize
+                                                                            , replica_send.sendStart);
+    if(return_code != chl::CL_SUCCESS)
+    { replicaFailures.add(1); }
+    return return_code;
+}
+
+void chl::ReplicatedBatchSender::drain()
+{
+    std::unique_lock <std::mutex> lock(stragglerMutex);
+    stragglerCondition.wait(lock, [this]()
+    { return (stragglerCount == 0); });
+}
+
+void chl::ReplicatedBatchSender::complete_replica(ReplicaSend &replica_send, int return_code)
+{
+    QuorumState &quorum_state = *replica_send.quorumState;
+    bool decided = false;
+    bool batch_acknowledged = false;
+    {
+        std::lock_guard <std::mutex> quorum_lock(quorum_state.quorumMutex);
+        --quorum_state.waitingReplicas;
+        if(return_code == chl::CL_SUCCESS)
+        { ++quorum_state.ackedReplicas; }
+        decided = quorum_state.decided;
+        batch_acknowledged = quorum_state.batchAcknowledged;
+        if(!decided)
+        { quorum_state.respondedReplicas.emplace_back(replica_send.keeperClient, replica_send.firstSeq); }
+    }
+    quorum_state.quorumCondition.notify_all();
+
+    // a straggler : the sender already returned, its sequences are completed here
+    if(decided)
+    {
+        if(return_code != chl::CL_SUCCESS && batch_acknowledged)
+        {
+            LOG_WARNING("[ReplicatedBatchSender] Replica {} failed after the write quorum of its batch was reached"
+                        , to_string(replica_send.keeperClient->getKeeperId()));
+        }
+        replica_send.keeperClient->ack_tracker().complete(replica_send.firstSeq, replica_send.eventCount
+                                                          , batch_acknowledged);
+        pendingStragglers.sub(1);
+    }
+}
+
+void chl::ReplicatedBatchSender::run_replica_completer()
+{
+    std::unique_lock <std::mutex> lock(stragglerMutex);
+    while(true)
+    {
+        stragglerCondition.wait(lock, [this]()
+        { return (stopping || !pendingSends.empty()); });
+        if(pendingSends.empty())
+        { break; }
+
+        // without an RPC deadline the responses still outstanding at shutdown may never come
+        std::list <ReplicaSend> completed_sends;
+        bool give_up = (stopping && rpcTimeoutMs == 0);
+        for(auto send_iter = pendingSends.begin(); send_iter != pendingSends.end();)
+        {
+            auto next_iter = std::next(send_iter);
+            if(give_up || (*send_iter).rpcResponse.received())
+            { completed_sends.splice(completed_sends.end(), pendingSends, send_iter); }
+            send_iter = next_iter;
+        }
+        if(completed_sends.empty())
+        {
+            stragglerCondition.wait_for(lock, std::chrono::microseconds(REPLICA_POLL_US));
+            continue;
+        }
+        lock.unlock();
+
+        for(ReplicaSend &replica_send: completed_sends)
+        {
+            int return_code = chl::CL_ERR_UNKNOWN;
+            if(give_up)
+            {
+                LOG_WARNING("[ReplicatedBatchSender] Gave up on the response of replica {} at shutdown"
+                            , to_string(replica_send.keeperClient->getKeeperId()));
+                replicaFailures.add(1);
+            }
+            else
+            { return_code = wait_replica(replica_send); }
+            complete_replica(replica_send, return_code);
+        }
+
+        lock.lock();
+        stragglerCount -= completed_sends.size();
+        stragglerCondition.notify_all();
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef REPLICATED_BATCH_SENDER_H
+#define REPLICATED_BATCH_SENDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <thallium.hpp>
+
+#include "chronolog_types.h"
+#include "chrono_metrics.h"
+
+namespace tl = thallium;
+
+namespace chronolog
+{
+
+class KeeperRecordingClient;
+
+// story acquisition attributes of replicated recording : every event batch of the story is sent to
+// "replication" of the story keepers and is logged once "write_quorum" of them acknowledged it
+// (majority of the replicas by default)
+const char STORY_ATTR_REPLICATION[] = "replication";
+const char STORY_ATTR_WRITE_QUORUM[] = "write_quorum";
+
+// replicas and quorum requested by the story attributes, bounded by the number of story keepers ;
+// replicas is 1 for the stories that are not replicated
+void story_replication(std::map <std::string, std::string> const &story_attrs, std::size_t keeper_count
+                       , uint32_t &replicas, uint32_t &write_quorum);
+
+// Sends an encoded event batch to several keepers with async record_event_batch RPCs issued back to back,
+// and returns as soon as the quorum of acknowledgements is reached or can no longer be reached,
+// so the latency is that of the quorum-th fastest replica and not the sum of all of them.
+// The keepers past the replicas are hedges : the next one is sent the batch each time hedge_delay_ns passes
+// without the quorum ; a replica failure that leaves too few in flight to reach it is replaced right away.
+// The keeper responses are completed by a single completion thread, which collects the responses that
+// arrived and otherwise sleeps REPLICA_POLL_US between timed waits, while the sender blocks until a response
+// arrives or the hedge time passes. The replicas that did not respond by the time the quorum is decided are
+// completed in the background ; at destruction the ones still outstanding are waited for up to their RPC
+// timeout, or given up on right away if there is none, so a hung keeper does not hold the destructor.
+// The KeeperAckTracker of every replica completes the batch sequences with the quorum outcome,
+// a straggler failure after the quorum was reached is counted but does not make the batch lost.
+
+class ReplicatedBatchSender
+{
+public:
+    explicit ReplicatedBatchSender(uint32_t rpc_timeout_ms = 0, std::string const &metrics_labels = std::string());
+
+    ~ReplicatedBatchSender();
+
+    // CL_SUCCESS once write_quorum keepers acknowledged the batch, CL_ERR_NOT_ACKNOWLEDGED if they can not ;
+    // the first replicas keepers are sent the batch right away, the others are hedges
+    int send_event_batch(std::vector <KeeperRecordingClient*> const &keepers, std::size_t replicas
+                         , uint32_t write_quorum, std::string const &encoded_batch, uint32_t event_count
+                         , uint64_t hedge_delay_ns = 0);
+
+    // waits for the stragglers, called before a keeper client they may refer to is deleted
+    void drain();
+
+private:
+    ReplicatedBatchSender(ReplicatedBatchSender const &) = delete;
+    ReplicatedBatchSender &operator=(ReplicatedBatchSender const &) = delete;
+
+    // the completion thread looks for the arrived responses this often while replicas are outstanding
+    static constexpr uint32_t REPLICA_POLL_US = 50;
+
+    // responses of the replicas of one batch, shared by the sender and the completion thread
+    class QuorumState
+    {
+    public:
+        std::mutex quorumMutex;
+        std::condition_variable quorumCondition;
+        uint32_t ackedReplicas = 0;
+        std::size_t waitingReplicas = 0;
+        bool decided = false;
+        bool batchAcknowledged = false;   // quorum outcome, valid once decided
+        // replicas that responded before the quorum was decided : keeper, first sequence
+        std::vector <std::pair <KeeperRecordingClient*, uint64_t>> respondedReplicas;
+    };
+
+    class ReplicaSend
+    {
+    public:
+        ReplicaSend(KeeperRecordingClient *keeper_client, uint64_t first_seq, uint32_t event_count
+                    , std::size_t batch_size, tl::async_response &&response
+                    , std::shared_ptr <QuorumState> const &quorum_state)
+            : keeperClient(keeper_client)
+            , firstSeq(first_seq)
+            , eventCount(event_count)
+            , batchSize(batch_size)
+            , sendStart(metrics_now_ns())
+            , rpcResponse(std::move(response))
+            , quorumState(quorum_state)
+        {}
+
+        KeeperRecordingClient *keeperClient;
+        uint64_t firstSeq;
+        uint32_t eventCount;
+        std::size_t batchSize;
+        uint64_t sendStart;
+        tl::async_response rpcResponse;
+        std::shared_ptr <QuorumState> quorumState;
+    };
+
+    // false if the RPC could not be issued
+    bool issue_replica(KeeperRecordingClient *keeper_client, std::string const &encoded_batch, uint32_t event_count
+                       , std::shared_ptr <QuorumState> const &quorum_state
+                       , std::vector <std::pair <KeeperRecordingClient*, uint64_t>> &failed_replicas);
+
+    // waits for the keeper response, returns the keeper return code
+    int wait_replica(ReplicaSend &replica_send);
+
+    // records the replica outcome in its batch quorum state, or completes its sequences if the quorum was decided
+    void complete_replica(ReplicaSend &replica_send, int return_code);
+
+    void run_replica_completer();
+
+    std::mutex stragglerMutex;
+    std::condition_variable stragglerCondition;
+    std::list <ReplicaSend> pendingSends;   // issued replicas whose response did not arrive yet
+    std::size_t stragglerCount;   // issued replicas whose response was not processed yet
+    bool stopping;
+    uint32_t rpcTimeoutMs;   // 0 if the keeper RPCs have no deadline
+
+    LatencyHistogram &quorumLatency;
+    ShardedCounter &replicaFailures;
+    ShardedCounter &quorumFailures;
+    ShardedCounter &hedgedSends;
+    Gauge &pendingStragglers;
+
+    std::thread completerThread;
+};
+
+}
+
+#endif
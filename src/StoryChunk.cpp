@@ -37,6 +37,18 @@ int chl::StoryChunk::insertEvent(chl::LogEvent const &event)
         { return 0; }
     }
 
+int chl::StoryChunk::insertEvent(chl::LogEvent &&event)
+    {
+        if((event.time() >= startTime) && (event.time() < endTime))
+        {
+            chl::EventSequence event_sequence{event.time(), event.clientId, event.index()};
+            logEvents.emplace(event_sequence, std::move(event));
+            return 1;
+        }
+        else
+        { return 0; }
+    }
+
 // 
 //  merge into this master chunk all the events from the events map startign at iterator position merge_start
 //  return the merged even count
@@ -61,11 +73,12 @@ uint32_t chl::StoryChunk::mergeEvents(std::map<chl::EventSequence, chl::LogEvent
                             storyId, startTime);
     }
 
-    for(auto iter = merge_start; (iter != events.end()) && ((*iter).second.time() < endTime); ++iter)
+    // the merged events are erased from the map afterwards, so they are moved rather than copied
+    for(auto iter = events.erase(merge_start, merge_start); (iter != events.end()) && ((*iter).second.time() < endTime); ++iter)
     {
         LOG_TRACE("[StoryChunk] merge StoryId{} master chunk {} : merging event {}, master endTime{}", storyId,
                   startTime, (*iter).second.time(), endTime);
-        if(insertEvent((*iter).second) > 0)
+        if(insertEvent(std::move((*iter).second)) > 0)
         {
             if(merged_event_count == 0) 
             { first_merged = iter; }
@@ -118,7 +131,7 @@ uint32_t chl::StoryChunk::mergeEvents(chl::StoryChunk & other_chunk, uint64_t me
 
     std::map<chl::EventSequence, chl::LogEvent>::const_iterator first_merged, last_merged;
 
-    std::map<chl::EventSequence, chl::LogEvent>::const_iterator merge_start =
+    std::map<chl::EventSequence, chl::LogEvent>::iterator merge_start =
             (merge_start_time < startTime ? other_chunk.lower_bound(startTime)
                                           : other_chunk.lower_bound(merge_start_time));
 
@@ -130,7 +143,7 @@ uint32_t chl::StoryChunk::mergeEvents(chl::StoryChunk & other_chunk, uint64_t me
     {
         LOG_TRACE("[StoryChunk] merge StoryId{} master chunk {} : merging event {}, master endTime{}", storyId,
                   startTime, (*iter).second.time(), endTime);
-        if(insertEvent((*iter).second) > 0)
+        if(insertEvent(std::move((*iter).second)) > 0)
         {
             if(merged_event_count == 0) 
             { first_merged = iter; }
@@ -64,6 +64,13 @@ public:
     std::map <EventSequence, LogEvent>::const_iterator lower_bound(uint64_t chrono_time) const
     { return logEvents.lower_bound(EventSequence{chrono_time, 0, 0}); }
 
+    // mutable access for the owners that move the events out of a chunk they are about to discard
+    std::map <EventSequence, LogEvent>::iterator end()
+    { return logEvents.end(); }
+
+    std::map <EventSequence, LogEvent>::iterator lower_bound(uint64_t chrono_time)
+    { return logEvents.lower_bound(EventSequence{chrono_time, 0, 0}); }
+
     uint64_t firstEventTime() const
     { return (logEvents.empty() ? 0 : (*logEvents.begin()).second.time()); }
 
@@ -72,6 +79,9 @@ public:
 
     int insertEvent(LogEvent const &);
 
+    // the event is only moved from when it is inserted
+    int insertEvent(LogEvent &&);
+
     uint32_t mergeEvents(std::map <EventSequence, LogEvent> &events
                          , std::map <EventSequence, LogEvent>::const_iterator &merge_start);
 
@@ -8,21 +8,53 @@
 #include "StorytellerClient.h"
 #include "KeeperRecordingClient.h"
 #include "PlaybackQueryRpcClient.h"
+#include "EventBatch.h"
+#include "ReplicatedBatchSender.h"
+#include "NodeAggregator.h"
 
 namespace tl = thallium;
 
 namespace chl = chronolog;
 
 /////////////////////
+chronolog::StoryHandle::~StoryHandle()
+{}
 
-uint64_t chronolog::ChronologTimer::getTimestamp()
+int chronolog::StoryHandle::log_event(std::string &&record)
 {
-    return std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return log_event(static_cast<std::string const &>(record));
 }
 
-/////////////////////
-chronolog::StoryHandle::~StoryHandle()
-{}
+int chronolog::StoryHandle::log_events(std::string_view const *records, std::size_t count, bool)
+{
+    int logged_events = 0;
+    for(std::size_t i = 0; i < count; ++i)
+    { logged_events += log_event(std::string(records[i])); }
+    return logged_events;
+}
+
+int chronolog::StoryHandle::log_events(struct iovec const *records, std::size_t count, bool)
+{
+    int logged_events = 0;
+    for(std::size_t i = 0; i < count; ++i)
+    { logged_events += log_event(std::string(static_cast<char const*>(records[i].iov_base), records[i].iov_len)); }
+    return logged_events;
+}
+
+chronolog::StoryWriter chronolog::StoryHandle::get_writer()
+{
+    return chl::StoryWriter(this, nullptr);
+}
+
+int chronolog::StoryHandle::log_deferred_event(chl::FormatId const &, std::string const &record)
+{
+    return log_event(record);
+}
+
+int chronolog::StoryHandle::flush(std::chrono::steady_clock::time_point const &)
+{
+    return chl::CL_SUCCESS;
+}
 
 ////////////////////
 template <class KeeperChoicePolicy>
@@ -30,6 +62,7 @@ template <class KeeperChoicePolicy>
 chronolog::StoryWritingHandle <KeeperChoicePolicy>::~StoryWritingHandle()
 {
     delete keeperChoicePolicy;
+    delete storyLimiter;
 }
 
 ////////////////////
@@ -37,7 +70,12 @@ template <class KeeperChoicePolicy>
 void
 chronolog::StoryWritingHandle <KeeperChoicePolicy>::addRecordingClient(chronolog::KeeperRecordingClient*keeperClient)
 {
+    if(nullptr == keeperClient)
+    { return; }
     storyKeepers.push_back(keeperClient);
+    // failures that happened before the story was attached to the keeper are not reported by its flush
+    std::lock_guard <std::mutex> lock(flushMutex);
+    flushedErrorSeqs[keeperClient] = keeperClient->ack_tracker().error_seq();
 }
 
 ///////////////////
@@ -51,6 +89,10 @@ chronolog::StoryWritingHandle <KeeperChoicePolicy>::removeRecordingClient(chrono
     {
         if((*iter)->getKeeperId() == keeper_id_card)
         {
+            {
+                std::lock_guard <std::mutex> lock(flushMutex);
+                flushedErrorSeqs.erase(*iter);
+            }
             storyKeepers.erase(iter);
             break;
         }
@@ -73,25 +115,244 @@ void chronolog::StoryWritingHandle <KeeperChoicePolicy>::detachPlaybackQueryClie
 template <class KeeperChoicePolicy>
 int chronolog::StoryWritingHandle <KeeperChoicePolicy>::log_event(std::string const &event_record)
 {
+    return record_event(theClient.getTimestamp(), theClient.get_event_index(), std::string(event_record));
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::log_event(std::string &&event_record)
+{
+    return record_event(theClient.getTimestamp(), theClient.get_event_index(), std::move(event_record));
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::record_event(chl::chrono_time event_time
+                                                                    , chl::chrono_index event_index
+                                                                    , std::string &&event_record)
+{
+    if(!theClient.accepting_events(1))
+    { return 0; }
+    if(rate_limited() && !admit_events(1, event_record.size()))
+    { return 0; }
+
+    if(replicaCount > 1 || hedgeRecords)
+    {
+        std::size_t batch_bytes = event_record.size();
+        if(!acquire_memory(batch_bytes))
+        { return 0; }
+        chl::EventBatchEncoder event_batch(storyId, theClient.getClientId(), lzCompression);
+        event_batch.add_event(event_time, event_index, event_record);
+        int return_code = send_replicated_batch(event_batch, event_time);
+        release_memory(batch_bytes);
+        return (return_code == chl::CL_SUCCESS ? 1 : 0);
+    }
 
-    chronolog::LogEvent log_event(storyId, theClient.getTimestamp(), theClient.getClientId()
-                                  , theClient.get_event_index(), event_record);
+    chronolog::LogEvent log_event(storyId, event_time, theClient.getClientId(), event_index, std::move(event_record));
 
     auto keeperRecordingClient = keeperChoicePolicy->chooseKeeper(storyKeepers, log_event.time());
     if(nullptr == keeperRecordingClient)   //very unlikely...
     {
-        LOG_WARNING("[StoryWritingHandle] No keeper selected for logging event: {}", event_record);
+        LOG_WARNING("[StoryWritingHandle] No keeper selected for logging event: {}", log_event.getRecord());
         return 0;
     }
 
-    // INNA: make send event returm 0 in case of tl RPC failure ....
-    
-    keeperRecordingClient->send_event_msg(log_event);
+    // node aggregation : the node forwarder sends the event, a full ring falls back to the direct send
+    chl::NodeAggregator *node_aggregator = theClient.node_aggregator();
+    if(node_aggregator != nullptr
+       && node_aggregator->submit_event(keeperRecordingClient->getKeeperId(), log_event, lzCompression, eventPriority)
+          == chl::CL_SUCCESS)
+    { return 1; }
+
+    // the keeper batcher charges the events it stages, a direct send holds the event until it completes
+    std::size_t in_flight_bytes = (keeperRecordingClient->batching_enabled() ? 0 : log_event.getRecord().size());
+    if(!acquire_memory(in_flight_bytes))
+    { return 0; }
+    int return_code = keeperRecordingClient->submit_event(log_event, lzCompression, eventPriority);
+    release_memory(in_flight_bytes);
+
+    // 0 indicates a failure to log : the RPC failed, the keeper batcher is shutting down or shed the event,
+    // or the memory budget had no room for it
+    if(return_code != chl::CL_SUCCESS)
+    { return 0; }
 
     //INNA: we probably want to expose the timestamp as the return value here
-    // 0 indicates a failure to log as invalid timestamp
     return 1;
 }
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::log_deferred_event(chl::FormatId const &format_id
+                                                                          , std::string const &record)
+{
+    uint32_t slot = format_id.slot - 1;
+    bool tracked = (format_id.slot != 0 && slot < definedFormats.size() * 64);
+    uint64_t slot_bit = uint64_t(1) << (slot % 64);
+    bool defined = false;
+    if(tracked)
+    { defined = (definedFormats[slot / 64].fetch_or(slot_bit, std::memory_order_relaxed) & slot_bit) != 0; }
+    if(!defined)
+    {
+        std::string definition_record;
+        bool definition_logged = (chl::make_format_definition(format_id, definition_record) == chl::CL_SUCCESS
+                                  && log_event(definition_record) != 0);
+        // a definition that was dropped, shed or failed is sent again with the next record of the format
+        if(!definition_logged && tracked)
+        { definedFormats[slot / 64].fetch_and(~slot_bit, std::memory_order_relaxed); }
+    }
+    return log_event(record);
+}
+
+namespace
+{
+inline char const *record_data(std::string_view const &record)
+{ return record.data(); }
+
+inline std::size_t record_size(std::string_view const &record)
+{ return record.size(); }
+
+inline char const *record_data(struct iovec const &record)
+{ return static_cast<char const*>(record.iov_base); }
+
+inline std::size_t record_size(struct iovec const &record)
+{ return record.iov_len; }
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::log_events(std::string_view const *records, std::size_t count
+                                                                  , bool timestamp_each)
+{
+    return record_events(records, count, timestamp_each);
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::log_events(struct iovec const *records, std::size_t count
+                                                                  , bool timestamp_each)
+{
+    return record_events(records, count, timestamp_each);
+}
+
+template <class KeeperChoicePolicy>
+template <class Record>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::record_events(Record const *records, std::size_t count
+                                                                     , bool timestamp_each)
+{
+    if(count == 0 || count > INT_MAX)
+    { return 0; }
+
+    // keepers without record_event_batch are sent the events one by one, with the same timestamps and indices ;
+    // so are the unreplicated stories with the keeper batchers, whose priority lanes and adaptive batching
+    // then apply to them as to the other stories
+    if(!batchRpc || (theClient.recording_conf().batching() && replicaCount <= 1 && !hedgeRecords))
+    {
+        chl::chrono_index first_index = theClient.reserve_event_indices(static_cast<uint32_t>(count));
+        chl::chrono_time event_time = theClient.getTimestamp();
+        int logged_events = 0;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(timestamp_each && i != 0)
+            { event_time = theClient.getTimestamp(); }
+            logged_events += record_event(event_time, first_index + static_cast<chl::chrono_index>(i)
+                                          , std::string(record_data(records[i]), record_size(records[i])));
+        }
+        return logged_events;
+    }
+
+    if(!theClient.accepting_events(count))
+    { return 0; }
+
+    uint64_t byte_count = 0;
+    for(std::size_t i = 0; i < count; ++i)
+    { byte_count += record_size(records[i]); }
+    if(rate_limited() && !admit_events(count, byte_count))
+    { return 0; }
+    // the encoded batch is held until it is sent
+    if(!acquire_memory(byte_count))
+    { return 0; }
+
+    chl::chrono_index first_index = theClient.reserve_event_indices(static_cast<uint32_t>(count));
+    chl::chrono_time first_time = theClient.getTimestamp();
+    chl::chrono_time event_time = first_time;
+
+    chl::EventBatchEncoder event_batch(storyId, theClient.getClientId(), lzCompression);
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        if(timestamp_each && i != 0)
+        { event_time = theClient.getTimestamp(); }
+        event_batch.add_event(event_time, first_index + static_cast<chl::chrono_index>(i), record_data(records[i])
+                              , record_size(records[i]));
+    }
+
+    int return_code = chl::CL_ERR_NO_KEEPERS;
+    if(replicaCount > 1 || hedgeRecords)
+    { return_code = send_replicated_batch(event_batch, first_time); }
+    else
+    {
+        auto keeperRecordingClient = keeperChoicePolicy->chooseKeeper(storyKeepers, first_time);
+        if(nullptr != keeperRecordingClient)
+        { return_code = keeperRecordingClient->send_event_batch(event_batch); }
+        else
+        { LOG_WARNING("[StoryWritingHandle] No keeper selected for logging a batch of {} events", count); }
+    }
+    release_memory(byte_count);
+
+    return (return_code == chl::CL_SUCCESS ? static_cast<int>(count) : 0);
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::send_replicated_batch(chl::EventBatchEncoder const &event_batch
+                                                                             , chl::chrono_time event_time)
+{
+    std::vector <chl::KeeperRecordingClient*> keepers;
+    keeperChoicePolicy->chooseKeepers(storyKeepers, event_time, replicaCount + (hedgeRecords ? 1 : 0), keepers);
+    if(keepers.size() < writeQuorum || nullptr == theClient.replicated_sender())
+    {
+        LOG_WARNING("[StoryWritingHandle] Story {} has {} keepers left, write quorum {} can not be reached", story
+                    , keepers.size(), writeQuorum);
+        return chl::CL_ERR_NO_KEEPERS;
+    }
+
+    // the batch is hedged after the send latency percentile of the first replica, once it is known
+    uint64_t hedge_delay_ns = 0;
+    if(keepers.size() > replicaCount)
+    {
+        hedge_delay_ns = keepers.front()->hedge_delay_ns(theClient.rpc_conf().hedge_percentile());
+        if(hedge_delay_ns == 0)
+        { keepers.resize(replicaCount); }
+    }
+
+    std::string encoded_batch;
+    event_batch.encode(encoded_batch);
+    return theClient.replicated_sender()->send_event_batch(keepers, replicaCount, writeQuorum, encoded_batch
+                                                           , event_batch.event_count(), hedge_delay_ns);
+}
+
+template <class KeeperChoicePolicy>
+int chronolog::StoryWritingHandle <KeeperChoicePolicy>::flush(std::chrono::steady_clock::time_point const &deadline)
+{
+    std::lock_guard <std::mutex> lock(flushMutex);
+
+    int return_code = chl::CL_SUCCESS;
+    if(theClient.node_aggregator() != nullptr)
+    { return_code = theClient.node_aggregator()->flush(deadline); }
+    for(chl::KeeperRecordingClient*keeper_client: storyKeepers)
+    {
+        // the events logged on this handle before the call were all assigned keeper sequences by now,
+        // the flush waits for the events of the other stories sharing the keeper as well
+        int flush_return = keeper_client->flush(keeper_client->ack_tracker().last_assigned(), deadline);
+        if(flush_return != chl::CL_SUCCESS)
+        {
+            return_code = (return_code == chl::CL_SUCCESS ? flush_return : return_code);
+            continue;
+        }
+        uint64_t error_seq = keeper_client->ack_tracker().error_seq();
+        uint64_t &flushed_error_seq = flushedErrorSeqs[keeper_client];
+        if(error_seq != flushed_error_seq)
+        {
+            flushed_error_seq = error_seq;
+            return_code = (return_code == chl::CL_SUCCESS ? chl::CL_ERR_NOT_ACKNOWLEDGED : return_code);
+        }
+    }
+    return return_code;
+}
+
 /////////////////////
 /*
 template <class KeeperChoicePolicy>
@@ -110,9 +371,14 @@ int chronolog::StoryWritingHandle<KeeperChoicePolicy>::playback_story(uint64_t s
     if(nullptr == playbackQueryClient)
     { return chl::CL_ERR_NO_PLAYERS; }
 
-    playbackQueryClient->send_story_playback_request(chronicle, story, start_time, end_time);
+    uint32_t query_id = 0;
+    int return_code = theClient.send_playback_request(playbackQueryClient, chronicle, story, start_time, end_time
+                                                      , query_id);
+
+    // always collect, so that the query is retired even when the request failed half way
+    theClient.collect_playback_response(query_id, playback_events);
 
-return chl::CL_SUCCESS;
+    return return_code;
 }
 
 //////////////////////////////////////////
@@ -131,6 +397,17 @@ chronolog::StorytellerClient::~StorytellerClient()
         }
         acquiredStoryHandles.clear();
   */  }
+    // the forwarder sends through the keeperRecordingClients
+    delete nodeAggregator;
+    nodeAggregator = nullptr;
+
+    delete clientLimiter;
+    clientLimiter = nullptr;
+
+    // the replica stragglers refer to the keeperRecordingClients
+    delete replicatedSender;
+    replicatedSender = nullptr;
+
     // stop & delete keeperRecordingClients
     std::lock_guard <std::mutex> lock(recordingClientMapMutex);
     for(auto keeper_client: recordingClientMap)
@@ -146,19 +423,143 @@ chronolog::StorytellerClient::~StorytellerClient()
     playbackQueryClientMap.clear();
 }
 
-int chronolog::StorytellerClient::get_event_index()
+chronolog::chrono_index chronolog::StorytellerClient::get_event_index()
 {
-    // we only aqcuire mutex in the rare case when
-    // the atomic index has reached INT_MAX value
-    // otherwise proceed lock-free
-    if((atomic_index == INT_MAX))
+    // lock-free, the index wraps around with the uint32_t counter
+    return reserve_event_indices(1);
+}
+
+int chronolog::StorytellerClient::flush(std::chrono::steady_clock::time_point const &deadline)
+{
+    // the node forwarder takes the recordingClientMapMutex to find its keepers
+    int return_code = (nodeAggregator != nullptr ? nodeAggregator->flush(deadline) : chl::CL_SUCCESS);
+    if(return_code != chl::CL_SUCCESS)
+    { LOG_WARNING("[StorytellerClient] Flush of the node aggregator ring did not complete : {}", return_code); }
+
+    // as in drain, the keeper clients are waited for without the recordingClientMapMutex
+    std::lock_guard <std::mutex> removal_lock(keeperRemovalMutex);
+    std::vector <std::pair <std::pair <uint32_t, uint16_t>, KeeperRecordingClient*>> flushed_keepers;
     {
         std::lock_guard <std::mutex> lock(recordingClientMapMutex);
-        //recheck when mutex is acquired, only one thread changes the value
-        if(atomic_index == INT_MAX)
-        { atomic_index = 0; }
+        flushed_keepers.assign(recordingClientMap.begin(), recordingClientMap.end());
     }
-    return ++atomic_index;
+
+    for(auto const &keeper_client: flushed_keepers)
+    {
+        int flush_return = keeper_client.second->flush(keeper_client.second->ack_tracker().last_assigned(), deadline);
+        if(flush_return != chl::CL_SUCCESS)
+        {
+            LOG_WARNING("[StorytellerClient] Flush of {} did not complete : {}"
+                        , to_string(keeper_client.second->getKeeperId()), flush_return);
+            return_code = (return_code == chl::CL_SUCCESS ? flush_return : return_code);
+            continue;
+        }
+        uint64_t error_seq = keeper_client.second->ack_tracker().error_seq();
+        uint64_t failed_events = 0;
+        {
+            std::lock_guard <std::mutex> error_lock(flushedErrorMutex);
+            uint64_t &flushed_error_seq = flushedErrorSeqs[keeper_client.first];
+            failed_events = error_seq - flushed_error_seq;
+            flushed_error_seq = error_seq;
+        }
+        if(failed_events != 0)
+        {
+            LOG_WARNING("[StorytellerClient] {} events sent to {} were not acknowledged since the previous flush"
+                        , failed_events, to_string(keeper_client.second->getKeeperId()));
+            return_code = (return_code == chl::CL_SUCCESS ? chl::CL_ERR_NOT_ACKNOWLEDGED : return_code);
+        }
+    }
+    return return_code;
+}
+
+int chronolog::StorytellerClient::drain(std::chrono::steady_clock::time_point const &deadline)
+{
+    uint64_t drain_start = chl::metrics_now_ns();
+    acceptingEvents.store(false);
+
+    int return_code = chl::CL_SUCCESS;
+    uint64_t lost_events = 0;
+    if(nodeAggregator != nullptr && (return_code = nodeAggregator->flush(deadline)) != chl::CL_SUCCESS)
+    {
+        // the events left in the ring are forwarded later by the node forwarder, or lost with the node
+        lost_events += nodeAggregator->unforwarded_events();
+        LOG_WARNING("[StorytellerClient] Drain of the node aggregator ring did not complete : {}, {} events left"
+                    , return_code, nodeAggregator->unforwarded_events());
+    }
+
+    // the keeper clients are waited for without the recordingClientMapMutex, which the node forwarder
+    // and the story acquisitions need ; keeperRemovalMutex keeps them from being deleted meanwhile
+    std::lock_guard <std::mutex> removal_lock(keeperRemovalMutex);
+    struct DrainedKeeper
+    {
+        std::pair <uint32_t, uint16_t> endpoint;
+        KeeperRecordingClient *keeperClient;
+        uint64_t drainSeq;      // last sequence assigned at drain start
+        uint64_t pendingEvents; // not acknowledged yet at drain start
+    };
+    std::vector <DrainedKeeper> drained_keepers;
+    {
+        std::lock_guard <std::mutex> lock(recordingClientMapMutex);
+        // all the keeper batchers send at once, so the waits below overlap with every keeper
+        for(auto const &keeper_client: recordingClientMap)
+        {
+            KeeperAckTracker &ack_tracker = keeper_client.second->ack_tracker();
+            uint64_t drain_seq = ack_tracker.last_assigned();
+            uint64_t acknowledged = ack_tracker.acknowledged();
+            drained_keepers.push_back({keeper_client.first, keeper_client.second, drain_seq
+                                       , (acknowledged < drain_seq ? drain_seq - acknowledged : 0)});
+            keeper_client.second->request_flush();
+        }
+    }
+
+    uint64_t total_events = 0;
+    for(auto const &drained_keeper: drained_keepers)
+    {
+        KeeperRecordingClient *keeper_client = drained_keeper.keeperClient;
+        KeeperAckTracker &ack_tracker = keeper_client->ack_tracker();
+        uint64_t drain_seq = drained_keeper.drainSeq;
+        if(ack_tracker.wait(drain_seq, deadline) != chl::CL_SUCCESS)
+        { return_code = chl::CL_ERR_TIMEOUT; }
+
+        // past the deadline the staged events are given up, the in flight sends are left to complete
+        uint64_t discarded_events = keeper_client->discard_pending();
+        uint64_t acknowledged = ack_tracker.acknowledged();
+        // the sends still in flight, the discarded events are counted with the failed ones
+        uint64_t unconfirmed_events = (acknowledged < drain_seq ? drain_seq - acknowledged : 0);
+        unconfirmed_events = (unconfirmed_events > discarded_events ? unconfirmed_events - discarded_events : 0);
+        uint64_t error_seq = ack_tracker.error_seq();
+        uint64_t failed_events = 0;
+        {
+            std::lock_guard <std::mutex> error_lock(flushedErrorMutex);
+            uint64_t &flushed_error_seq = flushedErrorSeqs[drained_keeper.endpoint];
+            failed_events = error_seq - flushed_error_seq;
+            flushed_error_seq = error_seq;
+        }
+
+        total_events += drained_keeper.pendingEvents;
+        if(failed_events + unconfirmed_events > 0)
+        {
+            LOG_WARNING("[StorytellerClient] Drain of {} lost events : {} failed or discarded, {} not confirmed"
+                        , to_string(keeper_client->getKeeperId()), failed_events, unconfirmed_events);
+            lost_events += failed_events + unconfirmed_events;
+            return_code = (return_code == chl::CL_SUCCESS ? chl::CL_ERR_NOT_ACKNOWLEDGED : return_code);
+        }
+    }
+
+    uint64_t drain_ns = chl::metrics_now_ns() - drain_start;
+    chl::chrono_metrics::getInstance().histogram("chronolog_drain_duration_ns", metricsLabels).record(drain_ns);
+    chl::chrono_metrics::getInstance().counter("chronolog_drain_lost_events_total", metricsLabels).add(lost_events);
+    if(lost_events > 0)
+    {
+        LOG_WARNING("[StorytellerClient] Drained {} keepers in {} ms, {} of {} events pending were lost"
+                    , drained_keepers.size(), drain_ns / 1000000, lost_events, total_events);
+    }
+    else
+    {
+        LOG_INFO("[StorytellerClient] Drained {} keepers in {} ms, all {} events pending were acknowledged"
+                 , drained_keepers.size(), drain_ns / 1000000, total_events);
+    }
+    return return_code;
 }
 ////////////////
 
@@ -170,7 +571,15 @@ int chronolog::StorytellerClient::addKeeperRecordingClient(chronolog::KeeperIdCa
     try
     {
         chronolog::KeeperRecordingClient*keeperRecordingClient = chronolog::KeeperRecordingClient::CreateKeeperRecordingClient(
-                theClientQueryService.get_service_engine(), keeper_id_card);
+                theClientQueryService.get_service_engine(), keeper_id_card, rpcConf.rpc_timeout_ms(), metricsLabels);
+        if(nullptr == keeperRecordingClient)
+        {
+            LOG_ERROR("[StorytellerClient] Failed to create KeeperRecordingClient for {}", to_string(keeper_id_card));
+            return 0;
+        }
+
+        if(recordingConf.batching())
+        { keeperRecordingClient->enable_batching(clientId, recordingConf, memoryBudget); }
 
         auto insert_return = recordingClientMap.insert(
                 std::pair <std::pair <uint32_t, uint16_t>, chronolog::KeeperRecordingClient*>(
@@ -185,6 +594,7 @@ int chronolog::StorytellerClient::addKeeperRecordingClient(chronolog::KeeperIdCa
     catch(tl::exception const &ex)
     {
         LOG_ERROR("[StorytellerClient] Failed to create KeeperRecordingClient for {}", to_string(keeper_id_card));
+        return 0;
     }
 
     // state = RUNNING;
@@ -193,8 +603,36 @@ int chronolog::StorytellerClient::addKeeperRecordingClient(chronolog::KeeperIdCa
 }
 /////////////////
 
+chl::KeeperRecordingClient *chronolog::StorytellerClient::getKeeperRecordingClient(
+        chronolog::KeeperIdCard const &keeper_id_card)
+{
+    {
+        std::lock_guard <std::mutex> lock(recordingClientMapMutex);
+        auto keeper_client_iter = recordingClientMap.find(
+                keeper_id_card.getRecordingServiceId().get_service_endpoint());
+        if(keeper_client_iter != recordingClientMap.end())
+        { return (*keeper_client_iter).second; }
+    }
+    if(addKeeperRecordingClient(keeper_id_card) == 0)
+    { return nullptr; }
+
+    std::lock_guard <std::mutex> lock(recordingClientMapMutex);
+    auto keeper_client_iter = recordingClientMap.find(keeper_id_card.getRecordingServiceId().get_service_endpoint());
+    return (keeper_client_iter != recordingClientMap.end() ? (*keeper_client_iter).second : nullptr);
+}
+
+void chronolog::StorytellerClient::start_node_aggregation(chronolog::ClientAggregationConf const &aggregation_conf)
+{
+    nodeAggregator = chl::NodeAggregator::CreateNodeAggregator(*this, aggregation_conf);
+    if(nullptr == nodeAggregator)
+    { LOG_WARNING("[StorytellerClient] Node aggregation is not available, the events are sent directly"); }
+}
+
+/////////////////
+
 int chronolog::StorytellerClient::removeKeeperRecordingClient(chronolog::KeeperIdCard const &keeper_id_card)
 {
+    std::lock_guard <std::mutex> removal_lock(keeperRemovalMutex);
     std::lock_guard <std::mutex> lock(recordingClientMapMutex);
 
     // stop & delete keeperRecordingClient before erasing keeper_process entry
@@ -202,7 +640,13 @@ int chronolog::StorytellerClient::removeKeeperRecordingClient(chronolog::KeeperI
         
     if(keeper_client_iter != recordingClientMap.end())
     {
+        if(nullptr != replicatedSender)
+        { replicatedSender->drain(); }
         delete (*keeper_client_iter).second;
+        {
+            std::lock_guard <std::mutex> error_lock(flushedErrorMutex);
+            flushedErrorSeqs.erase((*keeper_client_iter).first);
+        }
         recordingClientMap.erase(keeper_client_iter);
     }
 
@@ -221,15 +665,17 @@ chronolog::StorytellerClient::findStoryWritingHandle(ChronicleName const &chroni
     std::lock_guard <std::mutex> lock(acquiredStoryMapMutex);
 
     auto story_record_iter = acquiredStoryHandles.find(std::pair <std::string, std::string>(chronicle, story));
+    // this lookup is on the AcquireStory path and a miss is the expected outcome for a new story,
+    // so it is only traced at debug level
     if(story_record_iter != acquiredStoryHandles.end())
     {
-        LOG_INFO("[StorytellerClient::findStoryWritingHandle] Found StoryHandle for Chronicle: '{}' and Story: '{}'."
+        LOG_DEBUG("[StorytellerClient::findStoryWritingHandle] Found StoryHandle for Chronicle: '{}' and Story: '{}'."
              , chronicle, story);
         return ((*story_record_iter).second);
     }
     else
     {
-        LOG_WARNING("[StorytellerClient::findStoryWritingHandle] StoryHandle not found for Chronicle: '{}' and Story: '{}'."
+        LOG_DEBUG("[StorytellerClient::findStoryWritingHandle] StoryHandle not found for Chronicle: '{}' and Story: '{}'."
              , chronicle, story);
         return (nullptr);
     }
@@ -241,7 +687,8 @@ chronolog::StoryHandle*
 chronolog::StorytellerClient::initializeStoryWritingHandle(ChronicleName const &chronicle, StoryName const &story
                                                            , StoryId const &story_id
                                                            , std::vector <KeeperIdCard> const &vectorOfKeepers
-                        , chl::ServiceId const & player_card)
+                        , chl::ServiceId const & player_card
+                        , std::map <std::string, std::string> const & story_attrs)
 //INNA: TODO :KeeperChoicePolicy will have to be communicated here as well ....
 {
     std::lock_guard <std::mutex> lock(acquiredStoryMapMutex);
@@ -253,9 +700,28 @@ chronolog::StorytellerClient::initializeStoryWritingHandle(ChronicleName const &
         return story_record_iter->second;
     }
 
+    uint32_t replicas = 1;
+    uint32_t write_quorum = 1;
+    bool batch_rpc = chl::keeper_batch_rpc_enabled(story_attrs);
+    chl::story_replication(story_attrs, vectorOfKeepers.size(), replicas, write_quorum);
+    if(replicas > 1 && !batch_rpc)
+    {
+        LOG_WARNING("[StorytellerClient] Story {} {} : replication needs the keeper_batch_rpc attribute, the events"
+                    " are recorded by a single keeper", chronicle, story);
+        replicas = 1;
+        write_quorum = 1;
+    }
+    // the keeper batcher path is not hedged, its batches mix the stories of several keeper sets ;
+    // the replicated sender relies on record_event_batch
+    bool hedging = (rpcConf.hedging() && batch_rpc && !recordingConf.batching() && vectorOfKeepers.size() > replicas);
+    if((replicas > 1 || hedging) && nullptr == replicatedSender)
+    { replicatedSender = new chl::ReplicatedBatchSender(rpcConf.rpc_timeout_ms(), metricsLabels); }
+
     // create new StoryWritingHandle & initialize it's keeperClients vector    
     chronolog::StoryWritingHandle <RoundRobinKeeperChoice>*storyWritingHandle = new StoryWritingHandle <RoundRobinKeeperChoice>(
-            *this, chronicle, story, story_id);
+            *this, chronicle, story, story_id, chl::lz_compression_requested(story_attrs), replicas, write_quorum
+            , hedging, chl::RateLimiter::CreateStoryRateLimiter(story_attrs, recordingConf.rate_limit_burst_ms())
+            , chl::story_priority(story_attrs), batch_rpc);
 
     for(KeeperIdCard keeper_id_card: vectorOfKeepers)
     {
@@ -283,6 +749,7 @@ chronolog::StorytellerClient::initializeStoryWritingHandle(ChronicleName const &
         if(nullptr != playbackQueryClient)
         {
             storyWritingHandle->attachPlaybackQueryClient(playbackQueryClient);
+            theClientQueryService.addStoryPlayer(chronicle, story, playbackQueryClient);
             LOG_DEBUG("[StorytellerClient] PlaybackQueryClient {}  attached to StoryHandle {} {}", chl::to_string(player_card),chronicle,story);
         }
     }
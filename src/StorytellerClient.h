@@ -2,6 +2,7 @@
 #define STORYTELLER_CLIENT_H
 
 
+#include <array>
 #include <atomic>
 #include <map>
 
@@ -10,6 +11,10 @@
 #include "KeeperIdCard.h"
 #include "chronolog_types.h"
 #include "chronolog_client.h"
+#include "ClientConfiguration.h"
+#include "RateLimiter.h"
+#include "KeeperEventBatcher.h"
+#include "MemoryBudget.h"
 
 #include "ClientQueryService.h"
 
@@ -19,11 +24,15 @@ namespace chronolog
 class ChronologTimer
 {
 public:
-    uint64_t getTimestamp();
+    uint64_t getTimestamp()
+    { return event_timestamp(); }
 };
 
 class KeeperRecordingClient;
 class PlaybackQueryRpcClient;
+class ReplicatedBatchSender;
+class EventBatchEncoder;
+class NodeAggregator;
 
 class RoundRobinKeeperChoice
 {
@@ -33,6 +42,18 @@ public:
     {
         return vectorOfKeepers[chrono_tick % vectorOfKeepers.size()];
     }
+
+    // count consecutive keepers starting with the one chooseKeeper would pick
+    void chooseKeepers(std::vector <KeeperRecordingClient*> const &vectorOfKeepers, uint64_t chrono_tick
+                       , uint32_t count, std::vector <KeeperRecordingClient*> &chosenKeepers)
+    {
+        chosenKeepers.clear();
+        if(vectorOfKeepers.empty())
+        { return; }
+        std::size_t first_keeper = chrono_tick % vectorOfKeepers.size();
+        for(std::size_t i = 0; i < count && i < vectorOfKeepers.size(); ++i)
+        { chosenKeepers.push_back(vectorOfKeepers[(first_keeper + i) % vectorOfKeepers.size()]); }
+    }
 };
 
 
@@ -40,11 +61,29 @@ class StorytellerClient
 {
 public:
     StorytellerClient(ChronologTimer &chronolog_timer, ClientQueryService & clientQueryService
-           ,  ClientId const &client_id)
+           ,  ClientId const &client_id, ClientRecordingConf const &recording_conf = ClientRecordingConf()
+           ,  ClientRpcConf const &rpc_conf = ClientRpcConf(), MemoryBudget *memory_budget = nullptr
+           ,  ClientAggregationConf const &aggregation_conf = ClientAggregationConf()
+           ,  std::string const &metrics_labels = std::string())
         : theTimer(chronolog_timer)
         , theClientQueryService(clientQueryService)
         , clientId(client_id)
+        , recordingConf(recording_conf)
+        , rpcConf(rpc_conf)
+        , metricsLabels(metrics_labels)
+        , eventIndex(0)
+        , replicatedSender(nullptr)
+        , rateLimitPolicy(recording_conf, metrics_labels)
+        , clientLimiter(RateLimiter::CreateRateLimiter(recording_conf.client_max_events_per_sec()
+                                                       , recording_conf.client_max_bytes_per_sec()
+                                                       , recording_conf.rate_limit_burst_ms()))
+        , memoryBudget(memory_budget)
+        , acceptingEvents(true)
+        , rejectedEvents(chrono_metrics::getInstance().counter("chronolog_drain_rejected_events_total", metrics_labels))
+        , nodeAggregator(nullptr)
     {
+        if(aggregation_conf.node_aggregation())
+        { start_node_aggregation(aggregation_conf); }
         LOG_DEBUG("[StorytellerClient] Initialized with ClientID: {}", clientId);
     }
 
@@ -53,10 +92,14 @@ public:
     int addKeeperRecordingClient(KeeperIdCard const &);
     int removeKeeperRecordingClient(KeeperIdCard const &);
 
+    // the client of the keeper, added if this client did not record to the keeper yet ; nullptr on failure
+    KeeperRecordingClient *getKeeperRecordingClient(KeeperIdCard const &);
+
     StoryHandle*findStoryWritingHandle(ChronicleName const &, StoryName const &);
 
     StoryHandle*initializeStoryWritingHandle(ChronicleName const &, StoryName const &, StoryId const &
-                                             , std::vector <KeeperIdCard> const &, ServiceId const&);
+                                             , std::vector <KeeperIdCard> const &, ServiceId const&
+                                             , std::map <std::string, std::string> const &story_attrs);
 
     void removeAcquiredStoryHandle(ChronicleName const &, StoryName const &);
 
@@ -66,61 +109,218 @@ public:
     ClientId const &getClientId() const
     { return clientId; }
 
-    int get_event_index();
+    chrono_index get_event_index();
+
+    // reserves count consecutive event indices with a single atomic increment, returns the first one
+    chrono_index reserve_event_indices(uint32_t count)
+    { return eventIndex.fetch_add(count, std::memory_order_relaxed) + 1; }
+
+    // the counter behind get_event_index, the StoryWriter fast path increments it inline
+    std::atomic <uint32_t> &event_index_counter()
+    { return eventIndex; }
 
     ServiceId const& get_local_service_id() const
     { return theClientQueryService.get_service_id(); }
 
+    int send_playback_request(PlaybackQueryRpcClient * player, ChronicleName const & chronicle, StoryName const & story
+                              , uint64_t start_time, uint64_t end_time, uint32_t & query_id)
+    { return theClientQueryService.run_playback_query(player, chronicle, story, start_time, end_time, query_id); }
+
+    int collect_playback_response(uint32_t query_id, std::vector<Event> & playback_events)
+    { return theClientQueryService.collect_query_response(query_id, playback_events); }
+
+    ClientRpcConf const &rpc_conf() const
+    { return rpcConf; }
+
+    RateLimitPolicy &rate_limit_policy()
+    { return rateLimitPolicy; }
+
+    // the budget shared by all the stories, nullptr if the client is not rate limited
+    RateLimiter *client_rate_limiter() const
+    { return clientLimiter; }
+
+    // the client memory budget, nullptr if the memory is not accounted
+    MemoryBudget *memory_budget() const
+    { return memoryBudget; }
+
+    ClientRecordingConf const &recording_conf() const
+    { return recordingConf; }
+
+    // the instance label of the metric series of the client
+    std::string const &metrics_labels() const
+    { return metricsLabels; }
+
+    // the node aggregator the events are forwarded through, nullptr without node aggregation
+    NodeAggregator *node_aggregator() const
+    { return nodeAggregator; }
+
+    // waits for the acknowledgement of the events submitted to all the keepers before the call
+    int flush(std::chrono::steady_clock::time_point const &deadline);
+
+    // false once the client is draining, the story handles reject the events logged from then on
+    bool accepting_events(uint64_t event_count)
+    {
+        if(acceptingEvents.load(std::memory_order_relaxed))
+        { return true; }
+        rejectedEvents.add(event_count);
+        return false;
+    }
+
+    // Stops taking events and sends what the keeper batchers hold to all the keepers at once, then waits for
+    // the acknowledgements until the deadline ; the events still pending past it are discarded.
+    // Logs what was lost per keeper, CL_ERR_TIMEOUT if a keeper did not complete in time,
+    // CL_ERR_NOT_ACKNOWLEDGED if events failed, CL_SUCCESS if every event logged was acknowledged.
+    int drain(std::chrono::steady_clock::time_point const &deadline);
+
+    // takes events again after a drain, when the client reconnects
+    void resume_events()
+    { acceptingEvents.store(true); }
+
+    // created with the first replicated or hedged story
+    ReplicatedBatchSender *replicated_sender() const
+    { return replicatedSender; }
+
 private:
     StorytellerClient(StorytellerClient const &) = delete;
 
     StorytellerClient &operator=(StorytellerClient const &) = delete;
 
+    void start_node_aggregation(ClientAggregationConf const &aggregation_conf);
+
     ChronologTimer &theTimer;
     ClientQueryService & theClientQueryService;
     ClientId clientId;
-    std::atomic <int> atomic_index;
+    ClientRecordingConf recordingConf;
+    ClientRpcConf rpcConf;
+    std::string metricsLabels;
+    std::atomic <uint32_t> eventIndex;
+    ReplicatedBatchSender *replicatedSender;
+    RateLimitPolicy rateLimitPolicy;
+    RateLimiter *clientLimiter;
+    MemoryBudget *memoryBudget;
+    std::atomic <bool> acceptingEvents;
+    ShardedCounter &rejectedEvents;
+    NodeAggregator *nodeAggregator;
 
     std::mutex recordingClientMapMutex;
+    // held by drain and flush while they wait on the keeper clients without the recordingClientMapMutex,
+    // so removeKeeperRecordingClient does not delete them under it
+    std::mutex keeperRemovalMutex;
+    std::mutex flushedErrorMutex;   // guards flushedErrorSeqs
     std::mutex acquiredStoryMapMutex;
 
     std::map <std::pair <uint32_t, uint16_t>, KeeperRecordingClient*> recordingClientMap;
     std::map <std::pair <std::string, std::string>, StoryHandle*> acquiredStoryHandles;
     std::map <std::pair <uint32_t, uint16_t>, PlaybackQueryRpcClient*> playbackQueryClientMap;
+    std::map <std::pair <uint32_t, uint16_t>, uint64_t> flushedErrorSeqs;
 
 };
 
 
 // this class definition lives in the client lib
 template <class KeeperChoicePolicy>
-class StoryWritingHandle: public StoryHandle
+class StoryWritingHandle final: public StoryHandle
 {
 public:
-    StoryWritingHandle(StorytellerClient &client, ChronicleName const &a_chronicle, StoryName const &a_story , StoryId const &story_id)
+    StoryWritingHandle(StorytellerClient &client, ChronicleName const &a_chronicle, StoryName const &a_story , StoryId const &story_id
+                       , bool lz_compression = false, uint32_t replicas = 1, uint32_t write_quorum = 1
+                       , bool hedging = false, RateLimiter *story_limiter = nullptr
+                       , EventPriority priority = PRIORITY_NORMAL, bool batch_rpc = false)
         : theClient(client)
         , chronicle(a_chronicle), story(a_story), storyId(story_id)
         , keeperChoicePolicy(new KeeperChoicePolicy)
         , playbackQueryClient(nullptr)
+        , lzCompression(lz_compression)
+        , batchRpc(batch_rpc)
+        , replicaCount(replicas)
+        , writeQuorum(write_quorum)
+        , hedgeRecords(hedging)
+        , storyLimiter(story_limiter)
+        , eventPriority(priority)
     {
-        LOG_DEBUG("[StoryWritingHandle] Initialized for Chronicle: {}, Story: {}", a_chronicle, a_story);
+        LOG_DEBUG("[StoryWritingHandle] Initialized for Chronicle: {}, Story: {}, compression: {}, replicas: {} quorum: {}"
+                  " hedging: {} priority: {} batch rpc: {}", a_chronicle, a_story, (lz_compression ? "lz" : "none")
+                  , replicas, write_quorum, hedging, static_cast<int>(priority), batch_rpc);
     }
 
     virtual ~StoryWritingHandle();
 
+    using StoryHandle::log_event;
+
     virtual int log_event(std::string const &);
 
+    virtual int log_event(std::string &&);
+
+    virtual int log_events(std::string_view const *records, std::size_t count, bool timestamp_each = false);
+
+    virtual int log_events(struct iovec const *records, std::size_t count, bool timestamp_each = false);
+
+    // the part of log_event that follows the timestamping and indexing, shared with the StoryWriter fast path
+    int record_event(chrono_time, chrono_index, std::string &&);
+
+    // the RecordEventFunction of the writers of this handle type
+    static int record_writer_event(StoryHandle *story_handle, chrono_time event_time, chrono_index event_index
+                                   , std::string &&record)
+    {
+        return static_cast<StoryWritingHandle*>(story_handle)->record_event(event_time, event_index
+                                                                            , std::move(record));
+    }
+
+    virtual StoryWriter get_writer()
+    { return StoryWriter(this, &theClient.event_index_counter(), &StoryWritingHandle::record_writer_event); }
+
+    // logs the format definition first when the format is used for the first time on this story
+    virtual int log_deferred_event(FormatId const &, std::string const &record);
+
    // virtual int log_event(size_t size, void*data);
 
     virtual int playback_story(uint64_t start, uint64_t end, std::vector<Event> & playback_events);
 
+    using StoryHandle::flush;
+
+    virtual int flush(std::chrono::steady_clock::time_point const &deadline);
+
     void addRecordingClient(KeeperRecordingClient*);
     void removeRecordingClient(KeeperIdCard const &);
 
     void attachPlaybackQueryClient(PlaybackQueryRpcClient*);
     void detachPlaybackQueryClient();
 
+    // event batches of the story are compressed when it was acquired with the "compression":"lz" attribute
+    bool compresses_batches() const
+    { return lzCompression; }
+
 private:
 
+    template <class Record>
+    int record_events(Record const *records, std::size_t count, bool timestamp_each);
+
+    bool rate_limited() const
+    { return (storyLimiter != nullptr || theClient.client_rate_limiter() != nullptr); }
+
+    // charges the events to the story and client rate limits, false if they are not to be recorded
+    bool admit_events(uint64_t event_count, uint64_t byte_count)
+    {
+        return theClient.rate_limit_policy().admit(storyLimiter, theClient.client_rate_limiter(), event_count
+                                                   , byte_count);
+    }
+
+    // charges the buffers this call holds while sending to the client memory budget
+    bool acquire_memory(std::size_t bytes)
+    {
+        return (bytes == 0 || theClient.memory_budget() == nullptr
+                || theClient.memory_budget()->acquire(bytes, MEMORY_IN_FLIGHT));
+    }
+
+    void release_memory(std::size_t bytes)
+    {
+        if(bytes != 0 && theClient.memory_budget() != nullptr)
+        { theClient.memory_budget()->release(bytes, MEMORY_IN_FLIGHT); }
+    }
+
+    // sends the batch to replicaCount of the story keepers, and to one more if hedging, see ReplicatedBatchSender
+    int send_replicated_batch(EventBatchEncoder const &event_batch, chrono_time event_time);
+
     StorytellerClient &theClient;
     ChronicleName chronicle;
     StoryName story;
@@ -128,6 +328,16 @@ private:
     KeeperChoicePolicy*keeperChoicePolicy;
     PlaybackQueryRpcClient * playbackQueryClient;
     std::vector <KeeperRecordingClient*> storyKeepers;
+    bool lzCompression;
+    bool batchRpc;   // the story keepers serve record_event_batch, see STORY_ATTR_KEEPER_BATCH_RPC
+    uint32_t replicaCount;
+    uint32_t writeQuorum;
+    bool hedgeRecords;   // the batches go through the ReplicatedBatchSender even with a single replica
+    RateLimiter *storyLimiter;   // nullptr if the story is not rate limited
+    EventPriority eventPriority;   // lane of the story events in the keeper batchers
+    std::array <std::atomic <uint64_t>, 64> definedFormats{};   // bit per FormatId slot, slots past 4096 are always defined
+    std::mutex flushMutex;
+    std::map <KeeperRecordingClient*, uint64_t> flushedErrorSeqs;   // keeper error count seen by the last flush
     
 };
 
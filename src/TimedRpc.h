@@ -0,0 +1,36 @@
+#ifndef TIMED_RPC_H
+#define TIMED_RPC_H
+
+#include <chrono>
+#include <utility>
+
+#include <thallium.hpp>
+
+namespace chronolog
+{
+
+// Issue an RPC through its thallium callable with the client RPC deadline : once the deadline passes
+// the call throws tl::timeout, which the RPC clients handle as any other tl::exception.
+// A zero timeout waits for the response as long as it takes.
+
+template <typename Callable, typename... Args>
+inline auto timed_call(Callable const &rpc, std::chrono::milliseconds const &timeout, Args &&... args)
+    -> decltype(rpc(std::forward <Args>(args)...))
+{
+    if(timeout.count() == 0)
+    { return rpc(std::forward <Args>(args)...); }
+    return rpc.timed(timeout, std::forward <Args>(args)...);
+}
+
+template <typename Callable, typename... Args>
+inline auto timed_async_call(Callable const &rpc, std::chrono::milliseconds const &timeout, Args &&... args)
+    -> decltype(rpc.async(std::forward <Args>(args)...))
+{
+    if(timeout.count() == 0)
+    { return rpc.async(std::forward <Args>(args)...); }
+    return rpc.timed_async(timeout, std::forward <Args>(args)...);
+}
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "chrono_lz.h"
+
+namespace chl = chronolog;
+
+namespace
+{
+
+const std::size_t MIN_MATCH = 4;
+const std::size_t MAX_OFFSET = 65535;
+const unsigned HASH_BITS = 12;
+
+inline uint32_t read32(uint8_t const *position)
+{
+    uint32_t value;
+    std::memcpy(&value, position, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash32(uint32_t value)
+{ return (value * 2654435761u) >> (32 - HASH_BITS); }
+
+inline void put_length(std::string &out, std::size_t length)
+{
+    for(; length >= 255; length -= 255)
+    { out.push_back(static_cast<char>(255)); }
+    out.push_back(static_cast<char>(length));
+}
+
+inline void put_sequence(std::string &out, uint8_t const *literals, std::size_t literal_length
+                         , std::size_t offset, std::size_t match_length)
+{
+    std::size_t match_code = (match_length >= MIN_MATCH ? match_length - MIN_MATCH : 0);
+    out.push_back(static_cast<char>(((literal_length < 15 ? literal_length : 15) << 4)
+                                    | (match_code < 15 ? match_code : 15)));
+    if(literal_length >= 15)
+    { put_length(out, literal_length - 15); }
+    out.append(reinterpret_cast<char const*>(literals), literal_length);
+    if(match_length == 0)
+    { return; }
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if(match_code >= 15)
+    { put_length(out, match_code - 15); }
+}
+
+// reads a 255-saturated length extension, false if the block ends first
+inline bool get_length(uint8_t const *&position, uint8_t const *end, std::size_t &length)
+{
+    uint8_t byte;
+    do
+    {
+        if(position == end)
+        { return false; }
+        byte = *position++;
+        length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+}
+
+void chl::chrono_lz::compress(char const *source, std::size_t size, std::string &compressed)
+{
+    uint8_t const *input = reinterpret_cast<uint8_t const*>(source);
+    uint8_t const *input_end = input + size;
+    uint8_t const *literals = input;
+
+    compressed.reserve(compressed.size() + size + size / 255 + 16);
+    if(size >= MIN_MATCH)
+    {
+        std::vector <uint32_t> hash_table(1u << HASH_BITS, 0);
+        uint8_t const *match_limit = input_end - MIN_MATCH;
+        uint8_t const *position = input;
+        while(position <= match_limit)
+        {
+            uint32_t sequence = read32(position);
+            uint32_t &slot = hash_table[hash32(sequence)];
+            uint8_t const *candidate = input + slot;
+            slot = static_cast<uint32_t>(position - input);
+
+            if(candidate >= position || static_cast<std::size_t>(position - candidate) > MAX_OFFSET
+               || read32(candidate) != sequence)
+            {
+                ++position;
+                continue;
+            }
+
+            std::size_t match_length = MIN_MATCH;
+            while(position + match_length < input_end && candidate[match_length] == position[match_length])
+            { ++match_length; }
+
+            put_sequence(compressed, literals, position - literals, position - candidate, match_length);
+            position += match_length;
+            literals = position;
+        }
+    }
+    put_sequence(compressed, literals, input_end - literals, 0, 0);
+}
+
+bool chl::chrono_lz::decompress(char const *block, std::size_t block_size, std::string &decompressed
+                                , std::size_t decompressed_size)
+{
+    uint8_t const *position = reinterpret_cast<uint8_t const*>(block);
+    uint8_t const *end = position + block_size;
+
+    // a block byte expands to at most 255 bytes, don't trust a corrupted size with the allocation
+    if(decompressed_size / 255 > block_size)
+    { return false; }
+    decompressed.resize(decompressed_size);
+    uint8_t *output = reinterpret_cast<uint8_t*>(&decompressed[0]);
+    std::size_t written = 0;
+
+    while(position < end)
+    {
+        uint8_t token = *position++;
+        std::size_t literal_length = token >> 4;
+        if(literal_length == 15 && !get_length(position, end, literal_length))
+        { return false; }
+        if(literal_length > static_cast<std::size_t>(end - position) || literal_length > decompressed_size - written)
+        { return false; }
+        std::memcpy(output + written, position, literal_length);
+        position += literal_length;
+        written += literal_length;
+
+        if(position == end)
+        { break; }   // last sequence, literals only
+
+        if(end - position < 2)
+        { return false; }
+        std::size_t offset = position[0] | (static_cast<std::size_t>(position[1]) << 8);
+        position += 2;
+        std::size_t match_length = token & 0x0f;
+        if(match_length == 15 && !get_length(position, end, match_length))
+        { return false; }
+        match_length += MIN_MATCH;
+        if(offset == 0 || offset > written || match_length > decompressed_size - written)
+        { return false; }
+
+        // byte by byte so that overlapping matches repeat the pattern
+        uint8_t const *match = output + written - offset;
+        for(std::size_t i = 0; i < match_length; ++i)
+        { output[written + i] = match[i]; }
+        written += match_length;
+    }
+    return (written == decompressed_size);
+}
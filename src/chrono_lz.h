@@ -0,0 +1,37 @@
+#ifndef CHRONOLOG_CHRONO_LZ_H
+#define CHRONOLOG_CHRONO_LZ_H
+
+#include <cstddef>
+#include <string>
+
+namespace chronolog
+{
+
+/**
+ * @class chrono_lz
+ * @brief Small self-contained LZ77 block codec used to compress event batches and story chunks.
+ *
+ * The block format follows LZ4: a sequence is a token byte (literal length in the high nibble,
+ * match length - 4 in the low nibble, 15 meaning "continued in the following 255-saturated bytes"),
+ * the literals, and a 2 byte little-endian match offset ; the last sequence has literals only.
+ * Blocks do not carry their decompressed size, the callers keep it next to the block.
+ */
+class chrono_lz
+{
+public:
+    // appends the compressed block of [source, source + size) to compressed
+    static void compress(char const *source, std::size_t size, std::string &compressed);
+
+    /**
+     * @brief Decompresses a block into exactly decompressed_size bytes.
+     * @return true if the block is well formed and decompresses to decompressed_size bytes.
+     */
+    static bool decompress(char const *block, std::size_t block_size, std::string &decompressed
+                           , std::size_t decompressed_size);
+
+    chrono_lz() = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "chrono_metrics.h"
+#include "chrono_monitor.h"
+
+namespace chronolog
+{
+
+std::mutex chrono_metrics::dumpMutex;
+std::condition_variable chrono_metrics::dumpCondition;
+std::thread chrono_metrics::dumpThread;
+bool chrono_metrics::dumpRunning = false;
+
+std::size_t ShardedCounter::thread_shard()
+{
+    static std::atomic <std::size_t> next_shard{0};
+    thread_local std::size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shard;
+}
+
+/////////////////
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    uint64_t total = count();
+    if(total == 0)
+    { return 0; }
+
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    if(rank >= total)
+    { rank = total - 1; }
+
+    uint64_t seen = 0;
+    for(unsigned index = 0; index < BUCKET_COUNT; ++index)
+    {
+        seen += buckets[index].load(std::memory_order_relaxed);
+        if(seen > rank)
+        {
+            // never report more than the largest recorded value
+            uint64_t value = bucket_value(index);
+            uint64_t max_value = maxValue.load(std::memory_order_relaxed);
+            return (value > max_value ? max_value : value);
+        }
+    }
+    return maxValue.load(std::memory_order_relaxed);
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+    HistogramSnapshot histogram_snapshot;
+    histogram_snapshot.count = count();
+    histogram_snapshot.sum = totalSum.load(std::memory_order_relaxed);
+    histogram_snapshot.max = maxValue.load(std::memory_order_relaxed);
+    histogram_snapshot.p50 = percentile(0.5);
+    histogram_snapshot.p90 = percentile(0.9);
+    histogram_snapshot.p99 = percentile(0.99);
+    histogram_snapshot.p999 = percentile(0.999);
+    return histogram_snapshot;
+}
+
+/////////////////
+
+ShardedCounter &MetricsRegistry::counter(std::string const &name, std::string const &labels)
+{
+    std::lock_guard <std::mutex> lock(registryMutex);
+    auto &metric = counters[MetricKey(name, labels)];
+    if(!metric)
+    { metric = std::make_unique <ShardedCounter>(); }
+    return *metric;
+}
+
+Gauge &MetricsRegistry::gauge(std::string const &name, std::string const &labels)
+{
+    std::lock_guard <std::mutex> lock(registryMutex);
+    auto &metric = gauges[MetricKey(name, labels)];
+    if(!metric)
+    { metric = std::make_unique <Gauge>(); }
+    return *metric;
+}
+
+LatencyHistogram &MetricsRegistry::histogram(std::string const &name, std::string const &labels)
+{
+    std::lock_guard <std::mutex> lock(registryMutex);
+    auto &metric = histograms[MetricKey(name, labels)];
+    if(!metric)
+    { metric = std::make_unique <LatencyHistogram>(); }
+    return *metric;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const
+{
+    MetricsSnapshot metrics_snapshot;
+    metrics_snapshot.timestamp = std::chrono::duration_cast <std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard <std::mutex> lock(registryMutex);
+    for(auto const &metric: counters)
+    {
+        metrics_snapshot.counters.push_back({metric.first.first, metric.first.second, metric.second->value()});
+    }
+    for(auto const &metric: gauges)
+    {
+        metrics_snapshot.gauges.push_back({metric.first.first, metric.first.second, metric.second->value()});
+    }
+    for(auto const &metric: histograms)
+    {
+        metrics_snapshot.histograms.push_back({metric.first.first, metric.first.second, metric.second->snapshot()});
+    }
+    return metrics_snapshot;
+}
+
+/////////////////
+
+static std::string json_escape(std::string const &a_string)
+{
+    std::string escaped;
+    escaped.reserve(a_string.size());
+    for(char c: a_string)
+    {
+        if(c == '"' || c == '\\')
+        { escaped += '\\'; }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static std::string prometheus_labels(std::string const &labels, std::string const &extra_label = std::string())
+{
+    if(labels.empty() && extra_label.empty())
+    { return std::string(); }
+    if(labels.empty())
+    { return "{" + extra_label + "}"; }
+    if(extra_label.empty())
+    { return "{" + labels + "}"; }
+    return "{" + labels + "," + extra_label + "}";
+}
+
+void MetricsSnapshot::keep_instance(std::string const &instance_labels)
+{
+    auto other_instance = [&instance_labels](std::string const &labels)
+    {
+        return (labels.find("instance=\"") != std::string::npos
+                && labels.find(instance_labels) == std::string::npos);
+    };
+    counters.erase(std::remove_if(counters.begin(), counters.end(), [&](Entry <uint64_t> const &entry)
+    { return other_instance(entry.labels); }), counters.end());
+    gauges.erase(std::remove_if(gauges.begin(), gauges.end(), [&](Entry <int64_t> const &entry)
+    { return other_instance(entry.labels); }), gauges.end());
+    histograms.erase(std::remove_if(histograms.begin(), histograms.end(), [&](Entry <HistogramSnapshot> const &entry)
+    { return other_instance(entry.labels); }), histograms.end());
+}
+
+std::string MetricsSnapshot::to_json() const
+{
+    std::ostringstream out;
+    out << "{\"timestamp\":" << timestamp << ",\"counters\":[";
+    for(std::size_t i = 0; i < counters.size(); ++i)
+    {
+        out << (i ? "," : "") << "{\"name\":\"" << counters[i].name << "\",\"labels\":\""
+            << json_escape(counters[i].labels) << "\",\"value\":" << counters[i].value << "}";
+    }
+    out << "],\"gauges\":[";
+    for(std::size_t i = 0; i < gauges.size(); ++i)
+    {
+        out << (i ? "," : "") << "{\"name\":\"" << gauges[i].name << "\",\"labels\":\""
+            << json_escape(gauges[i].labels) << "\",\"value\":" << gauges[i].value << "}";
+    }
+    out << "],\"histograms\":[";
+    for(std::size_t i = 0; i < histograms.size(); ++i)
+    {
+        HistogramSnapshot const &h = histograms[i].value;
+        out << (i ? "," : "") << "{\"name\":\"" << histograms[i].name << "\",\"labels\":\""
+            << json_escape(histograms[i].labels) << "\",\"count\":" << h.count << ",\"sum\":" << h.sum
+            << ",\"max\":" << h.max << ",\"p50\":" << h.p50 << ",\"p90\":" << h.p90 << ",\"p99\":" << h.p99
+            << ",\"p999\":" << h.p999 << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+std::string MetricsSnapshot::to_prometheus() const
+{
+    std::ostringstream out;
+    std::string last_name;
+    for(auto const &entry: counters)
+    {
+        if(entry.name != last_name)
+        { out << "# TYPE " << entry.name << " counter\n"; last_name = entry.name; }
+        out << entry.name << prometheus_labels(entry.labels) << " " << entry.value << "\n";
+    }
+    for(auto const &entry: gauges)
+    {
+        if(entry.name != last_name)
+        { out << "# TYPE " << entry.name << " gauge\n"; last_name = entry.name; }
+        out << entry.name << prometheus_labels(entry.labels) << " " << entry.value << "\n";
+    }
+    for(auto const &entry: histograms)
+    {
+        HistogramSnapshot const &h = entry.value;
+        if(entry.name != last_name)
+        { out << "# TYPE " << entry.name << " summary\n"; last_name = entry.name; }
+        out << entry.name << prometheus_labels(entry.labels, "quantile=\"0.5\"") << " " << h.p50 << "\n";
+        out << entry.name << prometheus_labels(entry.labels, "quantile=\"0.9\"") << " " << h.p90 << "\n";
+        out << entry.name << prometheus_labels(entry.labels, "quantile=\"0.99\"") << " " << h.p99 << "\n";
+        out << entry.name << prometheus_labels(entry.labels, "quantile=\"0.999\"") << " " << h.p999 << "\n";
+        out << entry.name << "_sum" << prometheus_labels(entry.labels) << " " << h.sum << "\n";
+        out << entry.name << "_count" << prometheus_labels(entry.labels) << " " << h.count << "\n";
+    }
+    return out.str();
+}
+
+/////////////////
+
+MetricsRegistry &chrono_metrics::getInstance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+int chrono_metrics::write_snapshot(std::string const &file, std::string const &format)
+{
+    MetricsSnapshot metrics_snapshot = getInstance().snapshot();
+
+    std::string tmp_file = file + ".tmp";
+    {
+        std::ofstream out(tmp_file, std::ios::out | std::ios::trunc);
+        if(!out)
+        {
+            LOG_ERROR("[chrono_metrics] Failed to open metrics file {}", tmp_file);
+            return 1;
+        }
+        out << (format == "prometheus" ? metrics_snapshot.to_prometheus() : metrics_snapshot.to_json());
+    }
+    if(std::rename(tmp_file.c_str(), file.c_str()) != 0)
+    {
+        LOG_ERROR("[chrono_metrics] Failed to rename metrics file {} to {}", tmp_file, file);
+        return 1;
+    }
+    return 0;
+}
+
+int chrono_metrics::start_periodic_dump(std::string const &file, uint32_t intervalSecs, std::string const &format)
+{
+    if(file.empty() || intervalSecs == 0 || (format != "json" && format != "prometheus"))
+    {
+        LOG_ERROR("[chrono_metrics] Invalid metrics dump configuration: file '{}', interval {}, format '{}'", file
+                  , intervalSecs, format);
+        return 1;
+    }
+
+    std::lock_guard <std::mutex> lock(dumpMutex);
+    if(dumpRunning)
+    { return 0; }
+
+    dumpRunning = true;
+    dumpThread = std::thread([file, intervalSecs, format]()
+                             {
+                                 std::unique_lock <std::mutex> dump_lock(dumpMutex);
+                                 while(dumpRunning)
+                                 {
+                                     dumpCondition.wait_for(dump_lock, std::chrono::seconds(intervalSecs));
+                                     // write the snapshot on every tick and once more on shutdown
+                                     dump_lock.unlock();
+                                     write_snapshot(file, format);
+                                     dump_lock.lock();
+                                 }
+                             });
+    LOG_INFO("[chrono_metrics] Dumping {} metrics to {} every {} seconds", format, file, intervalSecs);
+    return 0;
+}
+
+void chrono_metrics::stop_periodic_dump()
+{
+    {
+        std::lock_guard <std::mutex> lock(dumpMutex);
+        if(!dumpRunning)
+        { return; }
+        dumpRunning = false;
+    }
+    dumpCondition.notify_all();
+    if(dumpThread.joinable())
+    { dumpThread.join(); }
+}
+
+} // namespace chronolog
@@ -0,0 +1,300 @@
+#ifndef CHRONOLOG_CHRONO_METRICS_H
+#define CHRONOLOG_CHRONO_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace chronolog
+{
+
+inline uint64_t metrics_now_ns()
+{
+    return std::chrono::duration_cast <std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// label of the series of one client instance of the process
+inline std::string instance_metrics_labels(uint32_t instance)
+{ return "instance=\"" + std::to_string(instance) + "\""; }
+
+// the two label strings joined, either may be empty
+inline std::string join_metrics_labels(std::string const &labels, std::string const &more_labels)
+{
+    if(labels.empty() || more_labels.empty())
+    { return labels + more_labels; }
+    return labels + "," + more_labels;
+}
+
+/**
+ * @class ShardedCounter
+ * @brief Monotonic counter with per-thread slots that are merged on read.
+ *
+ * Every thread is assigned its own cache-line aligned slot the first time it touches
+ * any ShardedCounter, so concurrent increments from different threads never contend
+ * on the same cache line. value() sums all the slots.
+ */
+class ShardedCounter
+{
+public:
+    static constexpr std::size_t SHARD_COUNT = 32;
+
+    ShardedCounter() = default;
+    ShardedCounter(ShardedCounter const &) = delete;
+    ShardedCounter &operator=(ShardedCounter const &) = delete;
+
+    void add(uint64_t value = 1)
+    { shards[thread_shard()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    uint64_t value() const
+    {
+        uint64_t total = 0;
+        for(auto const &shard: shards)
+        { total += shard.value.load(std::memory_order_relaxed); }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic <uint64_t> value{0};
+    };
+
+    static std::size_t thread_shard();
+
+    Shard shards[SHARD_COUNT];
+};
+
+/**
+ * @class Gauge
+ * @brief Point-in-time value such as a queue depth or the number of in-flight RPCs.
+ */
+class Gauge
+{
+public:
+    Gauge() = default;
+    Gauge(Gauge const &) = delete;
+    Gauge &operator=(Gauge const &) = delete;
+
+    void set(int64_t value)
+    { gaugeValue.store(value, std::memory_order_relaxed); }
+
+    void add(int64_t value)
+    { gaugeValue.fetch_add(value, std::memory_order_relaxed); }
+
+    void sub(int64_t value)
+    { gaugeValue.fetch_sub(value, std::memory_order_relaxed); }
+
+    int64_t value() const
+    { return gaugeValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic <int64_t> gaugeValue{0};
+};
+
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+};
+
+/**
+ * @class LatencyHistogram
+ * @brief HDR-style log-linear histogram of uint64_t values (nanoseconds by convention).
+ *
+ * Every power of two range is split into 2^SUB_BUCKET_BITS linear sub-buckets, which
+ * bounds the relative error of reported percentiles to 1/2^SUB_BUCKET_BITS (~6%) over
+ * the whole uint64_t range with a fixed amount of memory and a lock-free record().
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr unsigned SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(LatencyHistogram const &) = delete;
+    LatencyHistogram &operator=(LatencyHistogram const &) = delete;
+
+    void record(uint64_t value)
+    {
+        buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        totalCount.fetch_add(1, std::memory_order_relaxed);
+        totalSum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t current_max = maxValue.load(std::memory_order_relaxed);
+        while(value > current_max &&
+              !maxValue.compare_exchange_weak(current_max, value, std::memory_order_relaxed))
+        {}
+    }
+
+    uint64_t count() const
+    { return totalCount.load(std::memory_order_relaxed); }
+
+    // value at quantile q in [0,1] ; 0 if the histogram is empty
+    uint64_t percentile(double q) const;
+
+    HistogramSnapshot snapshot() const;
+
+    static unsigned bucket_index(uint64_t value)
+    {
+        if(value < SUB_BUCKET_COUNT)
+        { return static_cast<unsigned>(value); }
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned group = msb - SUB_BUCKET_BITS + 1;
+        unsigned sub_bucket = static_cast<unsigned>(value >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+        return group * SUB_BUCKET_COUNT + sub_bucket;
+    }
+
+    // midpoint of the value range covered by the bucket
+    static uint64_t bucket_value(unsigned index)
+    {
+        unsigned group = index / SUB_BUCKET_COUNT;
+        uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+        if(group == 0)
+        { return sub_bucket; }
+        uint64_t lower = (SUB_BUCKET_COUNT + sub_bucket) << (group - 1);
+        uint64_t width = uint64_t{1} << (group - 1);
+        return lower + width / 2;
+    }
+
+private:
+    std::atomic <uint64_t> buckets[BUCKET_COUNT]{};
+    std::atomic <uint64_t> totalCount{0};
+    std::atomic <uint64_t> totalSum{0};
+    std::atomic <uint64_t> maxValue{0};
+};
+
+// records the time elapsed between construction and destruction into the histogram
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(LatencyHistogram &histogram)
+        : theHistogram(histogram)
+        , startTime(metrics_now_ns())
+    {}
+
+    ~ScopedLatency()
+    { theHistogram.record(metrics_now_ns() - startTime); }
+
+    ScopedLatency(ScopedLatency const &) = delete;
+    ScopedLatency &operator=(ScopedLatency const &) = delete;
+
+private:
+    LatencyHistogram &theHistogram;
+    uint64_t startTime;
+};
+
+struct MetricsSnapshot
+{
+    template <typename ValueT>
+    struct Entry
+    {
+        std::string name;
+        std::string labels;
+        ValueT value;
+    };
+
+    uint64_t timestamp;   // wall clock, nanoseconds since epoch
+    std::vector <Entry <uint64_t>> counters;
+    std::vector <Entry <int64_t>> gauges;
+    std::vector <Entry <HistogramSnapshot>> histograms;
+
+    std::string to_json() const;
+
+    std::string to_prometheus() const;
+
+    // drops the series of the client instances other than the one of instance_labels, keeps the process-wide ones
+    void keep_instance(std::string const &instance_labels);
+};
+
+/**
+ * @class MetricsRegistry
+ * @brief Owns all the named metrics of the process.
+ *
+ * Metrics are identified by name and a label string in Prometheus syntax
+ * (e.g. keeper="10.0.0.1:6666"). Lookups take the registry mutex, so hot paths are
+ * expected to look their metrics up once and keep the returned references,
+ * which stay valid for the lifetime of the registry.
+ *
+ * The series of the objects a client instance owns (its memory budget, query service, storyteller,
+ * keeper clients and batchers, replica sender, rate limiting and node aggregator) carry the
+ * instance="<slot>" label of instance_metrics_labels. The Visor RPC latencies are process-wide.
+ */
+class MetricsRegistry
+{
+public:
+    MetricsRegistry() = default;
+    MetricsRegistry(MetricsRegistry const &) = delete;
+    MetricsRegistry &operator=(MetricsRegistry const &) = delete;
+
+    ShardedCounter &counter(std::string const &name, std::string const &labels = std::string());
+
+    Gauge &gauge(std::string const &name, std::string const &labels = std::string());
+
+    LatencyHistogram &histogram(std::string const &name, std::string const &labels = std::string());
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    typedef std::pair <std::string, std::string> MetricKey;
+
+    mutable std::mutex registryMutex;
+    std::map <MetricKey, std::unique_ptr <ShardedCounter>> counters;
+    std::map <MetricKey, std::unique_ptr <Gauge>> gauges;
+    std::map <MetricKey, std::unique_ptr <LatencyHistogram>> histograms;
+};
+
+/**
+ * @class chrono_metrics
+ * @brief Process-wide access point to the MetricsRegistry, in the spirit of chrono_monitor.
+ */
+class chrono_metrics
+{
+public:
+    static MetricsRegistry &getInstance();
+
+    /**
+     * @brief Starts a background thread that periodically writes a snapshot of all metrics to a local file.
+     *
+     * The file is rewritten atomically (write to a temporary file then rename) on every interval,
+     * so readers never observe a partially written snapshot.
+     *
+     * @param file           Path of the snapshot file.
+     * @param intervalSecs   Dump period in seconds.
+     * @param format         "json" or "prometheus".
+     *
+     * @return 0 if the dump thread was started (or is already running), 1 on invalid arguments.
+     */
+    static int start_periodic_dump(std::string const &file, uint32_t intervalSecs
+                                   , std::string const &format = "json");
+
+    // stops the dump thread after writing the final snapshot
+    static void stop_periodic_dump();
+
+    static int write_snapshot(std::string const &file, std::string const &format);
+
+    chrono_metrics() = delete;
+
+private:
+    static std::mutex dumpMutex;
+    static std::condition_variable dumpCondition;
+    static std::thread dumpThread;
+    static bool dumpRunning;
+};
+
+} // namespace chronolog
+
+#endif //CHRONOLOG_CHRONO_METRICS_H
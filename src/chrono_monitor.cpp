@@ -11,12 +11,14 @@
 namespace chronolog
 {
 
+std::shared_ptr <spdlog::details::thread_pool> chrono_monitor::threadPool = nullptr;
 std::shared_ptr <spdlog::logger> chrono_monitor::logger = nullptr;
 std::mutex chrono_monitor::mutex;
 
 int chrono_monitor::initialize(const std::string &logType, const std::string &location, spdlog::level::level_enum logLevel
                                , const std::string &loggerName, const std::size_t &logFileSize, const std::size_t &logFileNum
-                               , spdlog::level::level_enum flushLevel)
+                               , spdlog::level::level_enum flushLevel, bool async, std::size_t asyncQueueSize
+                               , spdlog::async_overflow_policy asyncOverflowPolicy)
 {
     std::lock_guard <std::mutex> lock(mutex);
     if(logger)
@@ -45,7 +47,16 @@ int chrono_monitor::initialize(const std::string &logType, const std::string &lo
             std::cerr << "[Logger] Invalid log type" << std::endl;
             return 1;
         }
-        logger = std::make_shared <spdlog::logger>(loggerName, sink);
+        if(async)
+        {
+            // a single worker keeps the messages in order; callers only pay for formatting into the queue slot
+            threadPool = std::make_shared <spdlog::details::thread_pool>(asyncQueueSize, 1);
+            logger = std::make_shared <spdlog::async_logger>(loggerName, sink, threadPool, asyncOverflowPolicy);
+        }
+        else
+        {
+            logger = std::make_shared <spdlog::logger>(loggerName, sink);
+        }
         logger->flush_on(flushLevel);
         logger->set_level(logLevel);
     }
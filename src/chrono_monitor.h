@@ -2,60 +2,92 @@
 #define CHRONOLOG_CHRONO_MONITOR_H
 
 #include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <mutex>
 
 namespace chronolog
 {
 
+/**
+ * @def CHRONOLOG_LOG_ACTIVE_LEVEL
+ * @brief Compile-time minimum logging level (one of the SPDLOG_LEVEL_* values).
+ * Logging macros below this level expand to nothing, so neither their arguments are evaluated
+ * nor their messages formatted. Defaults to SPDLOG_LEVEL_INFO when NDEBUG is defined and
+ * SPDLOG_LEVEL_TRACE otherwise; define it to SPDLOG_LEVEL_WARN to also compile out LOG_INFO.
+ */
+#ifndef CHRONOLOG_LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define CHRONOLOG_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define CHRONOLOG_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#endif
+
 /**
  * @def LOG_TRACE(...)
  * @brief Trace logging macro.
- * Logs a trace message when NDEBUG is not defined. Does nothing otherwise.
+ * Logs a trace message when CHRONOLOG_LOG_ACTIVE_LEVEL allows it. Does nothing otherwise.
  */
 
 /**
  * @def LOG_DEBUG(...)
  * @brief Debug logging macro.
- * Logs a debug message when NDEBUG is not defined. Does nothing otherwise.
+ * Logs a debug message when CHRONOLOG_LOG_ACTIVE_LEVEL allows it. Does nothing otherwise.
  */
 
 /**
  * @def LOG_INFO(...)
  * @brief Info logging macro.
- * Logs an info message regardless of NDEBUG definition.
+ * Logs an info message when CHRONOLOG_LOG_ACTIVE_LEVEL allows it. Does nothing otherwise.
  */
 
 /**
  * @def LOG_WARNING(...)
  * @brief Warning logging macro.
- * Logs a warning message regardless of NDEBUG definition.
+ * Logs a warning message regardless of CHRONOLOG_LOG_ACTIVE_LEVEL.
  */
 
 /**
  * @def LOG_ERROR(...)
  * @brief Error logging macro.
- * Logs an error message regardless of NDEBUG definition.
+ * Logs an error message regardless of CHRONOLOG_LOG_ACTIVE_LEVEL.
  */
 
 /**
  * @def LOG_CRITICAL(...)
  * @brief Critical logging macro.
- * Logs a critical message regardless of NDEBUG definition.
+ * Logs a critical message regardless of CHRONOLOG_LOG_ACTIVE_LEVEL.
  */
 
-// Custom logging macros based on build type
-#ifdef NDEBUG
-#define LOG_TRACE(...)
-#define LOG_DEBUG(...)
-#else
+/**
+ * @def LOG_LEVEL_ENABLED(level)
+ * @brief True if a message of the given spdlog level would be logged.
+ * Use it to guard building expensive log arguments (e.g. streaming a message into a stringstream).
+ */
+
+// Custom logging macros based on the compile-time minimum level
+#if CHRONOLOG_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
 #define LOG_TRACE(...) chronolog::chrono_monitor::getInstance().trace(__VA_ARGS__)
+#else
+#define LOG_TRACE(...)
+#endif
+#if CHRONOLOG_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
 #define LOG_DEBUG(...) chronolog::chrono_monitor::getInstance().debug(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...)
 #endif
+#if CHRONOLOG_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
 #define LOG_INFO(...) chronolog::chrono_monitor::getInstance().info(__VA_ARGS__)
+#else
+#define LOG_INFO(...)
+#endif
 #define LOG_WARNING(...) chronolog::chrono_monitor::getInstance().warn(__VA_ARGS__)
 #define LOG_ERROR(...) chronolog::chrono_monitor::getInstance().error(__VA_ARGS__)
 #define LOG_CRITICAL(...) chronolog::chrono_monitor::getInstance().critical(__VA_ARGS__)
 
+#define LOG_LEVEL_ENABLED(level) \
+    (CHRONOLOG_LOG_ACTIVE_LEVEL <= static_cast<int>(level) && chronolog::chrono_monitor::getInstance().should_log(level))
+
 /**
  * @class Logger
  * @brief The Logger class provides a singleton logger with customizable configuration.
@@ -82,6 +114,11 @@ public:
      * @param logFileSize  Maximum size of log file before rotating (in Bytes).
      * @param logFileNum   Number of log files to maintain before overwriting.
      * @param flushLevel   The logging level for the logger to flush into file when file logging mode.
+     * @param async        When true, messages are handed over to a background thread through a bounded
+     *                     queue and the calling thread never performs the sink I/O.
+     * @param asyncQueueSize   Number of messages the async queue can hold.
+     * @param asyncOverflowPolicy  What to do when the async queue is full: block the caller
+     *                     or overrun (discard) the oldest queued message.
      *
      * @return             Returns 0 if the logger was initialized successfully,
      *                     and returns 1 if there was an error during initialization.
@@ -89,7 +126,9 @@ public:
     static int initialize(const std::string &logType, const std::string &location, spdlog::level::level_enum logLevel
                           , const std::string &loggerName, const std::size_t &logFileSize = 104857600
                           , const std::size_t &logFileNum = 3
-                          , spdlog::level::level_enum flushLevel = spdlog::level::warn);
+                          , spdlog::level::level_enum flushLevel = spdlog::level::warn
+                          , bool async = false, std::size_t asyncQueueSize = 8192
+                          , spdlog::async_overflow_policy asyncOverflowPolicy = spdlog::async_overflow_policy::overrun_oldest);
 
 
     /**
@@ -113,6 +152,13 @@ private:
     //Private Constructor
     chrono_monitor() = default;
 
+    /**
+     * @brief Background thread pool serving the async logger.
+     *
+     * The async logger only holds a weak reference to its thread pool, so the pool is kept here.
+     */
+    static std::shared_ptr <spdlog::details::thread_pool> threadPool;
+
     /**
      * @brief The shared pointer to the spdlog logger instance.
      *
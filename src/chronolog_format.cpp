@@ -0,0 +1,362 @@
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+#include "chronolog_errcode.h"
+#include "chronolog_client.h"
+
+namespace chl = chronolog;
+
+namespace
+{
+
+class FormatTable
+{
+public:
+    std::mutex tableMutex;
+    std::unordered_map <uint64_t, std::pair <std::string, uint32_t>> formats;
+};
+
+FormatTable &format_table()
+{
+    static FormatTable table;
+    return table;
+}
+
+chl::FormatId register_format_string(uint64_t format_id, std::string const &format_string)
+{
+    FormatTable &table = format_table();
+    std::lock_guard <std::mutex> lock(table.tableMutex);
+    auto format_iter = table.formats.find(format_id);
+    if(format_iter == table.formats.end())
+    {
+        // slot 0 is reserved for the formats that were not registered
+        uint32_t slot = static_cast<uint32_t>(table.formats.size()) + 1;
+        format_iter = table.formats.emplace(format_id, std::pair <std::string, uint32_t>(format_string, slot)).first;
+    }
+    return chl::FormatId(format_id, (*format_iter).second.second);
+}
+
+uint64_t get_fixed(char const *bytes)
+{
+    uint64_t value = 0;
+    for(int i = 0; i < 8; ++i)
+    { value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i); }
+    return value;
+}
+
+class DeferredArg
+{
+public:
+    DeferredArg()
+        : type(0), signedValue(0), unsignedValue(0), doubleValue(0)
+    {}
+
+    char type;
+    int64_t signedValue;
+    uint64_t unsignedValue;
+    double doubleValue;
+    std::string stringValue;
+
+    long long as_signed() const
+    {
+        switch(type)
+        {
+            case 'i': return signedValue;
+            case 'u': return static_cast<long long>(unsignedValue);
+            case 'd': return ((doubleValue > -9.2e18 && doubleValue < 9.2e18) ? static_cast<long long>(doubleValue) : 0);
+            default: return 0;
+        }
+    }
+
+    unsigned long long as_unsigned() const
+    { return (type == 'u' ? unsignedValue : static_cast<unsigned long long>(as_signed())); }
+
+    double as_double() const
+    {
+        switch(type)
+        {
+            case 'i': return static_cast<double>(signedValue);
+            case 'u': return static_cast<double>(unsignedValue);
+            case 'd': return doubleValue;
+            default: return 0;
+        }
+    }
+
+    std::string as_string() const
+    {
+        switch(type)
+        {
+            case 'i': return std::to_string(signedValue);
+            case 'u': return std::to_string(unsignedValue);
+            case 'd': return std::to_string(doubleValue);
+            default: return stringValue;
+        }
+    }
+};
+
+bool decode_args(std::string const &record, std::vector <DeferredArg> &args)
+{
+    std::size_t position = 10;
+    auto get_varint = [&record, &position](uint64_t &value)
+    {
+        value = 0;
+        for(unsigned shift = 0; shift < 64 && position < record.size(); shift += 7)
+        {
+            uint8_t byte = static_cast<uint8_t>(record[position++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0)
+            { return true; }
+        }
+        return false;
+    };
+
+    while(position < record.size())
+    {
+        args.emplace_back();
+        DeferredArg &arg = args.back();
+        arg.type = record[position++];
+        uint64_t value = 0;
+        switch(arg.type)
+        {
+            case 'i':
+                if(!get_varint(value))
+                { return false; }
+                arg.signedValue = static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+                break;
+            case 'u':
+                if(!get_varint(value))
+                { return false; }
+                arg.unsignedValue = value;
+                break;
+            case 'd':
+                if(record.size() - position < 8)
+                { return false; }
+                value = get_fixed(record.data() + position);
+                std::memcpy(&arg.doubleValue, &value, sizeof(value));
+                position += 8;
+                break;
+            case 's':
+                if(!get_varint(value) || value > record.size() - position)
+                { return false; }
+                arg.stringValue.assign(record, position, value);
+                position += value;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void append_formatted(std::string &text, std::string const &spec, T value)
+{
+    char buffer[128];
+    int length = std::snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+    if(length < 0)
+    { return; }
+    if(static_cast<std::size_t>(length) < sizeof(buffer))
+    {
+        text.append(buffer, length);
+        return;
+    }
+    std::string wide_buffer(length + 1, '\0');
+    std::snprintf(&wide_buffer[0], wide_buffer.size(), spec.c_str(), value);
+    text.append(wide_buffer, 0, length);
+}
+
+// printf style formatting of the decoded arguments, the length modifiers of the format are ignored
+// and replaced with the ones matching the type the argument was logged with
+void format_args(std::string const &format_string, std::vector <DeferredArg> const &args, std::string &text)
+{
+    std::size_t next_arg = 0;
+    DeferredArg missing_arg;
+    missing_arg.type = 's';
+    missing_arg.stringValue = "<missing>";
+    auto take_arg = [&args, &next_arg, &missing_arg]() -> DeferredArg const &
+    { return (next_arg < args.size() ? args[next_arg++] : missing_arg); };
+
+    for(std::size_t i = 0; i < format_string.size(); ++i)
+    {
+        if(format_string[i] != '%')
+        {
+            text.push_back(format_string[i]);
+            continue;
+        }
+        std::string spec("%");
+        std::size_t digits_start = spec.size();
+        char conversion = 0;
+        for(++i; i < format_string.size(); ++i)
+        {
+            char spec_char = format_string[i];
+            if(std::strchr("diouxXeEfFgGaAcspn%", spec_char) != nullptr)
+            {
+                conversion = spec_char;
+                break;
+            }
+            if(spec_char == '$')
+            {
+                // the format strings come from the story data : the positional N$ specs are stripped,
+                // the arguments are always taken in order
+                spec.resize(digits_start);
+                continue;
+            }
+            if(spec_char == '*')
+            { spec += std::to_string(take_arg().as_signed()); }
+            else if(std::strchr("hlLqjzt", spec_char) == nullptr)
+            { spec.push_back(spec_char); }
+            if(spec_char < '0' || spec_char > '9')
+            { digits_start = spec.size(); }
+        }
+        if(conversion != 0 && conversion != '%' && conversion != 'n' && next_arg >= args.size())
+        {
+            text.append(missing_arg.stringValue);
+            continue;
+        }
+        switch(conversion)
+        {
+            case 0:
+                text.append(spec);
+                break;
+            case '%':
+                text.push_back('%');
+                break;
+            case 'n':
+                break;
+            case 'd':
+            case 'i':
+                append_formatted(text, spec + "ll" + conversion, take_arg().as_signed());
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                append_formatted(text, spec + "ll" + conversion, take_arg().as_unsigned());
+                break;
+            case 'c':
+                append_formatted(text, spec + conversion, static_cast<int>(take_arg().as_signed()));
+                break;
+            case 'p':
+                append_formatted(text, spec + conversion
+                                 , reinterpret_cast<void*>(static_cast<uintptr_t>(take_arg().as_unsigned())));
+                break;
+            case 's':
+            {
+                std::string string_value = take_arg().as_string();
+                append_formatted(text, spec + conversion, string_value.c_str());
+                break;
+            }
+            default:
+                append_formatted(text, spec + conversion, take_arg().as_double());
+                break;
+        }
+    }
+}
+
+}
+
+/////////////////
+
+uint64_t chl::FormatRegistry::format_id(char const *format_string)
+{
+    // FNV-1a, stable across processes and builds
+    uint64_t hash = 14695981039346656037ull;
+    for(char const *c = format_string; *c != '\0'; ++c)
+    {
+        hash ^= static_cast<uint8_t>(*c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+chl::FormatId chl::FormatRegistry::register_format(char const *format_string)
+{ return register_format_string(format_id(format_string), format_string); }
+
+int chl::FormatRegistry::find_format(uint64_t format_id, std::string &format_string)
+{
+    FormatTable &table = format_table();
+    std::lock_guard <std::mutex> lock(table.tableMutex);
+    auto format_iter = table.formats.find(format_id);
+    if(format_iter == table.formats.end())
+    { return chl::CL_ERR_NOT_EXIST; }
+    format_string = (*format_iter).second.first;
+    return chl::CL_SUCCESS;
+}
+
+int chl::FormatRegistry::learn_format(std::string const &definition_record)
+{
+    if(!chl::is_format_definition(definition_record))
+    { return chl::CL_ERR_INVALID_ARG; }
+    register_format_string(get_fixed(definition_record.data() + 2), definition_record.substr(10));
+    return chl::CL_SUCCESS;
+}
+
+/////////////////
+
+int chl::make_format_definition(chl::FormatId const &format_id, std::string &definition_record)
+{
+    std::string format_string;
+    if(chl::FormatRegistry::find_format(format_id.id, format_string) != chl::CL_SUCCESS)
+    { return chl::CL_ERR_NOT_EXIST; }
+    definition_record.clear();
+    definition_record.push_back('\0');
+    definition_record.push_back(chl::FORMAT_DEFINITION_TAG);
+    chl::format_detail::put_fixed(definition_record, format_id.id);
+    definition_record.append(format_string);
+    return chl::CL_SUCCESS;
+}
+
+int chl::render_record(std::string const &record, std::string &text)
+{
+    text.clear();
+    if(!chl::is_deferred_record(record))
+    {
+        text = record;
+        return chl::CL_SUCCESS;
+    }
+
+    std::string format_string;
+    uint64_t format_id = get_fixed(record.data() + 2);
+    if(chl::FormatRegistry::find_format(format_id, format_string) != chl::CL_SUCCESS)
+    {
+        text = "<unknown format " + std::to_string(format_id) + ">";
+        return chl::CL_ERR_NOT_EXIST;
+    }
+
+    std::vector <DeferredArg> args;
+    if(!decode_args(record, args))
+    {
+        text = "<malformed record>";
+        return chl::CL_ERR_INVALID_ARG;
+    }
+    format_args(format_string, args, text);
+    return chl::CL_SUCCESS;
+}
+
+void chl::render_deferred_events(std::vector <chl::Event> &events)
+{
+    // the definitions are learned first, the events are ordered by time and not by logging order
+    for(chl::Event const &event: events)
+    {
+        if(chl::is_format_definition(event.log_record()))
+        { chl::FormatRegistry::learn_format(event.log_record()); }
+    }
+
+    std::vector <chl::Event> rendered_events;
+    rendered_events.reserve(events.size());
+    std::string text;
+    for(chl::Event const &event: events)
+    {
+        if(chl::is_format_definition(event.log_record()))
+        { continue; }
+        if(!chl::is_deferred_record(event.log_record()))
+        {
+            rendered_events.push_back(event);
+            continue;
+        }
+        chl::render_record(event.log_record(), text);
+        rendered_events.emplace_back(event.time(), event.client_id(), event.index(), text);
+    }
+    events.swap(rendered_events);
+}
@@ -17,6 +17,23 @@ typedef uint64_t StoryId;
 typedef uint64_t ChronicleId;
 typedef uint64_t ClientId;
 
+// ClientId the Visor issues to the client process of the given host, effective user and pid ;
+// the ranks of a collective connection record under the id of their own process, which no other
+// process connected to the Visor can hold
+inline ClientId process_client_id(uint32_t host_id, uint32_t euid, uint32_t pid)
+{
+    return (static_cast<ClientId>(host_id) << 32) ^ (static_cast<ClientId>(euid) << 16) ^ pid;
+}
+
+// ClientId the client instance of a process records its events under : the instances after the first one
+// carry their number in bits 40-47, which hold the first IP octet of the host id, the same for a cluster's hosts
+constexpr uint32_t MAX_CLIENT_INSTANCES = 256;
+
+inline ClientId instance_client_id(ClientId process_client_id, uint32_t instance)
+{
+    return process_client_id ^ (static_cast<ClientId>(instance % MAX_CLIENT_INSTANCES) << 40);
+}
+
 typedef uint64_t chrono_time;
 typedef uint32_t chrono_index;
 
@@ -30,6 +47,16 @@ public:
             index), logRecord(record)
     {}
 
+    LogEvent(StoryId const &story_id, chrono_time event_time, ClientId client_id, chrono_index index
+             , std::string &&record): storyId(story_id), eventTime(event_time), clientId(client_id), eventIndex(
+            index), logRecord(std::move(record))
+    {}
+
+    LogEvent(LogEvent const &) = default;
+    LogEvent(LogEvent &&) noexcept = default;
+    LogEvent &operator=(LogEvent const &) = default;
+    LogEvent &operator=(LogEvent &&) noexcept = default;
+
     StoryId storyId;
     uint64_t eventTime;
     ClientId clientId;
@@ -104,6 +131,14 @@ public:
         }
     }
 
+    LogEventHVL(LogEventHVL &&other) noexcept
+            : storyId(other.storyId), eventTime(other.eventTime), clientId(other.clientId), eventIndex(other.eventIndex)
+            , logRecord(other.logRecord)
+    {
+        other.logRecord.len = 0;
+        other.logRecord.p = nullptr;
+    }
+
     LogEventHVL(const LogEventHVL& other)
             : storyId(other.storyId), eventTime(other.eventTime), clientId(other.clientId), eventIndex(other.eventIndex) {
         logRecord.len = other.logRecord.len;
@@ -159,6 +194,24 @@ public:
         return false;
     }
 
+    LogEventHVL& operator=(LogEventHVL &&other) noexcept {
+        if (this != &other) {
+            storyId = other.storyId;
+            eventTime = other.eventTime;
+            clientId = other.clientId;
+            eventIndex = other.eventIndex;
+
+            if (logRecord.p) {
+                delete[] static_cast<uint8_t*>(logRecord.p);
+            }
+
+            logRecord = other.logRecord;
+            other.logRecord.len = 0;
+            other.logRecord.p = nullptr;
+        }
+        return *this;
+    }
+
     LogEventHVL& operator=(const LogEventHVL& other) {
         if (this != &other) {
             storyId = other.storyId;
@@ -15,9 +15,11 @@
 #include <thallium/serialization/stl/map.hpp>
 
 #include "chrono_monitor.h"
+#include "chrono_metrics.h"
 #include "chronolog_types.h"
 #include "ConnectResponseMsg.h"
 #include "AcquireStoryResponseMsg.h"
+#include "TimedRpc.h"
 
 namespace tl = thallium;
 
@@ -31,11 +33,12 @@ class RpcVisorClient
 
 public:
     static RpcVisorClient*
-    CreateRpcVisorClient(tl::engine &tl_engine, std::string const &service_addr, uint16_t provider_id)
+    CreateRpcVisorClient(tl::engine &tl_engine, std::string const &service_addr, uint16_t provider_id
+                         , uint32_t rpc_timeout_ms = 0)
     {
         try
         {
-            return new RpcVisorClient(tl_engine, service_addr, provider_id);
+            return new RpcVisorClient(tl_engine, service_addr, provider_id, rpc_timeout_ms);
         }
         catch(tl::exception const &)
         {
@@ -49,9 +52,11 @@ public:
     {
         LOG_DEBUG("[RpcVisorClient] Initiating connection for Account={}, HostID={}, PID={}", client_euid, client_host_ip
              , client_pid);
+        ScopedLatency rpc_timer(rpc_latency("Connect"));
         try
         {
-            ConnectResponseMsg response = visor_connect.on(service_ph)(client_euid, client_host_ip, client_pid);
+            ConnectResponseMsg response = timed_call(visor_connect.on(service_ph), rpcTimeout, client_euid
+                                                     , client_host_ip, client_pid);
             LOG_INFO("[RpcVisorClient] Connection successful for Account={}, HostID={}, PID={}", client_euid, client_host_ip
                  , client_pid);
             return response;
@@ -66,9 +71,10 @@ public:
     int Disconnect(ClientId const &client_id)
     {
         LOG_INFO("[RPCVisorClient] Initiating disconnection for ClientID={}", client_id);
+        ScopedLatency rpc_timer(rpc_latency("Disconnect"));
         try
         {
-            int result = visor_disconnect.on(service_ph)(client_id);
+            int result = timed_call(visor_disconnect.on(service_ph), rpcTimeout, client_id);
             if(result == chronolog::CL_SUCCESS)
             {
                 LOG_INFO("[RPCVisorClient] Disconnection successful for ClientID={}", client_id);
@@ -92,9 +98,10 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Initiating creation of chronicle: Name={}, Flags={}", name.c_str()
              , flags);
+        ScopedLatency rpc_timer(rpc_latency("CreateChronicle"));
         try
         {
-            int result = create_chronicle.on(service_ph)(client_id, name, attrs, flags);
+            int result = timed_call(create_chronicle.on(service_ph), rpcTimeout, client_id, name, attrs, flags);
 
             if(result == chronolog::CL_SUCCESS)
             {
@@ -118,9 +125,10 @@ public:
     int DestroyChronicle(ClientId const &client_id, std::string const &name)
     {
         LOG_INFO("[RPCVisorClient] Initiating destruction of chronicle: Name={}", name.c_str());
+        ScopedLatency rpc_timer(rpc_latency("DestroyChronicle"));
         try
         {
-            int result = destroy_chronicle.on(service_ph)(client_id, name);
+            int result = timed_call(destroy_chronicle.on(service_ph), rpcTimeout, client_id, name);
 
             if(result == chronolog::CL_SUCCESS)
             {
@@ -145,10 +153,12 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Initiating story acquisition: ChronicleName={}, StoryName={}", chronicle_name.c_str()
              , story_name.c_str());
+        ScopedLatency rpc_timer(rpc_latency("AcquireStory"));
         try
         {
-            chronolog::AcquireStoryResponseMsg response = acquire_story.on(service_ph)(client_id, chronicle_name
-                                                                                       , story_name, attrs, flags);
+            chronolog::AcquireStoryResponseMsg response = timed_call(acquire_story.on(service_ph), rpcTimeout
+                                                                     , client_id, chronicle_name, story_name, attrs
+                                                                     , flags);
 
             if(response.getErrorCode() == chronolog::CL_SUCCESS)
             {
@@ -175,9 +185,11 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Initiating story release: ChronicleName={}, StoryName={}", chronicle_name.c_str()
              , story_name.c_str());
+        ScopedLatency rpc_timer(rpc_latency("ReleaseStory"));
         try
         {
-            int resultCode = release_story.on(service_ph)(client_id, chronicle_name, story_name);
+            int resultCode = timed_call(release_story.on(service_ph), rpcTimeout, client_id, chronicle_name
+                                        , story_name);
 
             if(resultCode == chronolog::CL_SUCCESS)
             {
@@ -204,9 +216,11 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Initiating story destruction: ChronicleName={}, StoryName={}", chronicle_name.c_str()
              , story_name.c_str());
+        ScopedLatency rpc_timer(rpc_latency("DestroyStory"));
         try
         {
-            int resultCode = destroy_story.on(service_ph)(client_id, chronicle_name, story_name);
+            int resultCode = timed_call(destroy_story.on(service_ph), rpcTimeout, client_id, chronicle_name
+                                        , story_name);
 
             if(resultCode == chronolog::CL_SUCCESS)
             {
@@ -233,9 +247,10 @@ public:
     int GetChronicleAttr(ClientId const &client_id, std::string const &name, const std::string &key, std::string &value)
     {
         LOG_INFO("[RPCVisorClient] Retrieving attribute: ChronicleName={}, Key={}", name.c_str(), key.c_str());
+        ScopedLatency rpc_timer(rpc_latency("GetChronicleAttr"));
         try
         {
-            int resultCode = get_chronicle_attr.on(service_ph)(client_id, name, key, value);
+            int resultCode = timed_call(get_chronicle_attr.on(service_ph), rpcTimeout, client_id, name, key, value);
 
             if(resultCode == chronolog::CL_SUCCESS)
             {
@@ -263,9 +278,10 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Modifying attribute: ChronicleName={}, Key={}, NewValue={}", name.c_str(), key.c_str()
              , value.c_str());
+        ScopedLatency rpc_timer(rpc_latency("EditChronicleAttr"));
         try
         {
-            int resultCode = edit_chronicle_attr.on(service_ph)(client_id, name, key, value);
+            int resultCode = timed_call(edit_chronicle_attr.on(service_ph), rpcTimeout, client_id, name, key, value);
 
             if(resultCode == chronolog::CL_SUCCESS)
             {
@@ -291,9 +307,10 @@ public:
     std::vector <std::string> ShowChronicles(ClientId const &client_id) //, std::vector<std::string> & chronicles)
     {
         LOG_INFO("[RPCVisorClient] Attempting to retrieve list of chronicles for ClientID={}", client_id);
+        ScopedLatency rpc_timer(rpc_latency("ShowChronicles"));
         try
         {
-            std::vector <std::string> chronicleList = show_chronicles.on(service_ph)(client_id);
+            std::vector <std::string> chronicleList = timed_call(show_chronicles.on(service_ph), rpcTimeout, client_id);
 
             if(!chronicleList.empty())
             {
@@ -319,9 +336,11 @@ public:
     {
         LOG_INFO("[RPCVisorClient] Attempting to retrieve stories for ClientID={}, ChronicleName={}", client_id
              , chronicle_name);
+        ScopedLatency rpc_timer(rpc_latency("ShowStories"));
         try
         {
-            std::vector <std::string> storyList = show_stories.on(service_ph)(client_id, chronicle_name);
+            std::vector <std::string> storyList = timed_call(show_stories.on(service_ph), rpcTimeout, client_id
+                                                             , chronicle_name);
 
             if(!storyList.empty())
             {
@@ -360,9 +379,17 @@ public:
     }
 
 private:
+    // per operation latency of the Visor RPCs, these are rare enough to look the histogram up on every call
+    static LatencyHistogram &rpc_latency(char const*operation)
+    {
+        return chrono_metrics::getInstance().histogram("chronolog_visor_rpc_latency_ns"
+                                                       , std::string("op=\"") + operation + "\"");
+    }
+
     std::string service_addr;     // na address of ChronoVisor ClientService  
     uint16_t service_provider_id;          // ChronoVisor ClientService provider_id id
     tl::provider_handle service_ph;  //provider_handle for client registry service
+    std::chrono::milliseconds rpcTimeout;   // 0 for no deadline
     tl::remote_procedure visor_connect;
     tl::remote_procedure visor_disconnect;
     tl::remote_procedure create_chronicle;
@@ -380,8 +407,9 @@ private:
     RpcVisorClient &operator=(RpcVisorClient const &) = delete;
 
     // constructor is private to make sure thalium rpc objects are created on the heap, not stack
-    RpcVisorClient(tl::engine &tl_engine, std::string const &service_addr, uint16_t provider_id): service_addr(
-            service_addr), service_provider_id(provider_id), service_ph(tl_engine.lookup(service_addr), provider_id)
+    RpcVisorClient(tl::engine &tl_engine, std::string const &service_addr, uint16_t provider_id
+                   , uint32_t rpc_timeout_ms): service_addr(service_addr), service_provider_id(provider_id)
+            , service_ph(tl_engine.lookup(service_addr), provider_id), rpcTimeout(rpc_timeout_ms)
     {
         LOG_DEBUG("[RpcVisorClient] Initialized for Visor Service at {} with ProviderID={}", service_addr
              , service_provider_id);